@@ -8,29 +8,49 @@
  * Polling mode should only be used in situations where multiple devices
  * share the SPI bus. Interrupt mode is much faster (8kSPS on a Teensy 3.1),
  * but starts receiving immediately when DRDY goes high.
- * The API is the same for both modes. To activate polling mode add
- *     #define ADS129X_POLLING
- * as first line to your sketch.
+ * The API is the same for both modes. To activate polling mode define
+ * ADS129X_POLLING for the whole build (-DADS129X_POLLING). It changes the
+ * object layout, so a #define in the sketch, which never reaches this
+ * file, does not work.
  *
  * Based on code by Conor Russomanno (https://github.com/conorrussomanno/ADS1299)
  * Modified by Ferdinand Keil
  */
 
-// Compatibility with the Arduino 1.0 library standard
-#if defined(ARDUINO) && ARDUINO >= 100
-#include "Arduino.h"
-#else
-#include "WProgram.h"
-#endif
-
+#include "ADS129X_HAL.h"
 #include "ADS129X.h"
-#include <SPI.h>
 
 #ifndef ADS129X_POLLING
-int ADS129X_CS;
-long ADS129X_data[9];
-boolean ADS129X_newData;
-void ADS129X_dataReadyISR();
+// keeps the compiler from moving buffer accesses across index updates
+#define ADS129X_BARRIER() __asm__ __volatile__ ("" ::: "memory")
+#define ADS129X_BUFFER_MASK (ADS129X_BUFFER_SIZE - 1)
+
+// Instances that own an interrupt slot, and one ISR trampoline per slot.
+ADS129X *ADS129X::instances[ADS129X_MAX_INSTANCES];
+void (* const ADS129X::trampolines[ADS129X_MAX_INSTANCES])() = {
+    &ADS129X::dataReadyISR<0>,
+#if ADS129X_MAX_INSTANCES > 1
+    &ADS129X::dataReadyISR<1>,
+#endif
+#if ADS129X_MAX_INSTANCES > 2
+    &ADS129X::dataReadyISR<2>,
+#endif
+#if ADS129X_MAX_INSTANCES > 3
+    &ADS129X::dataReadyISR<3>,
+#endif
+#if ADS129X_MAX_INSTANCES > 4
+    &ADS129X::dataReadyISR<4>,
+#endif
+#if ADS129X_MAX_INSTANCES > 5
+    &ADS129X::dataReadyISR<5>,
+#endif
+#if ADS129X_MAX_INSTANCES > 6
+    &ADS129X::dataReadyISR<6>,
+#endif
+#if ADS129X_MAX_INSTANCES > 7
+    &ADS129X::dataReadyISR<7>,
+#endif
+};
 #endif
 
 /**
@@ -40,7 +60,7 @@ void ADS129X_dataReadyISR();
  */
 ADS129X::ADS129X(int _DRDY, int _CS) {
     // SPI Setup
-    SPI.begin();
+    ADS129X_HAL::spiBegin();
 
     // // set clock divider
     // SPI.setClockDivider(SPI_CLOCK_DIV2);
@@ -54,13 +74,53 @@ ADS129X::ADS129X(int _DRDY, int _CS) {
     // initialize the  data ready and chip select pins:
     DRDY = _DRDY;
     CS = _CS;
-    pinMode(DRDY, INPUT_PULLUP);
-    pinMode(CS, OUTPUT);
-    digitalWrite(CS, HIGH);
+    ADS129X_HAL::pinMode(DRDY, INPUT_PULLUP);
+    ADS129X_HAL::pinMode(CS, OUTPUT);
+    ADS129X_HAL::digitalWrite(CS, HIGH);
 
+    configVersion = 0;
+    registerClock = ADS129X_SPI_CLOCK;
+    dataClock = ADS129X_SPI_DATA_CLOCK;
+    readContinuous = true; // power-up default
+    frameCount = 0;
+    dirty = 0;
+    ADS129X_HAL::ticksBegin();
+#ifdef ADS129X_STATS
+    ticksPerMicro = ADS129X_HAL::ticksPerSecond() / 1000000UL;
+    if (ticksPerMicro == 0) ticksPerMicro = 1;
+    nominalPeriod = 0;
+    resetStats();
+#endif
+    resetTiming();
+    setDaisyChain(1, 8);
+    loadRegisterDefaults();
 #ifndef ADS129X_POLLING
-    ADS129X_CS = _CS;
-    ADS129X_newData = false;
+    head = 0;
+    tail = 0;
+    overruns = 0;
+    // claim an interrupt slot
+    slot = ADS129X_MAX_INSTANCES;
+    for (byte i = 0; i < ADS129X_MAX_INSTANCES; i++) {
+        if (instances[i] == NULL) {
+            instances[i] = this;
+            slot = i;
+            break;
+        }
+    }
+#else
+    havePolled = false;
+#endif
+}
+
+/**
+ * Releases the interrupt slot of this instance.
+ */
+ADS129X::~ADS129X() {
+#ifndef ADS129X_POLLING
+    if (slot < ADS129X_MAX_INSTANCES) {
+        ADS129X_HAL::detachInterrupt(DRDY);
+        instances[slot] = NULL;
+    }
 #endif
 }
 
@@ -70,52 +130,64 @@ ADS129X::ADS129X(int _DRDY, int _CS) {
  * Exit Standby Mode.
  */
 void ADS129X::WAKEUP() {
-    SPI.beginTransaction(SPISettings(4000000, MSBFIRST, SPI_MODE1)); 
-    digitalWrite(CS, LOW); //Low to communicate
-    SPI.transfer(ADS129X_CMD_WAKEUP);
-    delayMicroseconds(2);
-    digitalWrite(CS, HIGH); //High to end communication
-    delayMicroseconds(2);  //must way at least 4 tCLK cycles before sending another command (Datasheet, pg. 38)
-    SPI.endTransaction();
+    ADS129X_HAL::spiBeginTransaction(registerClock); 
+    ADS129X_HAL::digitalWrite(CS, LOW); //Low to communicate
+    ADS129X_HAL::spiTransfer(ADS129X_CMD_WAKEUP);
+    ADS129X_HAL::delayMicroseconds(ADS129X_tclkToMicros(4));
+    ADS129X_HAL::digitalWrite(CS, HIGH); //High to end communication
+    ADS129X_HAL::delayMicroseconds(ADS129X_tclkToMicros(4));  //must way at least 4 tCLK cycles before sending another command (Datasheet, pg. 38)
+    ADS129X_HAL::spiEndTransaction();
 }
 
 /**
  * Enter Standby Mode.
  */
 void ADS129X::STANDBY() {
-    SPI.beginTransaction(SPISettings(4000000, MSBFIRST, SPI_MODE1));     
-    digitalWrite(CS, LOW);
-    SPI.transfer(ADS129X_CMD_STANDBY);
-    delayMicroseconds(2);
-    digitalWrite(CS, HIGH);
-    SPI.endTransaction();    
+    ADS129X_HAL::spiBeginTransaction(registerClock);     
+    ADS129X_HAL::digitalWrite(CS, LOW);
+    ADS129X_HAL::spiTransfer(ADS129X_CMD_STANDBY);
+    ADS129X_HAL::delayMicroseconds(ADS129X_tclkToMicros(4));
+    ADS129X_HAL::digitalWrite(CS, HIGH);
+    ADS129X_HAL::spiEndTransaction();    
 }
 
 /**
  * Reset Registers to Default Values.
+ * Values staged with setRegister are kept and written by the next commit().
  */
 void ADS129X::RESET() {
-    SPI.beginTransaction(SPISettings(4000000, MSBFIRST, SPI_MODE1));     
-    digitalWrite(CS, LOW);
-    SPI.transfer(ADS129X_CMD_RESET);
-    delayMicroseconds(2);
-    digitalWrite(CS, HIGH);
-    delay(10); //must wait 18 tCLK cycles to execute this command (Datasheet, pg. 38)
-    SPI.endTransaction();    
+    ADS129X_HAL::spiBeginTransaction(registerClock);     
+    ADS129X_HAL::digitalWrite(CS, LOW);
+    ADS129X_HAL::spiTransfer(ADS129X_CMD_RESET);
+    ADS129X_HAL::delayMicroseconds(ADS129X_tclkToMicros(4));
+    ADS129X_HAL::digitalWrite(CS, HIGH);
+    ADS129X_HAL::delayMicroseconds(ADS129X_tclkToMicros(18)); //must wait 18 tCLK cycles to execute this command (Datasheet, pg. 38)
+    ADS129X_HAL::spiEndTransaction();    
+    readContinuous = true;
+    loadRegisterDefaults();
 }
 
 /**
  * Start/restart (synchronize) conversions.
+ * In SDATAC mode no frames are read on DRDY; read them with RDATA(buffer).
  */
 void ADS129X::START() {
-    SPI.beginTransaction(SPISettings(4000000, MSBFIRST, SPI_MODE1));     
-    digitalWrite(CS, LOW);
-    SPI.transfer(ADS129X_CMD_START);
-    delayMicroseconds(2);
-    digitalWrite(CS, HIGH);
-    SPI.endTransaction();    
+    ADS129X_HAL::spiBeginTransaction(registerClock);     
+    ADS129X_HAL::digitalWrite(CS, LOW);
+    ADS129X_HAL::spiTransfer(ADS129X_CMD_START);
+    ADS129X_HAL::delayMicroseconds(ADS129X_tclkToMicros(4));
+    ADS129X_HAL::digitalWrite(CS, HIGH);
+    ADS129X_HAL::spiEndTransaction();    
+    resetTiming();
+#ifdef ADS129X_STATS
+    nominalPeriod = ADS129X_HAL::ticksPerSecond() / getNominalSampleRate();
+#endif
 #ifndef ADS129X_POLLING
-    attachInterrupt(DRDY, ADS129X_dataReadyISR, FALLING);
+    if (slot < ADS129X_MAX_INSTANCES && readContinuous) {
+        // keep the ISR from interrupting other transactions on the bus
+        ADS129X_HAL::spiUsingInterrupt(DRDY);
+        ADS129X_HAL::attachInterrupt(DRDY, trampolines[slot]);
+    }
 #endif
 }
 
@@ -124,51 +196,55 @@ void ADS129X::START() {
  */
 void ADS129X::STOP() {
 #ifndef ADS129X_POLLING
-        detachInterrupt(DRDY);
+    if (slot < ADS129X_MAX_INSTANCES) {
+        ADS129X_HAL::detachInterrupt(DRDY);
+    }
 #endif
-    SPI.beginTransaction(SPISettings(4000000, MSBFIRST, SPI_MODE1)); 
-    digitalWrite(CS, LOW);
-    SPI.transfer(ADS129X_CMD_STOP);
-    delayMicroseconds(2);
-    digitalWrite(CS, HIGH);
-    SPI.endTransaction();
+    ADS129X_HAL::spiBeginTransaction(registerClock); 
+    ADS129X_HAL::digitalWrite(CS, LOW);
+    ADS129X_HAL::spiTransfer(ADS129X_CMD_STOP);
+    ADS129X_HAL::delayMicroseconds(ADS129X_tclkToMicros(4));
+    ADS129X_HAL::digitalWrite(CS, HIGH);
+    ADS129X_HAL::spiEndTransaction();
 }
 
 /**
  * Enable Read Data Continuous mode (default).
  */
 void ADS129X::RDATAC() {
-    SPI.beginTransaction(SPISettings(4000000, MSBFIRST, SPI_MODE1));     
-    digitalWrite(CS, LOW);
-    SPI.transfer(ADS129X_CMD_RDATAC);
-    delayMicroseconds(2);
-    digitalWrite(CS, HIGH);
-    delayMicroseconds(2); //must way at least 4 tCLK cycles before sending another command (Datasheet, pg. 39)
-    SPI.endTransaction();    
+    ADS129X_HAL::spiBeginTransaction(registerClock);     
+    ADS129X_HAL::digitalWrite(CS, LOW);
+    ADS129X_HAL::spiTransfer(ADS129X_CMD_RDATAC);
+    ADS129X_HAL::delayMicroseconds(ADS129X_tclkToMicros(4));
+    ADS129X_HAL::digitalWrite(CS, HIGH);
+    ADS129X_HAL::delayMicroseconds(ADS129X_tclkToMicros(4)); //must way at least 4 tCLK cycles before sending another command (Datasheet, pg. 39)
+    ADS129X_HAL::spiEndTransaction();    
+    readContinuous = true;
 }
 
 /**
  * Stop Read Data Continuously mode.
  */
 void ADS129X::SDATAC() {
-    SPI.beginTransaction(SPISettings(4000000, MSBFIRST, SPI_MODE1));     
-    digitalWrite(CS, LOW);
-    SPI.transfer(ADS129X_CMD_SDATAC); //SDATAC
-    delayMicroseconds(2);
-    digitalWrite(CS, HIGH);
-    SPI.endTransaction();    
+    ADS129X_HAL::spiBeginTransaction(registerClock);     
+    ADS129X_HAL::digitalWrite(CS, LOW);
+    ADS129X_HAL::spiTransfer(ADS129X_CMD_SDATAC); //SDATAC
+    ADS129X_HAL::delayMicroseconds(ADS129X_tclkToMicros(4));
+    ADS129X_HAL::digitalWrite(CS, HIGH);
+    ADS129X_HAL::spiEndTransaction();    
+    readContinuous = false;
 }
 
 /**
  * Read data by command; supports multiple read back.
  */
 void ADS129X::RDATA() {
-    SPI.beginTransaction(SPISettings(4000000, MSBFIRST, SPI_MODE1));     
-    digitalWrite(CS, LOW);
-    SPI.transfer(ADS129X_CMD_RDATA);
-    delayMicroseconds(2);
-    digitalWrite(CS, HIGH);
-    SPI.endTransaction();    
+    ADS129X_HAL::spiBeginTransaction(registerClock);     
+    ADS129X_HAL::digitalWrite(CS, LOW);
+    ADS129X_HAL::spiTransfer(ADS129X_CMD_RDATA);
+    ADS129X_HAL::delayMicroseconds(ADS129X_tclkToMicros(4));
+    ADS129X_HAL::digitalWrite(CS, HIGH);
+    ADS129X_HAL::spiEndTransaction();    
 }
 
 /**
@@ -177,16 +253,17 @@ void ADS129X::RDATA() {
  * @return          value of register
  */
 byte ADS129X::RREG(byte _address) {
-    SPI.beginTransaction(SPISettings(4000000, MSBFIRST, SPI_MODE1));     
+    ADS129X_HAL::spiBeginTransaction(registerClock);     
     byte opcode1 = ADS129X_CMD_RREG | (_address & 0x1F); //001rrrrr; _RREG = 00100000 and _address = rrrrr
-    digitalWrite(CS, LOW); //Low to communicate
-    SPI.transfer(opcode1); //RREG
-    SPI.transfer(0x00); //opcode2
-    delayMicroseconds(1);
-    byte data = SPI.transfer(0x00); // returned byte should match default of register map unless edited manually (Datasheet, pg.39)
-    delayMicroseconds(2);
-    digitalWrite(CS, HIGH); //High to end communication
-    SPI.endTransaction();    
+    ADS129X_HAL::digitalWrite(CS, LOW); //Low to communicate
+    ADS129X_HAL::spiTransfer(opcode1); //RREG
+    ADS129X_HAL::spiTransfer(0x00); //opcode2
+    ADS129X_HAL::delayMicroseconds(1);
+    byte data = ADS129X_HAL::spiTransfer(0x00); // returned byte should match default of register map unless edited manually (Datasheet, pg.39)
+    ADS129X_HAL::delayMicroseconds(ADS129X_tclkToMicros(4));
+    ADS129X_HAL::digitalWrite(CS, HIGH); //High to end communication
+    ADS129X_HAL::spiEndTransaction();    
+    updateShadow(_address, data);
     return data;
 }
 
@@ -197,18 +274,22 @@ byte ADS129X::RREG(byte _address) {
  * @param data          pointer to data array
  */
 void ADS129X::RREG(byte _address, byte _numRegisters, byte *_data) {
-    SPI.beginTransaction(SPISettings(4000000, MSBFIRST, SPI_MODE1));     
+    ADS129X_HAL::spiBeginTransaction(registerClock);     
     byte opcode1 = ADS129X_CMD_RREG | (_address & 0x1F); //001rrrrr; _RREG = 00100000 and _address = rrrrr
-    digitalWrite(CS, LOW); //Low to communicated
-    SPI.transfer(ADS129X_CMD_SDATAC); //SDATAC
-    SPI.transfer(opcode1); //RREG
-    SPI.transfer(_numRegisters-1); //opcode2
+    ADS129X_HAL::digitalWrite(CS, LOW); //Low to communicated
+    ADS129X_HAL::spiTransfer(ADS129X_CMD_SDATAC); //SDATAC
+    readContinuous = false;
+    ADS129X_HAL::spiTransfer(opcode1); //RREG
+    ADS129X_HAL::spiTransfer(_numRegisters-1); //opcode2
     for(byte i = 0; i < _numRegisters; i++){
-        *(_data+i) = SPI.transfer(0x00); // returned byte should match default of register map unless previously edited manually (Datasheet, pg.39)
+        *(_data+i) = ADS129X_HAL::spiTransfer(0x00); // returned byte should match default of register map unless previously edited manually (Datasheet, pg.39)
+    }
+    ADS129X_HAL::delayMicroseconds(ADS129X_tclkToMicros(4));
+    ADS129X_HAL::digitalWrite(CS, HIGH); //High to end communication
+    ADS129X_HAL::spiEndTransaction();    
+    for (byte i = 0; i < _numRegisters; i++) {
+        updateShadow(_address + i, _data[i]);
     }
-    delayMicroseconds(2);
-    digitalWrite(CS, HIGH); //High to end communication
-    SPI.endTransaction();    
 }
 
 /**
@@ -217,15 +298,40 @@ void ADS129X::RREG(byte _address, byte _numRegisters, byte *_data) {
  * @param _value   register value
  */
 void ADS129X::WREG(byte _address, byte _value) {
-    SPI.beginTransaction(SPISettings(4000000, MSBFIRST, SPI_MODE1));     
+    ADS129X_HAL::spiBeginTransaction(registerClock);     
     byte opcode1 = ADS129X_CMD_WREG | (_address & 0x1F); //001rrrrr; _RREG = 00100000 and _address = rrrrr
-    digitalWrite(CS, LOW); //Low to communicate
-    SPI.transfer(opcode1);
-    SPI.transfer(0x00); // opcode2; only write one register
-    SPI.transfer(_value);
-    delayMicroseconds(2);
-    digitalWrite(CS, HIGH); //Low to communicate
-    SPI.endTransaction();    
+    ADS129X_HAL::digitalWrite(CS, LOW); //Low to communicate
+    ADS129X_HAL::spiTransfer(opcode1);
+    ADS129X_HAL::spiTransfer(0x00); // opcode2; only write one register
+    ADS129X_HAL::spiTransfer(_value);
+    ADS129X_HAL::delayMicroseconds(ADS129X_tclkToMicros(4));
+    ADS129X_HAL::digitalWrite(CS, HIGH); //Low to communicate
+    ADS129X_HAL::spiEndTransaction();    
+    updateShadow(_address, _value);
+}
+
+/**
+ * Write _numRegisters registers starting at address _address in one
+ * transaction.
+ * @param _address      start address
+ * @param _numRegisters number of registers
+ * @param _data         pointer to data array
+ */
+void ADS129X::WREG(byte _address, byte _numRegisters, byte *_data) {
+    ADS129X_HAL::spiBeginTransaction(registerClock);     
+    byte opcode1 = ADS129X_CMD_WREG | (_address & 0x1F); //010rrrrr; _WREG = 01000000 and _address = rrrrr
+    ADS129X_HAL::digitalWrite(CS, LOW); //Low to communicate
+    ADS129X_HAL::spiTransfer(opcode1);
+    ADS129X_HAL::spiTransfer(_numRegisters-1); //opcode2
+    for (byte i = 0; i < _numRegisters; i++) {
+        ADS129X_HAL::spiTransfer(_data[i]);
+    }
+    ADS129X_HAL::delayMicroseconds(ADS129X_tclkToMicros(4));
+    ADS129X_HAL::digitalWrite(CS, HIGH); //High to end communication
+    ADS129X_HAL::spiEndTransaction();    
+    for (byte i = 0; i < _numRegisters; i++) {
+        updateShadow(_address + i, _data[i]);
+    }
 }
 
 /**
@@ -233,111 +339,885 @@ void ADS129X::WREG(byte _address, byte _value) {
  * @return device ID
  */
 byte ADS129X::getDeviceId() {
-    SPI.beginTransaction(SPISettings(4000000, MSBFIRST, SPI_MODE1));     
-    digitalWrite(CS, LOW); //Low to communicate
-    SPI.transfer(ADS129X_CMD_RREG); //RREG
-    SPI.transfer(0x00); //Asking for 1 byte
-    byte data = SPI.transfer(0x00); // byte to read (hopefully 0b???11110)
-    delayMicroseconds(2);
-    digitalWrite(CS, HIGH); //Low to communicate
-    SPI.endTransaction();    
+    ADS129X_HAL::spiBeginTransaction(registerClock);     
+    ADS129X_HAL::digitalWrite(CS, LOW); //Low to communicate
+    ADS129X_HAL::spiTransfer(ADS129X_CMD_RREG); //RREG
+    ADS129X_HAL::spiTransfer(0x00); //Asking for 1 byte
+    byte data = ADS129X_HAL::spiTransfer(0x00); // byte to read (hopefully 0b???11110)
+    ADS129X_HAL::delayMicroseconds(ADS129X_tclkToMicros(4));
+    ADS129X_HAL::digitalWrite(CS, HIGH); //Low to communicate
+    ADS129X_HAL::spiEndTransaction();    
+    updateShadow(ADS129X_REG_ID, data);
     return data;
 }
 
+// Register shadow
+
+/**
+ * Load the power-up defaults into the register shadow (Datasheet, pg. 63).
+ * The ID register is unknown until read.
+ */
+void ADS129X::loadRegisterDefaults() {
+    // staged values survive a reset and are written by the next commit()
+    byte staged[ADS129X_NUM_REGISTERS];
+    unsigned long _dirty = dirty;
+    memcpy(staged, registers, sizeof(registers));
+    memset(registers, 0x00, sizeof(registers));
+    registers[ADS129X_REG_CONFIG1] = 0x06;
+    registers[ADS129X_REG_CONFIG2] = 0x40;
+    registers[ADS129X_REG_CONFIG3] = 0x40;
+    registers[ADS129X_REG_GPIO] = 0x0F;
+    dirty = 0;
+    configVersion++;
+    for (byte i = 0; i < ADS129X_NUM_REGISTERS; i++) {
+        if (_dirty & (1UL << i)) {
+            setRegister(i, staged[i]);
+        }
+    }
+}
+
+/**
+ * Record a value written to or read from the device.
+ */
+void ADS129X::updateShadow(byte _address, byte _value) {
+    if (_address < ADS129X_NUM_REGISTERS) {
+        // a committed staged value is a change of the device as well
+        if (registers[_address] != _value || (dirty & (1UL << _address))) {
+            configVersion++;
+        }
+        registers[_address] = _value;
+        dirty &= ~(1UL << _address);
+    }
+}
+
+/**
+ * Stage a register value. It is written to the device by commit().
+ * Read-only registers (ID, LOFF_STATP/N) are ignored.
+ * @param _address register address
+ * @param _value   register value
+ */
+void ADS129X::setRegister(byte _address, byte _value) {
+    if (_address >= ADS129X_NUM_REGISTERS || (ADS129X_READ_ONLY & (1UL << _address)) ||
+        registers[_address] == _value) {
+        return;
+    }
+    registers[_address] = _value;
+    dirty |= 1UL << _address;
+}
+
+/**
+ * Cached register value; staged values are returned before commit().
+ * Electrode status (LOFF_STATP/N) is only current after an RREG; while
+ * streaming, ADS129X_Monitor decodes it from the frames instead.
+ * @param  _address register address
+ * @return          value of register
+ */
+byte ADS129X::getRegister(byte _address) {
+    if (_address >= ADS129X_NUM_REGISTERS) {
+        return 0;
+    }
+    return registers[_address];
+}
+
+/**
+ * Whether a register holds a staged value that commit() has not written
+ * yet, so getRegister does not return what the device uses.
+ * @param  _address register address
+ * @return          true if staged
+ */
+boolean ADS129X::isStaged(byte _address) {
+    return _address < ADS129X_NUM_REGISTERS && (dirty & (1UL << _address));
+}
+
+/**
+ * Changes whenever the configuration of the device changes: on a reset,
+ * when a register is written or read back with a new value, and when
+ * commit() writes staged values. Staging alone does not change it. Lets
+ * derived state (e.g. the scale of ADS129X_Converter) notice a new
+ * configuration without comparing registers.
+ * @return change counter
+ */
+unsigned long ADS129X::getConfigVersion() {
+    return configVersion;
+}
+
+/**
+ * Write all staged registers to the device. Contiguous dirty registers are
+ * written with a single burst WREG; ranges separated by at most
+ * ADS129X_COMMIT_GAP clean registers are merged as rewriting a clean
+ * register is cheaper than another transaction. Merging stops at read-only
+ * registers, so their shadow only ever holds values read from the device.
+ * Requires SDATAC mode.
+ */
+void ADS129X::commit() {
+    byte address = 0;
+    while (dirty != 0) {
+        // start of the next dirty range
+        while (!(dirty & (1UL << address))) {
+            address++;
+        }
+        byte last = address;
+        byte gap = 0;
+        for (byte i = address + 1; i < ADS129X_NUM_REGISTERS && gap <= ADS129X_COMMIT_GAP &&
+                                   !(ADS129X_READ_ONLY & (1UL << i)); i++) {
+            if (dirty & (1UL << i)) {
+                last = i;
+                gap = 0;
+            } else {
+                gap++;
+            }
+        }
+        WREG(address, last - address + 1, registers + address);
+        address = last + 1;
+    }
+}
+
+/**
+ * Read all registers into the shadow, discarding staged values.
+ * Leaves Read Data Continuous mode.
+ */
+void ADS129X::readRegisters() {
+    byte values[ADS129X_NUM_REGISTERS];
+    RREG(ADS129X_REG_ID, ADS129X_NUM_REGISTERS, values);
+}
+
+/**
+ * Stage configuration of channel _channel; written by commit().
+ * @param _channel   channel (1-8)
+ * @param _powerDown power down (true, false)
+ * @param _gain      gain setting
+ * @param _mux       mux setting
+ */
+void ADS129X::setChannel(byte _channel, boolean _powerDown, byte _gain, byte _mux) {
+    byte value = ((_powerDown & 1)<<7) | ((_gain & 7)<<4) | (_mux & 7);
+    setRegister(ADS129X_REG_CH1SET + (_channel-1), value);
+}
+
+/**
+ * Gain setting of channel _channel from the register shadow.
+ * @param  _channel channel (1-8)
+ * @return          gain setting (ADS129X_GAIN_*)
+ */
+byte ADS129X::getGain(byte _channel) {
+    return (registers[ADS129X_REG_CH1SET + (_channel-1)] >> 4) & 7;
+}
+
+/**
+ * Mux setting of channel _channel from the register shadow.
+ * @param  _channel channel (1-8)
+ * @return          mux setting (ADS129X_MUX_*)
+ */
+byte ADS129X::getMux(byte _channel) {
+    return registers[ADS129X_REG_CH1SET + (_channel-1)] & 7;
+}
+
+#ifdef ADS129X_STATS
+/**
+ * Histogram bucket of a duration (see ADS129X_STATS_BUCKETS).
+ */
+static inline byte ADS129X_bucket(uint32_t _us) {
+    byte bucket = 0;
+    while (_us && bucket < ADS129X_STATS_BUCKETS - 1) {
+        _us >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+#endif
+
+/**
+ * Clocks one frame (status word and channel data of all devices in the
+ * chain) in a single buffer transfer. CS has to be low and the SPI
+ * transaction started.
+ * @param raw       buffer for the raw frame, gets overwritten
+ * @param numBytes  frame size in bytes
+ */
+static inline void ADS129X_readFrame(byte *raw, byte numBytes) {
+    memset(raw, 0x00, numBytes);
+    ADS129X_HAL::spiTransfer(raw, numBytes);
+}
+
+/**
+ * Read the latest conversion by command, in SDATAC mode. The data stays
+ * valid until the next conversion completes, so it can be read whenever
+ * DRDY has gone low, e.g. after a single-shot conversion.
+ * @param _buffer buffer for getFrameWords() words, laid out as by getData
+ */
+void ADS129X::RDATA(long *_buffer) {
+    byte raw[ADS129X_FRAME_BYTES];
+    ADS129X_HAL::spiBeginTransaction(dataClock);
+    ADS129X_HAL::digitalWrite(CS, LOW);
+    ADS129X_HAL::spiTransfer(ADS129X_CMD_RDATA);
+    ADS129X_HAL::delayMicroseconds(ADS129X_tclkToMicros(4));
+    ADS129X_readFrame(raw, frameBytes);
+    ADS129X_HAL::digitalWrite(CS, HIGH);
+    ADS129X_HAL::spiEndTransaction();
+    unpack(raw, _buffer, devices, channels);
+}
+
+/**
+ * Unpacks a raw frame into 32-bit words. Status words are returned as is,
+ * channel data is sign-extended from 24-bit two's complement.
+ * @param raw       raw frame as read from the device(s)
+ * @param frame     buffer for _devices*(1+_channels) words
+ * @param _devices  number of devices in the chain
+ * @param _channels number of channels per device
+ */
+static void ADS129X_unpackFrame(const byte *raw, long *frame, byte _devices, byte _channels) {
+    for (byte d = 0; d < _devices; d++) {
+        *frame++ = ((long) raw[0] << 16) | ((long) raw[1] << 8) | raw[2];
+        raw += 3;
+        for (byte i = 0; i < _channels; i++) {
+            long value = ((long) raw[0] << 16) | ((long) raw[1] << 8) | raw[2];
+            *frame++ = (value ^ 0x800000L) - 0x800000L;
+            raw += 3;
+        }
+    }
+}
+
 #ifndef ADS129X_POLLING
 /**
- * Interrupt that gets called when DRDY goes HIGH.
- * Transfers data and sets a flag.
- */
-void ADS129X_dataReadyISR() {
-    SPI.beginTransaction(SPISettings(4000000, MSBFIRST, SPI_MODE1));     
-    digitalWrite(ADS129X_CS, LOW);
-    // status
-    ((char*) ADS129X_data)[0*4+3] = 0;
-    ((char*) ADS129X_data)[0*4+2] = SPI.transfer(0x00);
-    ((char*) ADS129X_data)[0*4+1] = SPI.transfer(0x00);
-    ((char*) ADS129X_data)[0*4+0] = SPI.transfer(0x00);
-    // channel 1
-    ((char*) ADS129X_data)[1*4+3] = 0;
-    ((char*) ADS129X_data)[1*4+2] = SPI.transfer(0x00);
-    ((char*) ADS129X_data)[1*4+1] = SPI.transfer(0x00);
-    ((char*) ADS129X_data)[1*4+0] = SPI.transfer(0x00);
-    // channel 2
-    ((char*) ADS129X_data)[2*4+3] = 0;
-    ((char*) ADS129X_data)[2*4+2] = SPI.transfer(0x00);
-    ((char*) ADS129X_data)[2*4+1] = SPI.transfer(0x00);
-    ((char*) ADS129X_data)[2*4+0] = SPI.transfer(0x00);
-    // channel 3
-    ((char*) ADS129X_data)[3*4+3] = 0;
-    ((char*) ADS129X_data)[3*4+2] = SPI.transfer(0x00);
-    ((char*) ADS129X_data)[3*4+1] = SPI.transfer(0x00);
-    ((char*) ADS129X_data)[3*4+0] = SPI.transfer(0x00);
-    // channel 4
-    ((char*) ADS129X_data)[4*4+3] = 0;
-    ((char*) ADS129X_data)[4*4+2] = SPI.transfer(0x00);
-    ((char*) ADS129X_data)[4*4+1] = SPI.transfer(0x00);
-    ((char*) ADS129X_data)[4*4+0] = SPI.transfer(0x00);
-    // channel 5
-    ((char*) ADS129X_data)[5*4+3] = 0;
-    ((char*) ADS129X_data)[5*4+2] = SPI.transfer(0x00);
-    ((char*) ADS129X_data)[5*4+1] = SPI.transfer(0x00);
-    ((char*) ADS129X_data)[5*4+0] = SPI.transfer(0x00);
-    // channel 6
-    ((char*) ADS129X_data)[6*4+3] = 0;
-    ((char*) ADS129X_data)[6*4+2] = SPI.transfer(0x00);
-    ((char*) ADS129X_data)[6*4+1] = SPI.transfer(0x00);
-    ((char*) ADS129X_data)[6*4+0] = SPI.transfer(0x00);
-    // channel 7
-    ((char*) ADS129X_data)[7*4+3] = 0;
-    ((char*) ADS129X_data)[7*4+2] = SPI.transfer(0x00);
-    ((char*) ADS129X_data)[7*4+1] = SPI.transfer(0x00);
-    ((char*) ADS129X_data)[7*4+0] = SPI.transfer(0x00);
-    // channel 8
-    ((char*) ADS129X_data)[8*4+3] = 0;
-    ((char*) ADS129X_data)[8*4+2] = SPI.transfer(0x00);
-    ((char*) ADS129X_data)[8*4+1] = SPI.transfer(0x00);
-    ((char*) ADS129X_data)[8*4+0] = SPI.transfer(0x00);
-    digitalWrite(ADS129X_CS, HIGH);
-    SPI.endTransaction();    
-    ADS129X_newData = true;
+ * Gets called from the interrupt trampoline when DRDY goes LOW.
+ * Transfers data into the next free slot of the ring buffer. If the buffer
+ * is full the frame is dropped and counted as overrun.
+ * Interrupts of the same priority don't preempt each other, so several
+ * devices on one bus are read one after the other.
+ */
+void ADS129X::dataReady() {
+    uint32_t _timestamp = ADS129X_HAL::ticks();
+    byte _head = head;
+    unsigned long _sequence = frameCount++;
+#ifdef ADS129X_STATS
+    stats.interrupts++;
+#endif
+    if ((byte) (_head - tail) >= ADS129X_BUFFER_SIZE) {
+        overruns++;
+#ifdef ADS129X_STATS
+        stats.overruns++;
+#endif
+        return;
+    }
+    byte raw[ADS129X_FRAME_BYTES];
+    ADS129X_HAL::spiBeginTransaction(dataClock);     
+    ADS129X_HAL::digitalWrite(CS, LOW);
+    ADS129X_readFrame(raw, frameBytes);
+    ADS129X_HAL::digitalWrite(CS, HIGH);
+    ADS129X_HAL::spiEndTransaction();    
+    unpack(raw, data[_head & ADS129X_BUFFER_MASK], devices, channels);
+    sequence[_head & ADS129X_BUFFER_MASK] = _sequence;
+    timestamp[_head & ADS129X_BUFFER_MASK] = _timestamp;
+    ADS129X_BARRIER();
+    head = _head + 1;
+#ifdef ADS129X_STATS
+    stats.spiBytes += frameBytes;
+    uint32_t isrTime = (ADS129X_HAL::ticks() - _timestamp) / ticksPerMicro;
+    stats.isrTime[ADS129X_bucket(isrTime)]++;
+    if (isrTime > stats.maxIsrTime) {
+        stats.maxIsrTime = isrTime;
+    }
+#endif
 }
 #endif
 
 /**
  * Receive data when in continuous read mode.
+ * buffer[0] holds the 24-bit status word, buffer[1..8] the sign-extended
+ * channel data. In daisy-chain mode this repeats for every device, so the
+ * buffer needs room for getFrameWords() words.
  * @param buffer buffer for received data
  * @return true when received data
  */
 boolean ADS129X::getData(long *buffer) {
+    unsigned long sequence;
+    return getData(buffer, &sequence);
+}
+
+/**
+ * Receive data when in continuous read mode.
+ * Frames are numbered consecutively, a gap in the sequence numbers means
+ * frames were dropped.
+ * @param buffer   buffer for received data
+ * @param sequence sequence number of the received frame
+ * @return true when received data
+ */
+boolean ADS129X::getData(long *buffer, unsigned long *_sequence) {
+    uint32_t _timestamp;
+    return getData(buffer, _sequence, &_timestamp);
+}
+
+/**
+ * Receive data when in continuous read mode, with the time DRDY went low.
+ * In polling mode the timestamp is taken when getData finds DRDY low.
+ * @param buffer    buffer for received data
+ * @param sequence  sequence number of the received frame
+ * @param timestamp ADS129X_HAL::ticks() at DRDY
+ * @return true when received data
+ */
+boolean ADS129X::getData(long *buffer, unsigned long *_sequence, uint32_t *_timestamp) {
 #ifndef ADS129X_POLLING
-    if (ADS129X_newData) {
-        ADS129X_newData = false;
-        for (int i = 0; i < 9; i++) {
-            buffer[i] = ADS129X_data[i];
-        }
-        return true;
+    const long *frame;
+    const unsigned long *sequences;
+    const uint32_t *timestamps;
+    if (peek(&frame, &sequences, &timestamps) == 0) {
+        return false;
     }
-    return false;
+    memcpy(buffer, frame, frameWords * sizeof(long));
+    *_sequence = sequences[0];
+    *_timestamp = timestamps[0];
+    release(1);
+    return true;
 #else
-    if (digitalRead(DRDY) == LOW) {
-        SPI.beginTransaction(SPISettings(4000000, MSBFIRST, SPI_MODE1));             
-        digitalWrite(CS, LOW);
-        for(int i = 0; i<9; i++){
-            long dataPacket = 0;
-            for(int j = 0; j<3; j++){
-                byte dataByte = SPI.transfer(0x00);
-                dataPacket = (dataPacket<<8) | dataByte;
+    if (havePolled) {
+        // returned by peek before
+        memcpy(buffer, polled, frameWords * sizeof(long));
+        *_sequence = polledSequence;
+        *_timestamp = polledTimestamp;
+        havePolled = false;
+        return true;
+    }
+    if (ADS129X_HAL::digitalRead(DRDY) == LOW) {
+        *_timestamp = ADS129X_HAL::ticks();
+        byte raw[ADS129X_FRAME_BYTES];
+        ADS129X_HAL::spiBeginTransaction(dataClock);             
+        ADS129X_HAL::digitalWrite(CS, LOW);
+        ADS129X_readFrame(raw, frameBytes);
+        ADS129X_HAL::digitalWrite(CS, HIGH);
+        ADS129X_HAL::spiEndTransaction();        
+        unpack(raw, buffer, devices, channels);
+        *_sequence = frameCount++;
+#ifdef ADS129X_STATS
+        stats.spiBytes += frameBytes;
+        if (haveTimestamp && nominalPeriod) {
+            // DRDY only stays low until the next conversion, so a long gap
+            // means frames were missed
+            uint32_t periods = (*_timestamp - lastTimestamp + nominalPeriod / 2) / nominalPeriod;
+            if (periods > 1) {
+                stats.pollingMisses += periods - 1;
             }
-            buffer[i] = dataPacket;
         }
-        digitalWrite(CS, HIGH);
-        SPI.endTransaction();        
+#endif
+        updateTiming(*_sequence, *_timestamp);
         return true;
     }
     return false;
 #endif
 }
 
+/**
+ * Receive all pending frames, up to _maxFrames, in one call. Frames are
+ * stored back to back, getFrameWords() words each.
+ * @param _buffer     buffer for _maxFrames frames
+ * @param _maxFrames  maximum number of frames
+ * @param _sequences  buffer for the sequence numbers, or NULL
+ * @param _timestamps buffer for the timestamps, or NULL
+ * @return            number of frames received
+ */
+byte ADS129X::getFrames(long *_buffer, byte _maxFrames, unsigned long *_sequences, uint32_t *_timestamps) {
+    byte total = 0;
+    const long *frames;
+    const unsigned long *sequences;
+    const uint32_t *timestamps;
+    while (total < _maxFrames) {
+        byte count = peek(&frames, &sequences, &timestamps);
+        if (count == 0) {
+            break;
+        }
+        if (count > _maxFrames - total) {
+            count = _maxFrames - total;
+        }
+        for (byte i = 0; i < count; i++) {
+            memcpy(_buffer, frames + i * ADS129X_FRAME_WORDS, frameWords * sizeof(long));
+            _buffer += frameWords;
+        }
+        if (_sequences != NULL) {
+            memcpy(_sequences + total, sequences, count * sizeof(unsigned long));
+        }
+        if (_timestamps != NULL) {
+            memcpy(_timestamps + total, timestamps, count * sizeof(uint32_t));
+        }
+        release(count);
+        total += count;
+    }
+    return total;
+}
+
+/**
+ * Borrow received frames without copying them. The frames stay valid and
+ * are not overwritten until they are given back with release(). Frame i
+ * starts at _frames[i * ADS129X_FRAME_WORDS] and has getFrameWords() words,
+ * with the same layout as getData. In interrupt mode these are the frames
+ * in the ring buffer up to its end, so call again after release() to get
+ * the ones that wrapped around. In polling mode the frame is read from the
+ * device if DRDY is low and at most one frame is returned.
+ * @param _frames     receives a pointer to the first frame
+ * @param _sequences  receives a pointer to the sequence numbers, or NULL
+ * @param _timestamps receives a pointer to the timestamps, or NULL
+ * @return            number of frames available at _frames
+ */
+byte ADS129X::peek(const long **_frames, const unsigned long **_sequences, const uint32_t **_timestamps) {
+#ifndef ADS129X_POLLING
+    byte _tail = tail;
+    byte count = head - _tail;
+    if (count == 0) {
+        return 0;
+    }
+    ADS129X_BARRIER();
+    byte index = _tail & ADS129X_BUFFER_MASK;
+    if (count > ADS129X_BUFFER_SIZE - index) {
+        count = ADS129X_BUFFER_SIZE - index;
+    }
+    *_frames = data[index];
+    if (_sequences != NULL) *_sequences = sequence + index;
+    if (_timestamps != NULL) *_timestamps = timestamp + index;
+    return count;
+#else
+    if (!havePolled) {
+        havePolled = getData(polled, &polledSequence, &polledTimestamp);
+        if (!havePolled) {
+            return 0;
+        }
+    }
+    *_frames = polled;
+    if (_sequences != NULL) *_sequences = &polledSequence;
+    if (_timestamps != NULL) *_timestamps = &polledTimestamp;
+    return 1;
+#endif
+}
+
+/**
+ * Give back frames borrowed with peek(), oldest first. In interrupt mode
+ * only then are they counted for the timing estimate and statistics and
+ * their slots reused. In polling mode the frame was already counted when
+ * peek (or getData) read it; release only lets the next one be read.
+ * @param _count number of frames
+ */
+void ADS129X::release(byte _count) {
+#ifndef ADS129X_POLLING
+    byte _tail = tail;
+    byte pending = head - _tail;
+    if (_count > pending) {
+        _count = pending;
+    }
+    for (byte i = 0; i < _count; i++) {
+        byte index = (_tail + i) & ADS129X_BUFFER_MASK;
+        updateTiming(sequence[index], timestamp[index]);
+    }
+    ADS129X_BARRIER();
+    tail = _tail + _count;
+#else
+    if (_count > 0) {
+        havePolled = false;
+    }
+#endif
+}
+
+void ADS129X::resetTiming() {
+    haveTimestamp = false;
+    elapsedTicks = 0;
+    latency = 0;
+    maxLatency = 0;
+}
+
+void ADS129X::updateTiming(unsigned long _sequence, uint32_t _timestamp) {
+    if (haveTimestamp) {
+        // accumulate differences so the 32-bit tick counter may wrap
+        elapsedTicks += (uint32_t) (_timestamp - lastTimestamp);
+    } else {
+        firstSequence = _sequence;
+        haveTimestamp = true;
+    }
+    lastSequence = _sequence;
+    lastTimestamp = _timestamp;
+    latency = ADS129X_HAL::ticks() - _timestamp;
+    if (latency > maxLatency) {
+        maxLatency = latency;
+    }
+#ifdef ADS129X_STATS
+    uint32_t us = latency / ticksPerMicro;
+    stats.frames++;
+    stats.latency[ADS129X_bucket(us)]++;
+    if (us > stats.maxLatency) {
+        stats.maxLatency = us;
+    }
+#endif
+}
+
+#ifdef ADS129X_STATS
+/**
+ * Copy the instrumentation counters. Can be called while acquiring;
+ * interrupts are only held off for the copy.
+ * @param _stats receives the counters
+ */
+void ADS129X::getStats(ADS129X_Stats *_stats) {
+    ADS129X_HAL::disableInterrupts();
+    *_stats = stats;
+    ADS129X_HAL::enableInterrupts();
+}
+
+/**
+ * Clear the instrumentation counters.
+ */
+void ADS129X::resetStats() {
+    ADS129X_HAL::disableInterrupts();
+    memset(&stats, 0, sizeof(stats));
+    ADS129X_HAL::enableInterrupts();
+}
+#endif
+
+/**
+ * Data rate measured from the timestamps of the frames read since START.
+ * The estimate improves with the length of the run; compare against
+ * getNominalSampleRate to find the deviation of the sample clock, or
+ * against another device to align recordings.
+ * In polling mode frames missed by the loop are not counted, so the
+ * estimate is only valid if the loop keeps up.
+ * @return data rate in Hz, 0 before two frames were read
+ */
+float ADS129X::getSampleRate() {
+    if (elapsedTicks == 0) {
+        return 0;
+    }
+    return (float) (lastSequence - firstSequence) * ADS129X_HAL::ticksPerSecond() / (float) elapsedTicks;
+}
+
+/**
+ * Data rate set in CONFIG1 for a master clock of ADS129X_FCLK
+ * (Datasheet, pg. 40).
+ * @return data rate in Hz
+ */
+float ADS129X::getNominalSampleRate() {
+    byte config1 = registers[ADS129X_REG_CONFIG1];
+    float fMOD = ADS129X_FCLK / ((config1 & (1<<ADS129X_BIT_HR)) ? 4.0f : 8.0f);
+    return fMOD / (16 << (config1 & 0x07));
+}
+
+/**
+ * Time from START to the first DRDY for the data rate set in CONFIG1
+ * (tSETTLE from the datasheet settling time table, in tCLK: 296 at
+ * 32 kSPS, doubling with every DR step; low-power mode takes the value of
+ * the next step).
+ * @return settling time in us
+ */
+unsigned long ADS129X::getSettlingTime() {
+    byte config1 = registers[ADS129X_REG_CONFIG1];
+    byte dr = config1 & 0x07;
+    if (!(config1 & (1<<ADS129X_BIT_HR))) {
+        dr++;
+    }
+    return ADS129X_tclkToMicros(18UL * (16UL << dr) + 8);
+}
+
+/**
+ * Deviation of the measured from the nominal data rate.
+ * @return clock error in ppm, 0 before two frames were read
+ */
+float ADS129X::getClockError() {
+    float rate = getSampleRate();
+    if (rate == 0) {
+        return 0;
+    }
+    return (rate / getNominalSampleRate() - 1) * 1e6f;
+}
+
+/**
+ * Time from DRDY to getData returning the last frame. A growing latency
+ * means the consumer is falling behind.
+ * @return latency in us
+ */
+unsigned long ADS129X::getLatency() {
+    return (uint64_t) latency * 1000000UL / ADS129X_HAL::ticksPerSecond();
+}
+
+/**
+ * Highest latency since START.
+ * @return latency in us
+ */
+unsigned long ADS129X::getMaxLatency() {
+    return (uint64_t) maxLatency * 1000000UL / ADS129X_HAL::ticksPerSecond();
+}
+
+/**
+ * Number of frames waiting to be read by getData.
+ * @return number of frames
+ */
+byte ADS129X::available() {
+#ifndef ADS129X_POLLING
+    return head - tail;
+#else
+    return (havePolled || ADS129X_HAL::digitalRead(DRDY) == LOW) ? 1 : 0;
+#endif
+}
+
+/**
+ * Returns whether DRDY is low, i.e. a conversion result is waiting to be
+ * read. Meant for SDATAC mode, where frames are read with RDATA(buffer).
+ */
+boolean ADS129X::isDataReady() {
+    return ADS129X_HAL::digitalRead(DRDY) == LOW;
+}
+
+/**
+ * Number of frames dropped because the ring buffer was full.
+ * Always zero in polling mode.
+ * @return number of dropped frames
+ */
+unsigned long ADS129X::getOverruns() {
+#ifndef ADS129X_POLLING
+    ADS129X_HAL::disableInterrupts();
+    unsigned long _overruns = overruns;
+    ADS129X_HAL::enableInterrupts();
+    return _overruns;
+#else
+    return 0;
+#endif
+}
+
+/**
+ * Number of frames signalled by the device since construction, including
+ * dropped frames.
+ * @return number of frames
+ */
+unsigned long ADS129X::getFrameCount() {
+    ADS129X_HAL::disableInterrupts();
+    unsigned long _frameCount = frameCount;
+    ADS129X_HAL::enableInterrupts();
+    return _frameCount;
+}
+
+// SPI clock
+
+/**
+ * Set the SPI clock. Commands and register access use _registerClock,
+ * reading frames (in the interrupt, or by getData in polling mode) uses
+ * _dataClock. The SPI library rounds down to the nearest clock the board
+ * supports. Call while conversions are stopped.
+ * @param _registerClock SCLK in Hz for commands and registers
+ * @param _dataClock     SCLK in Hz for data readback
+ */
+void ADS129X::setSpiClock(unsigned long _registerClock, unsigned long _dataClock) {
+    registerClock = _registerClock;
+    dataClock = _dataClock;
+}
+
+/**
+ * SPI clock for commands and register access.
+ * @return SCLK in Hz
+ */
+unsigned long ADS129X::getRegisterClock() {
+    return registerClock;
+}
+
+/**
+ * SPI clock for data readback.
+ * @return SCLK in Hz
+ */
+unsigned long ADS129X::getDataClock() {
+    return dataClock;
+}
+
+/**
+ * Next clock to try, 0 once _maxClock was tried.
+ */
+static unsigned long ADS129X_nextClock(unsigned long _clock, unsigned long _maxClock) {
+    if (_clock >= _maxClock) {
+        return 0;
+    }
+    unsigned long next = _clock + _clock / 2;
+    return (next < _maxClock) ? next : _maxClock;
+}
+
+/**
+ * Find the fastest SPI clocks that work reliably on this board. Starting
+ * from the current clocks, each clock is raised in steps of 1.5x as long as
+ * the checks pass, the data clock up to _maxClock and the register clock up
+ * to 2*ADS129X_FCLK (tSDECODE, see ADS129X_SPI_CLOCK):
+ * - registers: the ID and a burst read of all registers match a reference
+ *   read at the starting clock, and a pattern written to LOFF_SENSP reads
+ *   back unchanged
+ * - data: frames of the DC test signal, read by RDATA, have a valid status
+ *   word and the expected code on every channel
+ * Each check is repeated ADS129X_CALIBRATION_READS times. The register
+ * configuration is restored afterwards and staged values are committed.
+ * Call in SDATAC mode with conversions stopped and the reference set up,
+ * e.g. before START. If the starting clocks already fail they are kept.
+ * @param  _maxClock highest clock to try in Hz
+ * @return           data clock in Hz, 0 if the checks failed at the start
+ */
+unsigned long ADS129X::calibrateSpiClock(unsigned long _maxClock) {
+    const byte touched[] = {
+        ADS129X_REG_CONFIG2, ADS129X_REG_LOFF_SENSP,
+        ADS129X_REG_CH1SET, ADS129X_REG_CH2SET, ADS129X_REG_CH3SET, ADS129X_REG_CH4SET,
+        ADS129X_REG_CH5SET, ADS129X_REG_CH6SET, ADS129X_REG_CH7SET, ADS129X_REG_CH8SET
+    };
+    byte saved[ADS129X_NUM_REGISTERS];
+    unsigned long savedDirty = dirty;
+    memcpy(saved, registers, sizeof(registers));
+    unsigned long startRegister = registerClock;
+    unsigned long startData = dataClock;
+
+    // registers
+    byte reference[ADS129X_NUM_REGISTERS];
+    RREG(ADS129X_REG_ID, ADS129X_NUM_REGISTERS, reference);
+    // without delays between bytes, multi-byte commands need SCLK <= 2*fCLK
+    // to meet tSDECODE
+    unsigned long registerMax = (_maxClock < 2UL * ADS129X_FCLK) ? _maxClock : 2UL * ADS129X_FCLK;
+    unsigned long best = 0;
+    for (unsigned long clock = startRegister; clock != 0; clock = ADS129X_nextClock(clock, registerMax)) {
+        registerClock = clock;
+        if (!checkRegisters(reference)) {
+            break;
+        }
+        best = clock;
+    }
+    registerClock = (best != 0) ? best : startRegister;
+
+    // data, from the 1x DC test signal on all channels
+    unsigned long bestData = 0;
+    if (best != 0) {
+        setRegister(ADS129X_REG_CONFIG2, (registers[ADS129X_REG_CONFIG2] & 0xE0) |
+                    (1<<ADS129X_BIT_INT_TEST) | ADS129X_TEST_FREQ_DC);
+        for (byte i = 1; i <= 8; i++) {
+            setChannel(i, false, ADS129X_GAIN_1X, ADS129X_MUX_TEST);
+        }
+        commit();
+        command(ADS129X_CMD_START);
+        // VREF/2.4 mV at gain 1 (Datasheet, pg. 23)
+        const long expected = 8388607L / 2400;
+        for (unsigned long clock = startData; clock != 0; clock = ADS129X_nextClock(clock, _maxClock)) {
+            dataClock = clock;
+            boolean ok = true;
+            for (byte i = 0; i < ADS129X_CALIBRATION_READS && ok; i++) {
+                ok = checkTestFrame(expected);
+            }
+            if (!ok) {
+                break;
+            }
+            bestData = clock;
+        }
+        command(ADS129X_CMD_STOP);
+    }
+    dataClock = (bestData != 0) ? bestData : startData;
+    if (bestData == 0) {
+        registerClock = startRegister;
+    }
+
+    // restore the configuration as read back before the checks, so a burst
+    // that commit() merges across untouched registers writes what the
+    // device had; staged values stay staged
+    for (byte i = 0; i < ADS129X_NUM_REGISTERS; i++) {
+        registers[i] = (savedDirty & (1UL << i)) ? saved[i] : reference[i];
+    }
+    dirty = savedDirty;
+    for (byte i = 0; i < sizeof(touched); i++) {
+        dirty |= 1UL << touched[i];
+    }
+    commit();
+    return bestData;
+}
+
+/**
+ * Send a command without side effects on the library state.
+ */
+void ADS129X::command(byte _opcode) {
+    ADS129X_HAL::spiBeginTransaction(registerClock);
+    ADS129X_HAL::digitalWrite(CS, LOW);
+    ADS129X_HAL::spiTransfer(_opcode);
+    ADS129X_HAL::delayMicroseconds(ADS129X_tclkToMicros(4));
+    ADS129X_HAL::digitalWrite(CS, HIGH);
+    ADS129X_HAL::delayMicroseconds(ADS129X_tclkToMicros(4));
+    ADS129X_HAL::spiEndTransaction();
+}
+
+/**
+ * Register checks of calibrateSpiClock at the current register clock.
+ * Electrode status (LOFF_STATP/N) may change and is not compared.
+ * @param  _reference all registers, read at a known good clock
+ * @return            true if all reads matched
+ */
+boolean ADS129X::checkRegisters(const byte *_reference) {
+    byte values[ADS129X_NUM_REGISTERS];
+    for (byte n = 0; n < ADS129X_CALIBRATION_READS; n++) {
+        if (getDeviceId() != _reference[ADS129X_REG_ID]) {
+            return false;
+        }
+        RREG(ADS129X_REG_ID, ADS129X_NUM_REGISTERS, values);
+        for (byte i = 0; i < ADS129X_NUM_REGISTERS; i++) {
+            if (i != ADS129X_REG_LOFF_STATP && i != ADS129X_REG_LOFF_STATN && values[i] != _reference[i]) {
+                return false;
+            }
+        }
+        byte pattern = (n & 1) ? 0xAA : 0x55;
+        WREG(ADS129X_REG_LOFF_SENSP, pattern);
+        if (RREG(ADS129X_REG_LOFF_SENSP) != pattern) {
+            return false;
+        }
+        WREG(ADS129X_REG_LOFF_SENSP, _reference[ADS129X_REG_LOFF_SENSP]);
+    }
+    return true;
+}
+
+/**
+ * Data check of calibrateSpiClock: waits for the next conversion and reads
+ * it by RDATA at the current data clock.
+ * @param  _expected magnitude of the test signal code
+ * @return           true if the frame holds the expected pattern
+ */
+boolean ADS129X::checkTestFrame(long _expected) {
+    unsigned long timeout = 2 * getSettlingTime();
+    unsigned long start = ADS129X_HAL::micros();
+    while (ADS129X_HAL::digitalRead(DRDY) == HIGH) {
+        if (ADS129X_HAL::micros() - start > timeout) {
+            return false;
+        }
+        ADS129X_HAL::delayMicroseconds(ADS129X_tclkToMicros(4));
+    }
+    long frame[ADS129X_FRAME_WORDS];
+    RDATA(frame);
+    for (byte i = 0; i < frameWords; i++) {
+        if (i % (1 + channels) == 0) {
+            // status word starts with 1100 (Datasheet, pg. 32)
+            if ((frame[i] & 0xF00000) != 0xC00000) {
+                return false;
+            }
+        } else {
+            long value = (frame[i] < 0) ? -frame[i] : frame[i];
+            if (value < _expected - ADS129X_CALIBRATION_TOLERANCE ||
+                value > _expected + ADS129X_CALIBRATION_TOLERANCE) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * Set up reading several cascaded devices that share CS in one transfer.
+ * CONFIG1 DAISY_EN has to be cleared (the power-up default) on all devices.
+ * The frame returned by getData holds the status word and channel data of
+ * each device in chain order. Replaces a reader set by useReader.
+ * Call before START.
+ * @param _devices  number of devices in the chain (1-ADS129X_MAX_DAISY)
+ * @param _channels number of channels per device (4, 6 or 8)
+ */
+void ADS129X::setDaisyChain(byte _devices, byte _channels) {
+    if (_devices < 1) _devices = 1;
+    if (_devices > ADS129X_MAX_DAISY) _devices = ADS129X_MAX_DAISY;
+    if (_channels > 8) _channels = 8;
+    devices = _devices;
+    channels = _channels;
+    frameBytes = devices * (3 + 3*channels);
+    frameWords = devices * (1 + channels);
+    unpack = ADS129X_unpackFrame;
+}
+
+/**
+ * Number of words getData writes per frame.
+ * @return frame size in words
+ */
+byte ADS129X::getFrameWords() {
+    return frameWords;
+}
+
 /**
  * Configure channel _channel.
  * @param _channel   channel (1-8)
@@ -8,9 +8,12 @@
  * Polling mode should only be used in situations where multiple devices
  * share the SPI bus. Interrupt mode is much faster (8kSPS on a Teensy 3.1),
  * but starts receiving immediately when DRDY goes high.
- * The API is the same for both modes. To activate polling mode add
- *     #define ADS129X_POLLING
- * as first line to your sketch.
+ * The API is the same for both modes. To activate polling mode define
+ * ADS129X_POLLING for the whole build (-DADS129X_POLLING). It changes the
+ * object layout, so a #define in the sketch, which never reaches this
+ * file, does not work.
+ * In interrupt mode received frames are queued in a ring buffer of
+ * ADS129X_BUFFER_SIZE frames, so a late loop() does not lose samples.
  *
  * Based on code by Conor Russomanno (https://github.com/conorrussomanno/ADS1299)
  * Modified by Ferdinand Keil
@@ -19,12 +22,7 @@
 #ifndef ____ADS129X__
 #define ____ADS129X__
 
-// Compatibility with the Arduino 1.0 library standard
-#if defined(ARDUINO) && ARDUINO >= 100
-#include "Arduino.h"
-#else
-#include "WProgram.h"
-#endif
+#include "ADS129X_HAL.h"
 
 
 // SPI Command Definition Byte Assignments (Datasheet, pg. 35)
@@ -226,9 +224,171 @@
 #define ADS129X_SAMPLERATE_32   0x1
 #define ADS129X_SAMPLERATE_16   0x0
 
+// Number of devices that can be read as one daisy chain (1-8). Sizes the
+// frame buffer, so it has to be defined for the whole build (-D), not in
+// the sketch.
+#ifndef ADS129X_MAX_DAISY
+#define ADS129X_MAX_DAISY 1
+#endif
+
+#if (ADS129X_MAX_DAISY < 1) || (ADS129X_MAX_DAISY > 8)
+#error "ADS129X_MAX_DAISY must be between 1 and 8"
+#endif
+
+// Maximum size of one data frame: per device a 24-bit status word plus
+// 8 channels of 24 bits
+#define ADS129X_FRAME_BYTES (ADS129X_MAX_DAISY * 27)
+#define ADS129X_FRAME_WORDS (ADS129X_MAX_DAISY * 9)
+
+// Nominal master clock in Hz (internal oscillator), used for the nominal
+// data rate
+#ifndef ADS129X_FCLK
+#define ADS129X_FCLK 2048000
+#endif
+
+// Duration of _cycles master clock cycles (tCLK) in us, rounded up
+constexpr unsigned long ADS129X_tclkToMicros(unsigned long _cycles) {
+    return ((uint64_t) _cycles * 1000000UL + ADS129X_FCLK - 1) / ADS129X_FCLK;
+}
+
+// SPI clock for commands and register access. Multi-byte commands need
+// 4 tCLK between bytes (tSDECODE, Datasheet, pg. 10), which 8 SCLK at up to
+// 2*fCLK give without extra delays
+#ifndef ADS129X_SPI_CLOCK
+#define ADS129X_SPI_CLOCK 4000000
+#endif
+
+// SPI clock for reading frames; data readback has no decode time
+#ifndef ADS129X_SPI_DATA_CLOCK
+#define ADS129X_SPI_DATA_CLOCK 4000000
+#endif
+
+// Fastest SCLK the device supports (tSCLK >= 50 ns, Datasheet, pg. 10)
+#ifndef ADS129X_SPI_MAX_CLOCK
+#define ADS129X_SPI_MAX_CLOCK 20000000
+#endif
+
+// calibrateSpiClock checks this many test-signal frames and register
+// readbacks per clock, and accepts test codes within this many LSB
+#define ADS129X_CALIBRATION_READS 8
+#define ADS129X_CALIBRATION_TOLERANCE 64
+
+// Number of registers (ID to WCT2)
+#define ADS129X_NUM_REGISTERS (ADS129X_REG_WCT2 + 1)
+
+// Registers that cannot be written; never staged, and commit() does not
+// merge bursts across them
+#define ADS129X_READ_ONLY ((1UL << ADS129X_REG_ID) | (1UL << ADS129X_REG_LOFF_STATP) | \
+                           (1UL << ADS129X_REG_LOFF_STATN))
+
+// commit() merges dirty register ranges separated by up to this many
+// clean registers into one burst write
+#ifndef ADS129X_COMMIT_GAP
+#define ADS129X_COMMIT_GAP 2
+#endif
+
+// Number of frames buffered between interrupt and getData (interrupt mode).
+// Must be a power of two and not larger than 128. Sizes the object, so it
+// has to be defined for the whole build (-D), not in the sketch.
+#ifndef ADS129X_BUFFER_SIZE
+#define ADS129X_BUFFER_SIZE 8
+#endif
+
+#if (ADS129X_BUFFER_SIZE & (ADS129X_BUFFER_SIZE - 1)) || (ADS129X_BUFFER_SIZE > 128)
+#error "ADS129X_BUFFER_SIZE must be a power of two not larger than 128"
+#endif
+
+// Number of devices that can be interrupt-driven at the same time (1-8).
+// Sizes static tables in ADS129X.cpp, so it has to be defined for the whole
+// build (-D), not in the sketch.
+#ifndef ADS129X_MAX_INSTANCES
+#define ADS129X_MAX_INSTANCES 4
+#endif
+
+#if (ADS129X_MAX_INSTANCES < 1) || (ADS129X_MAX_INSTANCES > 8)
+#error "ADS129X_MAX_INSTANCES must be between 1 and 8"
+#endif
+
+// Instrumentation; ADS129X_STATS changes the object, so it has to be
+// defined for the whole build (-D), not in the sketch
+#ifdef ADS129X_STATS
+// Histogram buckets: bucket 0 counts durations below 1 us, bucket n
+// durations from 2^(n-1) to 2^n - 1 us, the last bucket everything longer
+#ifndef ADS129X_STATS_BUCKETS
+#define ADS129X_STATS_BUCKETS 16
+#endif
+
+/**
+ * Instrumentation counters, collected when ADS129X_STATS is defined.
+ */
+struct ADS129X_Stats {
+    unsigned long interrupts;    // DRDY interrupts handled
+    unsigned long frames;        // frames returned by getData
+    unsigned long overruns;      // frames dropped because the buffer was full
+    unsigned long spiBytes;      // bytes clocked in to read frames
+    unsigned long pollingMisses; // frames that came and went between getData calls
+    unsigned long maxIsrTime;    // us
+    unsigned long maxLatency;    // us, DRDY to getData
+    unsigned long isrTime[ADS129X_STATS_BUCKETS];
+    unsigned long latency[ADS129X_STATS_BUCKETS];
+};
+#endif
+
+// Highest set bit (1-based) and number of set bits of a channel mask
+constexpr byte ADS129X_lastChannel(byte _mask) {
+    return _mask ? 1 + ADS129X_lastChannel(_mask >> 1) : 0;
+}
+constexpr byte ADS129X_countChannels(byte _mask) {
+    return _mask ? (_mask & 1) + ADS129X_countChannels(_mask >> 1) : 0;
+}
+
+/**
+ * Unrolled unpack of the channels in MASK, starting at channel I (0-based).
+ * Each enabled channel is sign-extended into the next packed word OUT.
+ */
+template <byte MASK, byte I, byte OUT>
+struct ADS129X_UnpackChannels {
+    static inline void run(const byte *raw, long *frame) {
+        if (MASK & (1 << I)) {
+            const byte *p = raw + 3 + 3*I;
+            long value = ((long) p[0] << 16) | ((long) p[1] << 8) | p[2];
+            frame[OUT] = (value ^ 0x800000L) - 0x800000L;
+        }
+        ADS129X_UnpackChannels<MASK, I + 1, OUT + ((MASK >> I) & 1)>::run(raw, frame);
+    }
+};
+
+template <byte MASK, byte OUT>
+struct ADS129X_UnpackChannels<MASK, 8, OUT> {
+    static inline void run(const byte *, long *) {
+    }
+};
+
+/**
+ * Frame reader specialized at compile time for a device with CHANNELS
+ * channels (4: ADS1294, 6: ADS1296, 8: ADS1298) of which the ones in MASK
+ * (bit n = channel n+1) are read. Only the bytes up to the last enabled
+ * channel are clocked, and the frame holds the status word followed by the
+ * enabled channels only. Install with ADS129X::useReader.
+ */
+template <byte CHANNELS, byte MASK = (byte) ((1 << CHANNELS) - 1)>
+struct ADS129X_Reader {
+    static_assert(CHANNELS == 4 || CHANNELS == 6 || CHANNELS == 8, "ADS129X has 4, 6 or 8 channels");
+    static_assert(MASK != 0 && ADS129X_lastChannel(MASK) <= CHANNELS, "channel mask does not match device");
+
+    static const byte BYTES = 3 + 3*ADS129X_lastChannel(MASK);
+    static const byte WORDS = 1 + ADS129X_countChannels(MASK);
+
+    static void unpack(const byte *raw, long *frame, byte, byte) {
+        frame[0] = ((long) raw[0] << 16) | ((long) raw[1] << 8) | raw[2];
+        ADS129X_UnpackChannels<MASK, 0, 1>::run(raw, frame);
+    }
+};
+
 class ADS129X {
     public:
         ADS129X(int _DRDY, int _CS);
+        ~ADS129X();
 
         // ADS129X SPI Command Definitions (Datasheet, Pg. 35)
         // System Commands
@@ -242,19 +402,146 @@ class ADS129X {
         void RDATAC();
         void SDATAC();
         void RDATA();
+        void RDATA(long *_buffer);
 
         // Register Read/Write Commands
         byte RREG(byte _address);
         void RREG(byte _address, byte _numRegisters, byte *_data); //to read multiple consecutive registers (Datasheet, pg. 38)
         void WREG(byte _address, byte _value);
+        void WREG(byte _address, byte _numRegisters, byte *_data); //to write multiple consecutive registers
+
+        // Register shadow
+        void setRegister(byte _address, byte _value);
+        byte getRegister(byte _address);
+        boolean isStaged(byte _address);
+        unsigned long getConfigVersion();
+        void commit();
+        void readRegisters();
 
         // Functions for setup and data retrieval
         byte getDeviceId();
         boolean getData(long *buffer);
+        boolean getData(long *buffer, unsigned long *sequence);
+        boolean getData(long *buffer, unsigned long *sequence, uint32_t *timestamp);
+        byte getFrames(long *_buffer, byte _maxFrames, unsigned long *_sequences = NULL,
+                       uint32_t *_timestamps = NULL);
+        byte peek(const long **_frames, const unsigned long **_sequences = NULL,
+                  const uint32_t **_timestamps = NULL);
+        void release(byte _count);
+        byte available();
+        boolean isDataReady();
+        unsigned long getOverruns();
+        unsigned long getFrameCount();
+
+        // Timing, estimated from the timestamps of frames read by getData
+        float getSampleRate();
+        float getNominalSampleRate();
+        unsigned long getSettlingTime();
+        float getClockError();
+        unsigned long getLatency();
+        unsigned long getMaxLatency();
+
+#ifdef ADS129X_STATS
+        void getStats(ADS129X_Stats *_stats);
+        void resetStats();
+#endif
+        // SPI clock
+        void setSpiClock(unsigned long _registerClock, unsigned long _dataClock);
+        unsigned long getRegisterClock();
+        unsigned long getDataClock();
+        unsigned long calibrateSpiClock(unsigned long _maxClock = ADS129X_SPI_MAX_CLOCK);
+
+        void setDaisyChain(byte _devices, byte _channels);
+        template <byte CHANNELS, byte MASK> void useReader();
+        byte getFrameWords();
         void configChannel(byte _channel, boolean _powerDown, byte _gain, byte _mux);
+        void setChannel(byte _channel, boolean _powerDown, byte _gain, byte _mux);
+        byte getGain(byte _channel);
+        byte getMux(byte _channel);
 
     private:
+        // not copyable: the interrupt slot and the SPI registration refer to
+        // this object; declared but not defined
+        ADS129X(const ADS129X &);
+        ADS129X &operator=(const ADS129X &);
+
         int DRDY, CS; //pin numbers for "Data Ready" (DRDY) and "Chip Select" CS (Datasheet, pg. 26)
+        volatile unsigned long frameCount;
+        byte devices, channels; // daisy-chain geometry
+        byte frameBytes, frameWords;
+        unsigned long registerClock, dataClock; // SCLK in Hz
+        boolean readContinuous; // RDATAC mode, frames are read on DRDY
+        void (*unpack)(const byte *raw, long *frame, byte _devices, byte _channels);
+
+        // register shadow; bit n of dirty marks register n as staged
+        byte registers[ADS129X_NUM_REGISTERS];
+        unsigned long dirty;
+        unsigned long configVersion; // counts changes written to the device
+        void loadRegisterDefaults();
+        void updateShadow(byte _address, byte _value);
+
+        // SPI clock calibration
+        void command(byte _opcode);
+        boolean checkRegisters(const byte *_reference);
+        boolean checkTestFrame(long _expected);
+
+        // timing estimator: ticks between the first and the last frame read
+        // since START, and DRDY to getData latency in ticks
+        boolean haveTimestamp;
+        unsigned long firstSequence, lastSequence;
+        uint32_t lastTimestamp;
+        uint64_t elapsedTicks;
+        uint32_t latency, maxLatency;
+        void resetTiming();
+        void updateTiming(unsigned long _sequence, uint32_t _timestamp);
+
+#ifdef ADS129X_STATS
+        ADS129X_Stats stats;
+        uint32_t ticksPerMicro;
+        uint32_t nominalPeriod; // ticks, for detecting polling misses
+#endif
+
+#ifndef ADS129X_POLLING
+        // frame ring buffer: head is only written by the ISR, tail only by
+        // getData and release; both are free-running bytes so they are read
+        // atomically
+        long data[ADS129X_BUFFER_SIZE][ADS129X_FRAME_WORDS];
+        unsigned long sequence[ADS129X_BUFFER_SIZE];
+        uint32_t timestamp[ADS129X_BUFFER_SIZE]; // ticks at DRDY
+        volatile byte head, tail;
+        volatile unsigned long overruns;
+        byte slot; // interrupt slot, ADS129X_MAX_INSTANCES if none
+
+        void dataReady();
+
+        static ADS129X *instances[ADS129X_MAX_INSTANCES];
+        static void (* const trampolines[ADS129X_MAX_INSTANCES])();
+        template <byte N> static void dataReadyISR() {
+            instances[N]->dataReady();
+        }
+#else
+        // frame read by peek and not yet released
+        long polled[ADS129X_FRAME_WORDS];
+        unsigned long polledSequence;
+        uint32_t polledTimestamp;
+        boolean havePolled;
+#endif
 };
 
+/**
+ * Read frames with the compile-time specialized ADS129X_Reader. getData
+ * then returns the status word followed by the channels in MASK only.
+ * Call before START.
+ * @tparam CHANNELS number of channels of the device (4, 6 or 8)
+ * @tparam MASK     channels to read (bit n = channel n+1)
+ */
+template <byte CHANNELS, byte MASK>
+void ADS129X::useReader() {
+    devices = 1;
+    channels = CHANNELS;
+    frameBytes = ADS129X_Reader<CHANNELS, MASK>::BYTES;
+    frameWords = ADS129X_Reader<CHANNELS, MASK>::WORDS;
+    unpack = ADS129X_Reader<CHANNELS, MASK>::unpack;
+}
+
 #endif
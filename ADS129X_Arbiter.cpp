@@ -0,0 +1,253 @@
+/**
+ * ADS129X_Arbiter.cpp
+ *
+ * DRDY-aware scheduling of other transactions on a shared SPI bus.
+ */
+
+#include "ADS129X_Arbiter.h"
+
+/**
+ * Creates an arbiter for an ADS129X. It grants every request until begin().
+ * @param _ads device
+ */
+ADS129X_Arbiter::ADS129X_Arbiter(ADS129X *_ads) {
+    ads = _ads;
+    active = false;
+    granted = false;
+    guard = ADS129X_ARBITER_GUARD;
+    ticksPerMicro = ADS129X_HAL::ticksPerSecond() / 1000000UL;
+    if (ticksPerMicro == 0) ticksPerMicro = 1;
+    grants = 0;
+    deferrals = 0;
+    missed = 0;
+    worstSlack = 0x7FFFFFFF;
+    longest = 0;
+}
+
+/**
+ * Starts scheduling around conversions. Call after START, once the data
+ * rate in CONFIG1 and the SPI clocks are set. Resets the statistics.
+ */
+void ADS129X_Arbiter::begin() {
+    period = ADS129X_HAL::ticksPerSecond() / ads->getNominalSampleRate();
+    // first guess at the readback until one has been timed
+    unsigned long bits = 8UL * 3 * ads->getFrameWords();
+    readTicks = (uint32_t) ((uint64_t) bits * ADS129X_HAL::ticksPerSecond() / ads->getDataClock())
+              + ADS129X_ARBITER_OVERHEAD * ticksPerMicro;
+    active = true;
+    synced = false;
+    haveSequence = false;
+    granted = false;
+    fresh = false;
+    starved = 0;
+    grants = 0;
+    deferrals = 0;
+    missed = 0;
+    worstSlack = 0x7FFFFFFF;
+    longest = 0;
+}
+
+/**
+ * Stops scheduling, e.g. after STOP. Every request is granted again.
+ */
+void ADS129X_Arbiter::end() {
+    active = false;
+}
+
+/**
+ * Sets the margin kept free before a readback deadline.
+ * @param _guard margin in us
+ */
+void ADS129X_Arbiter::setGuard(unsigned int _guard) {
+    guard = _guard;
+}
+
+/**
+ * Reads a frame if DRDY is low (polling mode) and updates the DRDY phase
+ * from the frames that arrived. Frames stay available to getData/peek.
+ * @return number of frames available
+ */
+byte ADS129X_Arbiter::poll() {
+    if (!active) {
+        return 0;
+    }
+    const long *frames;
+    const unsigned long *sequences;
+    const uint32_t *timestamps;
+    uint32_t before = ADS129X_HAL::ticks();
+    byte count = ads->peek(&frames, &sequences, &timestamps);
+    uint32_t after = ADS129X_HAL::ticks();
+    boolean read = false;
+    for (byte i = 0; i < count; i++) {
+        long step = haveSequence ? (long) (sequences[i] - lastSequence) : 1;
+        if (step <= 0) {
+            continue;
+        }
+        lastSequence = sequences[i];
+        haveSequence = true;
+        read = true;
+#ifdef ADS129X_POLLING
+        observe(timestamps[i], after, step);
+#else
+        observe(timestamps[i], timestamps[i] + readTicks, step);
+#endif
+    }
+#ifdef ADS129X_POLLING
+    // only here does peek clock the frame itself
+    if (read && after - before > readTicks) {
+        readTicks = after - before;
+    }
+#else
+    (void) before;
+    (void) after;
+    (void) read;
+#endif
+    return count;
+}
+
+/**
+ * Updates the DRDY phase with a frame. Polling only ever sees DRDY late, so
+ * the phase follows the earliest timestamps: it moves back at once and
+ * forward, to follow a slow sample clock, by the smallest delay seen over
+ * ADS129X_ARBITER_WINDOW frames.
+ * @param _timestamp time the frame was found ready
+ * @param _readEnd   time its readback was complete
+ * @param _step      frames read since the last one seen here; the ones in
+ *                   between were taken by getData before poll() saw them
+ */
+void ADS129X_Arbiter::observe(uint32_t _timestamp, uint32_t _readEnd, unsigned long _step) {
+    if (synced) {
+        expected += (_step - 1) * period;
+    } else {
+        expected = _timestamp;
+        minLate = 0xFFFFFFFF;
+        window = 0;
+        synced = true;
+    }
+    int32_t late = (int32_t) (_timestamp - expected);
+    if (late < 0) {
+        expected = _timestamp;
+        late = 0;
+    } else if ((uint32_t) late >= period) {
+        // the conversions in between were overwritten
+        uint32_t skipped = late / period;
+        missed += skipped;
+        expected += skipped * period;
+        late -= skipped * period;
+    }
+    if ((uint32_t) late < minLate) {
+        minLate = late;
+    }
+    if (++window >= ADS129X_ARBITER_WINDOW) {
+        expected += minLate;
+        minLate = 0xFFFFFFFF;
+        window = 0;
+    }
+    fresh = true;
+    int32_t slack = (int32_t) (expected + period - _readEnd);
+    if (slack < worstSlack) {
+        worstSlack = slack;
+    }
+    expected += period;
+}
+
+/**
+ * Asks for the bus. A transaction is granted if it ends early enough to
+ * read the next frame before the conversion after it. One that does not
+ * fit even right after a readback, because it is longer than a gap or
+ * because the loop keeps reading late, is granted right after a readback
+ * once it has waited ADS129X_ARBITER_PATIENCE gaps; the frames it costs
+ * show up in getMissed().
+ * Call release() when it is done.
+ * @param _duration expected length of the transaction in us
+ * @return          true if the bus may be used now
+ */
+boolean ADS129X_Arbiter::request(unsigned long _duration) {
+    if (!active) {
+        granted = true;
+        grantTime = ADS129X_HAL::ticks();
+        grants++;
+        return true;
+    }
+    poll();
+    uint32_t now = ADS129X_HAL::ticks();
+    uint32_t length = _duration * ticksPerMicro;
+    uint32_t reserve = readTicks + guard * ticksPerMicro;
+    boolean fits;
+    if (!synced) {
+        // phase unknown: only what cannot delay a readback by a period
+        fits = length + reserve <= period;
+    } else {
+        int32_t left = (int32_t) (expected + period - reserve - now);
+        fits = left >= 0 && length <= (uint32_t) left;
+    }
+    if (!fits) {
+        deferrals++;
+        // right after a readback is the most room a gap has; a transaction
+        // too long for any gap, or turned away there too often, goes then
+        if (!fresh) {
+            return false;
+        }
+        fresh = false;
+        if (length + reserve <= 2 * period && ++starved < ADS129X_ARBITER_PATIENCE) {
+            return false;
+        }
+        deferrals--;
+    }
+    granted = true;
+    grantTime = now;
+    grants++;
+    fresh = false;
+    starved = 0;
+    return true;
+}
+
+/**
+ * Ends a granted transaction.
+ */
+void ADS129X_Arbiter::release() {
+    if (!granted) {
+        return;
+    }
+    granted = false;
+    uint32_t length = ADS129X_HAL::ticks() - grantTime;
+    if (length > longest) {
+        longest = length;
+    }
+}
+
+unsigned long ADS129X_Arbiter::getGrants() {
+    return grants;
+}
+
+unsigned long ADS129X_Arbiter::getDeferrals() {
+    return deferrals;
+}
+
+/**
+ * Conversions that were overwritten before they were read, as seen from
+ * gaps in the frame timestamps.
+ */
+unsigned long ADS129X_Arbiter::getMissed() {
+    return missed;
+}
+
+/**
+ * Smallest time that was left before the next conversion when a frame had
+ * been read.
+ * @return slack in us, 0 before the first frame
+ */
+long ADS129X_Arbiter::getWorstSlack() {
+    if (worstSlack == 0x7FFFFFFF) {
+        return 0;
+    }
+    return worstSlack / (int32_t) ticksPerMicro;
+}
+
+/**
+ * Longest granted transaction, from request() to release().
+ * @return length in us
+ */
+unsigned long ADS129X_Arbiter::getLongestTransaction() {
+    return longest / ticksPerMicro;
+}
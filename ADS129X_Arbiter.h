@@ -0,0 +1,95 @@
+/**
+ * ADS129X_Arbiter.h
+ *
+ * Shares the SPI bus between an ADS129X and other devices, e.g. a radio.
+ * The arbiter tracks the DRDY phase from the frame timestamps and knows the
+ * sample period, so it can tell whether a transaction of a given length
+ * ends early enough for the next frame to be read before the conversion
+ * after it overwrites it. Transactions that do not fit are deferred to a
+ * later loop pass:
+ *
+ *     arbiter.begin();                   // after START
+ *     ...
+ *     void loop() {
+ *         arbiter.poll();                // reads the ADC when DRDY is low
+ *         while (ADS.getData(buffer)) ...
+ *         if (radioBusy && arbiter.request(800)) {
+ *             radio.write(...);           // up to 800 us on the bus
+ *             arbiter.release();
+ *         }
+ *     }
+ *
+ * Meant for ADS129X_POLLING, where the frame is only read when the loop
+ * gets to it. ADS129X_POLLING has to be set for the whole build, as it
+ * changes how this file times frames. In interrupt mode it keeps long transactions from delaying
+ * the DRDY interrupt into the next conversion. Misses and the worst-case
+ * slack, the time that was left before the next conversion when a frame
+ * was read, are recorded.
+ */
+
+#ifndef ____ADS129X_ARBITER__
+#define ____ADS129X_ARBITER__
+
+#include "ADS129X.h"
+
+// Safety margin in us kept free before a readback deadline, for the loop
+// to get from the end of a transaction to poll()
+#ifndef ADS129X_ARBITER_GUARD
+#define ADS129X_ARBITER_GUARD 20
+#endif
+
+// Frames over which the smallest DRDY delay is taken to track the phase
+#ifndef ADS129X_ARBITER_WINDOW
+#define ADS129X_ARBITER_WINDOW 32
+#endif
+
+// Gaps a transaction that does not fit waits before it is granted anyway
+#ifndef ADS129X_ARBITER_PATIENCE
+#define ADS129X_ARBITER_PATIENCE 4
+#endif
+
+// Time in us a readback takes besides clocking the frame (CS, command
+// decoding, unpack)
+#define ADS129X_ARBITER_OVERHEAD 10
+
+class ADS129X_Arbiter {
+    public:
+        ADS129X_Arbiter(ADS129X *_ads);
+
+        void begin();
+        void end();
+        void setGuard(unsigned int _guard);
+
+        byte poll();
+        boolean request(unsigned long _duration);
+        void release();
+
+        unsigned long getGrants();
+        unsigned long getDeferrals();
+        unsigned long getMissed();
+        long getWorstSlack();
+        unsigned long getLongestTransaction();
+
+    private:
+        ADS129X *ads;
+        boolean active, synced, haveSequence, granted;
+        boolean fresh; // a frame was read since the last grant
+        byte starved;  // gaps the pending transaction did not fit
+        uint32_t ticksPerMicro;
+        uint32_t period;      // sample period in ticks
+        uint32_t readTicks;   // longest readback seen
+        uint32_t guard;
+        uint32_t expected;    // predicted time of the next DRDY
+        uint32_t minLate;     // smallest DRDY delay in this window
+        byte window;
+        uint32_t grantTime;
+        unsigned long lastSequence;
+
+        unsigned long grants, deferrals, missed;
+        int32_t worstSlack;
+        uint32_t longest;
+
+        void observe(uint32_t _timestamp, uint32_t _readEnd, unsigned long _step);
+};
+
+#endif
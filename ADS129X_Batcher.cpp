@@ -0,0 +1,143 @@
+/**
+ * ADS129X_Batcher.cpp
+ *
+ * Packs frames into MTU-sized packets.
+ */
+
+#include "ADS129X_Batcher.h"
+
+/**
+ * Creates a batcher. With a 20-byte MTU up to 6 single-channel frames fit
+ * one packet; at least one frame has to fit.
+ * @param _mtu      packet size of the link (at most ADS129X_BATCH_MTU)
+ * @param _channels number of channels sent, starting at channel 1
+ * @param _status   whether the status word is sent
+ */
+ADS129X_Batcher::ADS129X_Batcher(byte _mtu, byte _channels, boolean _status) {
+    if (_mtu > ADS129X_BATCH_MTU) _mtu = ADS129X_BATCH_MTU;
+    channels = _channels;
+    firstWord = _status ? 0 : 1;
+    frameBytes = 3 * (channels + 1 - firstWord);
+    framesPerPacket = (_mtu > 2 && frameBytes > 0) ? (_mtu - 2) / frameBytes : 0;
+    deadline = 0;
+    reset();
+}
+
+/**
+ * Sets how long a frame may wait for the packet to fill up. poll sends the
+ * packet once the deadline has passed.
+ * @param _us deadline in us, 0 to only send full packets
+ */
+void ADS129X_Batcher::setDeadline(unsigned long _us) {
+    deadline = _us;
+}
+
+/**
+ * Number of frames in a full packet; 0 if a frame does not fit the MTU.
+ */
+byte ADS129X_Batcher::getFramesPerPacket() {
+    return framesPerPacket;
+}
+
+/**
+ * Drops buffered frames.
+ */
+void ADS129X_Batcher::reset() {
+    frames = 0;
+    counter = 0;
+}
+
+/**
+ * Adds a frame. If frames were dropped before it, the buffered packet is
+ * sent first and the frame starts the next one.
+ * @param _frame    frame as returned by getData
+ * @param _sequence sequence number of the frame, as returned by getData
+ * @param _packet   buffer for MTU bytes
+ * @return length of the packet written to _packet when it is full or
+ *         followed by a gap, else 0
+ */
+byte ADS129X_Batcher::add(const long *_frame, unsigned long _sequence, byte *_packet) {
+    if (framesPerPacket == 0) {
+        return 0;
+    }
+    byte length = 0;
+    if (frames > 0 && _sequence != counter) {
+        length = flush(_packet);
+    }
+    counter = _sequence + 1;
+    if (frames == 0) {
+        buffer[0] = _sequence >> 8;
+        buffer[1] = _sequence;
+        firstTime = ADS129X_HAL::micros();
+    }
+    byte *p = buffer + 2 + frames * frameBytes;
+    for (byte i = firstWord; i <= channels; i++) {
+        *p++ = (byte) (_frame[i] >> 16);
+        *p++ = (byte) (_frame[i] >> 8);
+        *p++ = (byte) _frame[i];
+    }
+    frames++;
+    if (length == 0 && frames >= framesPerPacket) {
+        return flush(_packet);
+    }
+    return length;
+}
+
+/**
+ * Sends the packet if its oldest frame has passed the deadline. Call this
+ * regularly, e.g. once per loop.
+ * @param _packet buffer for MTU bytes
+ * @return packet length, 0 if nothing is due
+ */
+byte ADS129X_Batcher::poll(byte *_packet) {
+    if (frames > 0 && deadline > 0 && ADS129X_HAL::micros() - firstTime >= deadline) {
+        return flush(_packet);
+    }
+    return 0;
+}
+
+/**
+ * Sends the packet even if it is not full.
+ * @param _packet buffer for MTU bytes
+ * @return packet length, 0 if there were no frames
+ */
+byte ADS129X_Batcher::flush(byte *_packet) {
+    if (frames == 0) {
+        return 0;
+    }
+    byte length = 2 + frames * frameBytes;
+    memcpy(_packet, buffer, length);
+    frames = 0;
+    return length;
+}
+
+/**
+ * Unpacks a received packet into frames in the getData layout. When the
+ * status word is not sent, word 0 is set to 0.
+ * @param _packet   received packet
+ * @param _length   packet length
+ * @param _channels number of channels per frame, as given to the batcher
+ * @param _status   whether the status word is sent
+ * @param _frames   buffer for (1 + _channels) words per frame
+ * @param _counter  receives the sequence number of the first frame (16 bits)
+ * @return number of frames, 0 if the length does not match
+ */
+byte ADS129X_Batcher::unpack(const byte *_packet, byte _length, byte _channels, boolean _status,
+                             long *_frames, uint16_t *_counter) {
+    byte first = _status ? 0 : 1;
+    byte bytes = 3 * (_channels + 1 - first);
+    if (_length < 2 + bytes || (_length - 2) % bytes != 0) {
+        return 0;
+    }
+    *_counter = ((uint16_t) _packet[0] << 8) | _packet[1];
+    byte n = (_length - 2) / bytes;
+    const byte *p = _packet + 2;
+    for (byte f = 0; f < n; f++, _frames += 1 + _channels) {
+        _frames[0] = 0;
+        for (byte i = first; i <= _channels; i++, p += 3) {
+            long value = ((long) p[0] << 16) | ((long) p[1] << 8) | p[2];
+            _frames[i] = (i == 0) ? value : (value ^ 0x800000L) - 0x800000L;
+        }
+    }
+    return n;
+}
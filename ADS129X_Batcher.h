@@ -0,0 +1,56 @@
+/**
+ * ADS129X_Batcher.h
+ *
+ * Packs as many whole frames as fit into one link packet (a BLE
+ * notification, a UDP datagram, ...) instead of sending every frame on its
+ * own. A packet is sent when the next frame would not fit, or when the
+ * oldest frame in it has waited longer than the deadline.
+ *
+ * Packet layout, big-endian:
+ *
+ *     frame counter (2) | frame 0 | frame 1 | ...
+ *
+ * The counter is the low 16 bits of the acquisition sequence number of the
+ * first frame in the packet, so the receiver can place every sample on the
+ * time axis and count lost frames. A packet only holds consecutive frames;
+ * frames dropped before the batcher start a new packet.
+ * Each frame holds the status word (optional) and the first n channels,
+ * 3 bytes per word; the number of frames follows from the packet length.
+ * The link is expected to preserve packet boundaries.
+ */
+
+#ifndef ____ADS129X_BATCHER__
+#define ____ADS129X_BATCHER__
+
+#include "ADS129X_HAL.h"
+
+// Largest supported packet; 244 bytes is the ATT payload with BLE 4.2 data
+// length extension, the nRF8001 (BLE 4.0) takes 20
+#ifndef ADS129X_BATCH_MTU
+#define ADS129X_BATCH_MTU 244
+#endif
+
+class ADS129X_Batcher {
+    public:
+        ADS129X_Batcher(byte _mtu = 20, byte _channels = 8, boolean _status = false);
+
+        void setDeadline(unsigned long _us);
+        byte getFramesPerPacket();
+
+        byte add(const long *_frame, unsigned long _sequence, byte *_packet);
+        byte poll(byte *_packet);
+        byte flush(byte *_packet);
+        void reset();
+
+        static byte unpack(const byte *_packet, byte _length, byte _channels, boolean _status,
+                           long *_frames, uint16_t *_counter);
+
+    private:
+        byte channels, firstWord, frameBytes, framesPerPacket;
+        byte buffer[ADS129X_BATCH_MTU];
+        byte frames;
+        unsigned long counter; // sequence number expected next
+        unsigned long deadline, firstTime;
+};
+
+#endif
@@ -0,0 +1,374 @@
+/**
+ * ADS129X_Codec.cpp
+ *
+ * Block encoder and decoder for compressed ADS129X frames.
+ */
+
+#include "ADS129X_Codec.h"
+
+// Longest unary quotient; larger residuals are escaped and sent verbatim
+#define ADS129X_CODEC_QMAX 16
+
+// Width of an escaped residual: predictions are clamped to 24 bits, so the
+// zigzag-mapped residual is below 2^25
+#define ADS129X_CODEC_ESCAPE_BITS 25
+
+// Header before the bit stream
+#define ADS129X_CODEC_HEADER 4
+
+static inline long ADS129X_predict(byte _order, long _x1, long _x2) {
+    long p = (_order == 2) ? 2 * _x1 - _x2 : (_order == 1) ? _x1 : 0;
+    if (p > 0x7FFFFFL) return 0x7FFFFFL;
+    if (p < -0x800000L) return -0x800000L;
+    return p;
+}
+
+static inline unsigned long ADS129X_abs(long _value) {
+    return (_value < 0) ? -_value : _value;
+}
+
+// k follows log2 of the running mean of the residuals, one step per sample
+static inline void ADS129X_adapt(unsigned long &_mean, byte &_k, uint32_t _u) {
+    _mean += _u - (_mean >> 4);
+    unsigned long m = _mean >> 4;
+    if ((m >> _k) >= 2 && _k < 24) {
+        _k++;
+    } else if (_k > 0 && (m >> _k) == 0) {
+        _k--;
+    }
+}
+
+/**
+ * Creates an encoder.
+ * @param _channels       number of channels per frame (1-ADS129X_CODEC_CHANNELS)
+ * @param _framesPerBlock frames per block (1-ADS129X_CODEC_FRAMES); smaller
+ *                        blocks lower latency and the cost of a lost block
+ */
+ADS129X_Encoder::ADS129X_Encoder(byte _channels, byte _framesPerBlock) {
+    channels = (_channels > ADS129X_CODEC_CHANNELS) ? ADS129X_CODEC_CHANNELS : _channels;
+    framesPerBlock = (_framesPerBlock > ADS129X_CODEC_FRAMES) ? ADS129X_CODEC_FRAMES : _framesPerBlock;
+    if (framesPerBlock < 1) framesPerBlock = 1;
+    reset();
+}
+
+/**
+ * Drops the current block.
+ */
+void ADS129X_Encoder::reset() {
+    counter = 0;
+    for (byte c = 0; c < channels; c++) {
+        order[c] = 1;
+        k[c] = 8;
+        cost[c][0] = cost[c][1] = cost[c][2] = 0;
+    }
+    startBlock();
+}
+
+void ADS129X_Encoder::startBlock() {
+    frames = 0;
+    bitCount = 8 * ADS129X_CODEC_HEADER;
+    bits = 0;
+    pending = 0;
+    payload[2] = channels;
+    for (byte c = 0; c < channels; c++) {
+        // the predictor that did best on the last block is used for this one
+        if (cost[c][0] | cost[c][1] | cost[c][2]) {
+            byte best = 0;
+            for (byte o = 1; o < 3; o++) {
+                if (cost[c][o] < cost[c][best]) best = o;
+            }
+            order[c] = best;
+        }
+        cost[c][0] = cost[c][1] = cost[c][2] = 0;
+        putBits(order[c], 2);
+        putBits(k[c], 5);
+        mean[c] = (unsigned long) 16 << k[c];
+    }
+}
+
+/**
+ * Appends _count bits (at most 25) to the payload, most significant first.
+ */
+void ADS129X_Encoder::putBits(uint32_t _value, byte _count) {
+    bits = (bits << _count) | (_value & ((1UL << _count) - 1));
+    pending += _count;
+    while (pending >= 8) {
+        pending -= 8;
+        payload[bitCount >> 3] = bits >> pending;
+        bitCount += 8;
+    }
+}
+
+void ADS129X_Encoder::putResidual(byte _c, long _residual) {
+    uint32_t u = ((uint32_t) _residual << 1) ^ (uint32_t) (_residual >> 31);
+    uint32_t q = u >> k[_c];
+    if (q < ADS129X_CODEC_QMAX) {
+        putBits((1UL << (q + 1)) - 2, q + 1); // q ones and a zero
+        putBits(u, k[_c]);
+    } else {
+        putBits((1UL << ADS129X_CODEC_QMAX) - 1, ADS129X_CODEC_QMAX);
+        putBits(u, ADS129X_CODEC_ESCAPE_BITS);
+    }
+    ADS129X_adapt(mean[_c], k[_c], u);
+}
+
+/**
+ * Adds a frame to the current block. If frames were dropped before it, the
+ * current block is completed first and the frame starts the next one.
+ * @param _frame    frame as returned by getData
+ * @param _sequence sequence number of the frame, as returned by getData
+ * @param _block    buffer for ADS129X_BLOCK_SIZE bytes
+ * @return length of the completed block written to _block, 0 if the block
+ *         is not complete yet
+ */
+byte ADS129X_Encoder::addFrame(const long *_frame, unsigned long _sequence, byte *_block) {
+    byte length = 0;
+    if (frames > 0 && _sequence != counter) {
+        length = flush(_block);
+    }
+    counter = _sequence + 1;
+    if (frames == 0) {
+        payload[0] = _sequence >> 8;
+        payload[1] = _sequence;
+        status = _frame[0];
+        putBits(status, 24);
+        for (byte c = 0; c < channels; c++) {
+            putBits(_frame[c + 1], 24);
+        }
+    } else {
+        if (_frame[0] != status) {
+            status = _frame[0];
+            putBits(1, 1);
+            putBits(status, 24);
+        } else {
+            putBits(0, 1);
+        }
+        for (byte c = 0; c < channels; c++) {
+            long x = _frame[c + 1];
+            long e0 = x, e1 = x - x1[c];
+            long e2 = x - ADS129X_predict(2, x1[c], x2[c]);
+            cost[c][0] += ADS129X_abs(e0);
+            cost[c][1] += ADS129X_abs(e1);
+            cost[c][2] += ADS129X_abs(e2);
+            putResidual(c, (order[c] == 0) ? e0 : (order[c] == 1) ? e1 : e2);
+        }
+    }
+    // after the first frame x2 = x1, so order 2 starts out as order 1
+    for (byte c = 0; c < channels; c++) {
+        x2[c] = (frames == 0) ? _frame[c + 1] : x1[c];
+        x1[c] = _frame[c + 1];
+    }
+    frames++;
+
+    // close the block if the next frame might not fit; a block closed for a
+    // gap leaves one frame here, which always fits
+    unsigned int worstCase = 25 + channels * (ADS129X_CODEC_QMAX + ADS129X_CODEC_ESCAPE_BITS);
+    if (length == 0 &&
+        (frames >= framesPerBlock || bitCount + pending + worstCase > 8 * (ADS129X_CODEC_PAYLOAD - 2))) {
+        return flush(_block);
+    }
+    return length;
+}
+
+/**
+ * Completes the current block even if it is not full.
+ * @param _block buffer for ADS129X_BLOCK_SIZE bytes
+ * @return block length, 0 if there were no frames
+ */
+byte ADS129X_Encoder::flush(byte *_block) {
+    if (frames == 0) {
+        return 0;
+    }
+    if (pending) {
+        putBits(0, 8 - pending);
+    }
+    byte n = bitCount >> 3;
+    payload[3] = frames;
+    uint16_t crc = ADS129X_crc16(payload, n);
+    payload[n++] = crc >> 8;
+    payload[n++] = crc;
+    byte length = ADS129X_cobsEncode(payload, n, _block);
+    startBlock();
+    return length;
+}
+
+ADS129X_BlockDecoder::ADS129X_BlockDecoder() {
+    reset();
+    blocks = 0;
+    lostFrames = 0;
+    errors = 0;
+    droppedBytes = 0;
+}
+
+/**
+ * Discard partial input; the next block starts after a delimiter.
+ */
+void ADS129X_BlockDecoder::reset() {
+    length = 0;
+    overflow = false;
+    synced = false;
+    haveCounter = false;
+    frames = 0;
+    channels = 0;
+    counter = 0;
+}
+
+/**
+ * Feed one received byte.
+ * @param _data received byte
+ * @return true when a complete, valid block was decoded
+ */
+boolean ADS129X_BlockDecoder::feed(byte _data) {
+    if (_data != 0x00) {
+        if (length < sizeof(buffer)) {
+            buffer[length++] = _data;
+        } else {
+            overflow = true;
+        }
+        return false;
+    }
+    boolean valid = false;
+    if (!synced) {
+        droppedBytes += length;
+        synced = true;
+    } else if (length > 0) {
+        valid = !overflow && decodeBlock();
+        if (!valid) {
+            errors++;
+            droppedBytes += length;
+        }
+    }
+    length = 0;
+    overflow = false;
+    return valid;
+}
+
+uint32_t ADS129X_BlockDecoder::getBits(byte _count) {
+    uint32_t value = 0;
+    for (byte i = 0; i < _count; i++) {
+        byte bit = (bitPos < inputBits) ? (input[bitPos >> 3] >> (7 - (bitPos & 7))) & 1 : 0;
+        value = (value << 1) | bit;
+        bitPos++;
+    }
+    return value;
+}
+
+boolean ADS129X_BlockDecoder::decodeBlock() {
+    byte n = ADS129X_cobsDecode(buffer, length);
+    if (n < ADS129X_CODEC_HEADER + 2) {
+        return false;
+    }
+    uint16_t crc = ((uint16_t) buffer[n-2] << 8) | buffer[n-1];
+    if (ADS129X_crc16(buffer, n - 2) != crc) {
+        return false;
+    }
+    byte _channels = buffer[2], _frames = buffer[3];
+    if (_channels < 1 || _channels > ADS129X_CODEC_CHANNELS || _frames < 1 || _frames > ADS129X_CODEC_FRAMES) {
+        return false;
+    }
+    input = buffer + ADS129X_CODEC_HEADER;
+    inputBits = 8 * (n - 2 - ADS129X_CODEC_HEADER);
+    bitPos = 0;
+
+    byte order[ADS129X_CODEC_CHANNELS], k[ADS129X_CODEC_CHANNELS];
+    unsigned long mean[ADS129X_CODEC_CHANNELS];
+    for (byte c = 0; c < _channels; c++) {
+        order[c] = getBits(2);
+        k[c] = getBits(5);
+        mean[c] = (unsigned long) 16 << k[c];
+    }
+    long status = getBits(24);
+    frame[0][0] = status;
+    for (byte c = 1; c <= _channels; c++) {
+        frame[0][c] = ((long) getBits(24) ^ 0x800000L) - 0x800000L;
+    }
+    for (byte f = 1; f < _frames; f++) {
+        if (getBits(1)) {
+            status = getBits(24);
+        }
+        frame[f][0] = status;
+        for (byte c = 0; c < _channels; c++) {
+            uint32_t q = 0;
+            while (q < ADS129X_CODEC_QMAX && getBits(1)) q++;
+            uint32_t u = (q < ADS129X_CODEC_QMAX) ? (q << k[c]) | getBits(k[c]) : getBits(ADS129X_CODEC_ESCAPE_BITS);
+            long e = (long) (u >> 1) ^ -(long) (u & 1);
+
+            long x1 = frame[f-1][c+1];
+            long x2 = (f >= 2) ? frame[f-2][c+1] : x1;
+            frame[f][c+1] = ADS129X_predict(order[c], x1, x2) + e;
+
+            ADS129X_adapt(mean[c], k[c], u);
+        }
+    }
+    if (bitPos > inputBits) {
+        return false;
+    }
+
+    // extend the 16-bit frame counter and count frames in lost blocks
+    uint16_t first = ((uint16_t) buffer[0] << 8) | buffer[1];
+    if (haveCounter) {
+        uint16_t missing = first - (uint16_t) counter;
+        lostFrames += missing;
+        counter += missing;
+    } else {
+        counter = first;
+        haveCounter = true;
+    }
+    counter += _frames;
+    frames = _frames;
+    channels = _channels;
+    blocks++;
+    return true;
+}
+
+/**
+ * Frame from the last decoded block.
+ * @param _index frame index (0 to getFrames()-1)
+ */
+const long *ADS129X_BlockDecoder::getFrame(byte _index) {
+    return frame[_index];
+}
+
+/**
+ * Number of frames in the last decoded block.
+ */
+byte ADS129X_BlockDecoder::getFrames() {
+    return frames;
+}
+
+byte ADS129X_BlockDecoder::getChannels() {
+    return channels;
+}
+
+/**
+ * Index of the first frame of the last decoded block since the first block
+ * received.
+ */
+unsigned long ADS129X_BlockDecoder::getCounter() {
+    return counter - frames;
+}
+
+unsigned long ADS129X_BlockDecoder::getBlocks() {
+    return blocks;
+}
+
+/**
+ * Frames missing according to the frame counters.
+ */
+unsigned long ADS129X_BlockDecoder::getLostFrames() {
+    return lostFrames;
+}
+
+/**
+ * Blocks rejected because of framing or CRC errors.
+ */
+unsigned long ADS129X_BlockDecoder::getErrors() {
+    return errors;
+}
+
+/**
+ * Bytes discarded while resynchronizing or in rejected blocks.
+ */
+unsigned long ADS129X_BlockDecoder::getDroppedBytes() {
+    return droppedBytes;
+}
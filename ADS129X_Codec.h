@@ -0,0 +1,120 @@
+/**
+ * ADS129X_Codec.h
+ *
+ * Lossless compression of ADS129X frames for low-bandwidth links.
+ *
+ * Frames are grouped into blocks. Every block is decodable on its own, so a
+ * lost block costs exactly the frames it contained. Within a block each
+ * channel is predicted from its previous samples (order 0, 1 or 2, picked
+ * per channel from the statistics of the previous block) and the residuals
+ * are Rice coded with a parameter k that follows a running average of the
+ * residual magnitude. The status word is sent once per block and again only
+ * when it changes.
+ *
+ * Block payload, big-endian:
+ *
+ *     frame counter (2) | channels (1) | frames (1) | bit stream | CRC-16 (2)
+ *
+ * The frame counter is the low 16 bits of the acquisition sequence number
+ * of the first frame. A block only holds consecutive frames, so frames the
+ * acquisition dropped show up at the receiver like frames of lost blocks.
+ *
+ * The bit stream starts with order (2 bits) and initial k (5 bits) for
+ * every channel, followed by the first frame verbatim (24 bits per word)
+ * and then, per frame, a status flag bit (followed by the new 24-bit status
+ * word if set) and one Rice code per channel. The payload is COBS-encoded
+ * and delimited like the packets in ADS129X_Protocol.h, so a receiver
+ * resynchronizes at the next block.
+ */
+
+#ifndef ____ADS129X_CODEC__
+#define ____ADS129X_CODEC__
+
+#include "ADS129X_Protocol.h"
+
+// Maximum number of channels per block
+#ifndef ADS129X_CODEC_CHANNELS
+#define ADS129X_CODEC_CHANNELS 8
+#endif
+
+// Maximum number of frames per block
+#ifndef ADS129X_CODEC_FRAMES
+#define ADS129X_CODEC_FRAMES 32
+#endif
+
+// Payload bytes per block, at most ADS129X_COBS_MAX
+#ifndef ADS129X_CODEC_PAYLOAD
+#define ADS129X_CODEC_PAYLOAD 240
+#endif
+
+// Encoded block including COBS overhead and delimiter
+#define ADS129X_BLOCK_SIZE (ADS129X_CODEC_PAYLOAD + 2)
+
+class ADS129X_Encoder {
+    public:
+        ADS129X_Encoder(byte _channels = 8, byte _framesPerBlock = ADS129X_CODEC_FRAMES);
+
+        byte addFrame(const long *_frame, unsigned long _sequence, byte *_block);
+        byte flush(byte *_block);
+        void reset();
+
+    private:
+        byte channels, framesPerBlock, frames;
+        unsigned long counter; // sequence number expected next
+        byte payload[ADS129X_CODEC_PAYLOAD];
+        unsigned int bitCount; // bits written to the payload
+        uint32_t bits;         // pending bits, not yet stored
+        byte pending;
+        long status;
+
+        // per-channel predictor and Rice state
+        long x1[ADS129X_CODEC_CHANNELS], x2[ADS129X_CODEC_CHANNELS];
+        unsigned long mean[ADS129X_CODEC_CHANNELS]; // 16x running mean
+        byte k[ADS129X_CODEC_CHANNELS];
+        byte order[ADS129X_CODEC_CHANNELS];
+        unsigned long cost[ADS129X_CODEC_CHANNELS][3];
+
+        void startBlock();
+        void putBits(uint32_t _value, byte _count);
+        void putResidual(byte _channel, long _residual);
+};
+
+/**
+ * Incremental block decoder, fed one byte at a time.
+ */
+class ADS129X_BlockDecoder {
+    public:
+        ADS129X_BlockDecoder();
+
+        boolean feed(byte _data);
+        void reset();
+
+        // last decoded block: frame _index, word 0 status, words 1..channels data
+        const long *getFrame(byte _index);
+        byte getFrames();
+        byte getChannels();
+        unsigned long getCounter();
+
+        unsigned long getBlocks();
+        unsigned long getLostFrames();
+        unsigned long getErrors();
+        unsigned long getDroppedBytes();
+
+    private:
+        byte buffer[ADS129X_BLOCK_SIZE];
+        byte length;
+        boolean overflow, synced, haveCounter;
+        long frame[ADS129X_CODEC_FRAMES][1 + ADS129X_CODEC_CHANNELS];
+        byte frames, channels;
+        unsigned long counter;
+        unsigned long blocks, lostFrames, errors, droppedBytes;
+
+        // bit reader
+        const byte *input;
+        unsigned int inputBits, bitPos;
+
+        boolean decodeBlock();
+        uint32_t getBits(byte _count);
+};
+
+#endif
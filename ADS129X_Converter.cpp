@@ -0,0 +1,177 @@
+/**
+ * ADS129X_Converter.cpp
+ *
+ * Conversion of raw frames to microvolts.
+ */
+
+#include "ADS129X_Converter.h"
+
+// PGA gain for each ADS129X_GAIN_* code; 0 for the reserved code
+static const byte ADS129X_PGA_GAIN[8] = { 6, 1, 2, 3, 4, 8, 12, 0 };
+
+/**
+ * Creates a converter that is configured by hand, for all channels at gain
+ * 6 (the power-up default) and a 2.4 V reference.
+ * @param _channels number of channels per frame (1-ADS129X_CONVERTER_CHANNELS)
+ */
+ADS129X_Converter::ADS129X_Converter(byte _channels) {
+    init(NULL, _channels);
+}
+
+/**
+ * Creates a converter that follows the configuration of a device. Gains
+ * and reference are taken from its register shadow once they are written
+ * to the device; staged values only apply after commit(), as frames
+ * converted before that were acquired with the old ones.
+ * @param _ads      device
+ * @param _channels number of channels per frame (1-ADS129X_CONVERTER_CHANNELS)
+ */
+ADS129X_Converter::ADS129X_Converter(ADS129X *_ads, byte _channels) {
+    init(_ads, _channels);
+}
+
+void ADS129X_Converter::init(ADS129X *_ads, byte _channels) {
+    ads = _ads;
+    channels = (_channels > ADS129X_CONVERTER_CHANNELS) ? ADS129X_CONVERTER_CHANNELS : _channels;
+    memset(gains, ADS129X_GAIN_6X, sizeof(gains));
+    vref = 2.4f;
+    fixedReference = false;
+    if (ads != NULL) {
+        version = ads->getConfigVersion() - 1; // forces an update
+        track();
+    } else {
+        update();
+    }
+}
+
+/**
+ * Sets the PGA gain of a channel. Ignored when attached to a device.
+ * @param _channel channel (1-n), 0 for all channels
+ * @param _gain    gain setting (ADS129X_GAIN_*)
+ */
+void ADS129X_Converter::setGain(byte _channel, byte _gain) {
+    if (ads != NULL || _channel > channels) {
+        return;
+    }
+    byte first = _channel ? _channel - 1 : 0;
+    byte last = _channel ? _channel : channels;
+    for (byte c = first; c < last; c++) {
+        gains[c] = _gain & 7;
+    }
+    update();
+}
+
+/**
+ * Sets the reference voltage, e.g. for an external reference. When
+ * attached to a device the internal reference selected by VREF_4V is used
+ * until this is called.
+ * @param _vref reference voltage in V, 0 to follow VREF_4V again
+ */
+void ADS129X_Converter::setReference(float _vref) {
+    fixedReference = _vref > 0;
+    if (fixedReference) {
+        vref = _vref;
+    } else if (ads == NULL) {
+        vref = 2.4f;
+    }
+    if (ads != NULL) {
+        version = ads->getConfigVersion() - 1;
+        track();
+    } else {
+        update();
+    }
+}
+
+/**
+ * Computes the per-channel factors. The fixed-point multiplier is derived
+ * in integer arithmetic, as a float would round it to 24 bits.
+ */
+void ADS129X_Converter::update() {
+    uint64_t microvolts = (uint64_t) (vref * 1e6f + 0.5f);
+    for (byte c = 0; c < channels; c++) {
+        byte gain = ADS129X_PGA_GAIN[gains[c]];
+        if (gain == 0) {
+            scale[c] = 0.0f;
+            multiplier[c] = 0;
+            continue;
+        }
+        uint64_t lsb = (uint64_t) gain * 8388607UL;
+        scale[c] = vref * 1e6f / lsb;
+        multiplier[c] = ((microvolts << (23 + ADS129X_CONVERTER_FRACTION)) + lsb / 2) / lsb;
+    }
+}
+
+/**
+ * Picks up configuration changes of the attached device. Staged registers
+ * keep the value last written.
+ */
+void ADS129X_Converter::track() {
+    if (ads == NULL || ads->getConfigVersion() == version) {
+        return;
+    }
+    version = ads->getConfigVersion();
+    for (byte c = 0; c < channels; c++) {
+        if (!ads->isStaged(ADS129X_REG_CH1SET + c)) {
+            gains[c] = ads->getGain(c + 1);
+        }
+    }
+    if (!fixedReference && !ads->isStaged(ADS129X_REG_CONFIG3)) {
+        vref = (ads->getRegister(ADS129X_REG_CONFIG3) & (1<<ADS129X_BIT_VREF_4V)) ? 4.0f : 2.4f;
+    }
+    update();
+}
+
+/**
+ * Size of one LSB of a channel.
+ * @param  _channel channel (1-n)
+ * @return          uV per LSB
+ */
+float ADS129X_Converter::getScale(byte _channel) {
+    track();
+    if (_channel < 1 || _channel > channels) {
+        return 0.0f;
+    }
+    return scale[_channel - 1];
+}
+
+/**
+ * Converts frames to microvolts. The status word is passed through.
+ * @param _frames frames of 1 + channels words
+ * @param _count  number of frames
+ * @param _out    buffer for _count frames of 1 + channels values
+ */
+void ADS129X_Converter::toMicrovolts(const long *_frames, unsigned int _count, float *_out) {
+    track();
+    // local copies, so the compiler knows the stores cannot change them
+    const byte n = channels;
+    float k[ADS129X_CONVERTER_CHANNELS];
+    memcpy(k, scale, sizeof(k));
+    for (unsigned int f = 0; f < _count; f++, _frames += 1 + n, _out += 1 + n) {
+        _out[0] = _frames[0];
+        for (byte c = 0; c < n; c++) {
+            _out[1 + c] = _frames[1 + c] * k[c];
+        }
+    }
+}
+
+/**
+ * Converts frames to microvolts with ADS129X_CONVERTER_FRACTION fractional
+ * bits, rounded to nearest. The status word is passed through. _out may be
+ * _frames for in-place conversion.
+ * @param _frames frames of 1 + channels words
+ * @param _count  number of frames
+ * @param _out    buffer for _count frames of 1 + channels words
+ */
+void ADS129X_Converter::toMicrovolts(const long *_frames, unsigned int _count, long *_out) {
+    track();
+    const byte n = channels;
+    int32_t k[ADS129X_CONVERTER_CHANNELS];
+    memcpy(k, multiplier, sizeof(k));
+    const int64_t round = 1L << 22;
+    for (unsigned int f = 0; f < _count; f++, _frames += 1 + n, _out += 1 + n) {
+        _out[0] = _frames[0];
+        for (byte c = 0; c < n; c++) {
+            _out[1 + c] = (long) (((int64_t) (int32_t) _frames[1 + c] * k[c] + round) >> 23);
+        }
+    }
+}
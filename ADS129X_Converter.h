@@ -0,0 +1,69 @@
+/**
+ * ADS129X_Converter.h
+ *
+ * Converts frames returned by getData to microvolts at the input, either as
+ * float or as fixed-point int32 with ADS129X_CONVERTER_FRACTION fractional
+ * bits. One LSB is VREF / gain / (2^23 - 1).
+ *
+ * Per-channel factors are computed once from the PGA gain of each channel
+ * and the reference voltage, and again only when the configuration
+ * changes. Attached to an ADS129X object they follow its register shadow
+ * (CHnSET gain, CONFIG3 VREF_4V) as written to the device; on their own, e.g. for recordings on the
+ * host, they are set with setGain and setReference.
+ *
+ * The kernels run over a batch of frames with one multiply per sample and
+ * no branches, so compilers vectorize them for host SIMD, and on Cortex-M
+ * the fixed-point path is a single SMULL per sample.
+ *
+ * Frame layout is the one used by getData: word 0 is the status word,
+ * which is passed through, words 1..channels are channel data.
+ */
+
+#ifndef ____ADS129X_CONVERTER__
+#define ____ADS129X_CONVERTER__
+
+#include "ADS129X.h"
+
+// Maximum number of channels per frame
+#ifndef ADS129X_CONVERTER_CHANNELS
+#define ADS129X_CONVERTER_CHANNELS 8
+#endif
+
+// Fractional bits of the fixed-point output; with 8 bits the full scale of
+// gain 1 at VREF 4 V (+-4e6 uV) still fits an int32
+#ifndef ADS129X_CONVERTER_FRACTION
+#define ADS129X_CONVERTER_FRACTION 8
+#endif
+
+class ADS129X_Converter {
+    public:
+        ADS129X_Converter(byte _channels = 8);
+        ADS129X_Converter(ADS129X *_ads, byte _channels = 8);
+
+        // configuration when not attached to a device; _channel 1-n, 0 for all
+        void setGain(byte _channel, byte _gain);
+        void setReference(float _vref);
+
+        float getScale(byte _channel);
+        void toMicrovolts(const long *_frames, unsigned int _count, float *_out);
+        void toMicrovolts(const long *_frames, unsigned int _count, long *_out);
+
+    private:
+        ADS129X *ads;
+        unsigned long version;
+        byte channels;
+        byte gains[ADS129X_CONVERTER_CHANNELS];
+        float vref;
+        boolean fixedReference; // set by setReference, VREF_4V is ignored
+
+        // uV per LSB, as float and with 23 + ADS129X_CONVERTER_FRACTION
+        // fractional bits
+        float scale[ADS129X_CONVERTER_CHANNELS];
+        int32_t multiplier[ADS129X_CONVERTER_CHANNELS];
+
+        void init(ADS129X *_ads, byte _channels);
+        void update();
+        void track();
+};
+
+#endif
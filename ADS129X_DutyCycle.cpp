@@ -0,0 +1,297 @@
+/**
+ * ADS129X_DutyCycle.cpp
+ *
+ * Single-shot and standby duty cycling for low-rate acquisition.
+ */
+
+#include "ADS129X_DutyCycle.h"
+
+/**
+ * Creates a duty cycle for an ADS129X, at 1 SPS until setRate is called.
+ * @param _ads   device
+ * @param _START START pin, -1 if it is tied low; conversions are then
+ *               started with the START command
+ */
+ADS129X_DutyCycle::ADS129X_DutyCycle(ADS129X *_ads, int _START) {
+    ads = _ads;
+    START = _START;
+    state = ADS129X_DUTY_IDLE;
+    ready = false;
+    elapsed = 0;
+    awake = 0;
+    frames = 0;
+    late = 0;
+    timeouts = 0;
+    overruns = 0;
+    missed = 0;
+    setRate(1);
+}
+
+/**
+ * Sets the effective sample rate. With a burst of one frame every wake-up
+ * is a single-shot conversion; longer bursts convert continuously at the
+ * data rate in CONFIG1 and stop after the last frame. Takes effect at the
+ * next begin().
+ * @param _rate  frames per second, averaged over the bursts
+ * @param _burst frames per wake-up
+ */
+void ADS129X_DutyCycle::setRate(float _rate, byte _burst) {
+    burst = _burst ? _burst : 1;
+    if (_rate <= 0) {
+        _rate = 1;
+    }
+    interval = (unsigned long) (burst * 1e6f / _rate);
+}
+
+/**
+ * Highest effective rate the device can keep up with the data rate in
+ * CONFIG1 and the burst length, from the settling time each wake-up costs.
+ * Above it wake-ups run late and the device hardly sleeps. Commands and
+ * RDATA readback come on top, which matters close to the limit at 32 kSPS.
+ * @return frames per second
+ */
+float ADS129X_DutyCycle::getMaxRate() {
+    float period = 1e6f / ads->getNominalSampleRate();
+    return burst * 1e6f / (ads->getSettlingTime() + (burst - 1) * period);
+}
+
+/**
+ * Starts duty cycling. Conversions are stopped, the device leaves RDATAC
+ * mode, single-shot mode is set in CONFIG4 for bursts of one frame and
+ * the device is put in standby. The first wake-up is right away.
+ * Resets the statistics.
+ */
+void ADS129X_DutyCycle::begin() {
+    if (START >= 0) {
+        ADS129X_HAL::pinMode(START, OUTPUT);
+        ADS129X_HAL::digitalWrite(START, LOW);
+    }
+    ads->STOP();
+    ads->SDATAC();
+    config4 = ads->getRegister(ADS129X_REG_CONFIG4);
+    if (burst == 1) {
+        ads->setRegister(ADS129X_REG_CONFIG4, config4 | (1<<ADS129X_BIT_SINGLE_SHOT));
+    } else {
+        ads->setRegister(ADS129X_REG_CONFIG4, config4 & ~(1<<ADS129X_BIT_SINGLE_SHOT));
+    }
+    ads->commit();
+    ads->STANDBY();
+    unsigned long now = ADS129X_HAL::micros();
+    nextWake = now;
+    lastUpdate = now;
+    elapsed = 0;
+    awake = 0;
+    ready = false;
+    sequence = 0;
+    frames = 0;
+    late = 0;
+    timeouts = 0;
+    overruns = 0;
+    missed = 0;
+    period = ADS129X_HAL::ticksPerSecond() / ads->getNominalSampleRate();
+    state = ADS129X_DUTY_STANDBY;
+}
+
+/**
+ * Stops duty cycling and leaves the device awake, with conversions stopped
+ * and CONFIG4 as it was before begin(). It stays in SDATAC mode.
+ */
+void ADS129X_DutyCycle::end() {
+    if (state == ADS129X_DUTY_IDLE) {
+        return;
+    }
+    unsigned long now = ADS129X_HAL::micros();
+    elapsed += now - lastUpdate;
+    lastUpdate = now;
+    if (state == ADS129X_DUTY_CONVERTING) {
+        awake += now - wakeTime;
+    }
+    ads->WAKEUP();
+    if (START >= 0) {
+        ADS129X_HAL::digitalWrite(START, LOW);
+    }
+    ads->STOP();
+    ads->setRegister(ADS129X_REG_CONFIG4, config4);
+    ads->commit();
+    state = ADS129X_DUTY_IDLE;
+}
+
+void ADS129X_DutyCycle::wake(unsigned long _now) {
+    ads->WAKEUP();
+    if (START >= 0) {
+        ADS129X_HAL::digitalWrite(START, HIGH);
+    } else {
+        ads->START();
+    }
+    wakeTime = _now;
+    remaining = burst;
+    unsigned long conversion = (unsigned long) (1e6f / ads->getNominalSampleRate());
+    deadline = _now + ads->getSettlingTime() + (burst - 1) * conversion + ADS129X_DUTY_TIMEOUT;
+    state = ADS129X_DUTY_CONVERTING;
+}
+
+void ADS129X_DutyCycle::sleep(unsigned long _now) {
+    if (START >= 0) {
+        ADS129X_HAL::digitalWrite(START, LOW);
+    } else if (burst > 1 || remaining) {
+        ads->STOP();
+    }
+    ads->STANDBY();
+    awake += _now - wakeTime;
+    nextWake += interval;
+    if ((long) (_now - nextWake) > 0) {
+        // the wake-up took longer than the interval, or the loop came late:
+        // keep the rate from here instead of catching up
+        late++;
+        nextWake = _now;
+    }
+    state = ADS129X_DUTY_STANDBY;
+}
+
+/**
+ * Advances the duty cycle; call this regularly from the loop. Wakes the
+ * device when the next conversion is due, reads the frame with RDATA once
+ * DRDY is low and puts the device back in standby after the last frame of
+ * a burst. Frames are read late if poll() is, but within a burst one that
+ * is not read before the next conversion is lost.
+ * @return true if a frame is waiting for getData
+ */
+boolean ADS129X_DutyCycle::poll() {
+    if (state == ADS129X_DUTY_IDLE) {
+        return ready;
+    }
+    unsigned long now = ADS129X_HAL::micros();
+    elapsed += now - lastUpdate;
+    lastUpdate = now;
+    if (state == ADS129X_DUTY_STANDBY) {
+        if ((long) (now - nextWake) < 0) {
+            return ready;
+        }
+        wake(now);
+    }
+    if (ads->isDataReady()) {
+        if (ready) {
+            overruns++;
+        }
+        uint32_t readTime = ADS129X_HAL::ticks();
+        if (remaining < burst) {
+            // conversions that came and went since the last frame
+            uint32_t skipped = (readTime - timestamp + period / 2) / period;
+            if (skipped > 1) {
+                missed += skipped - 1;
+            }
+        }
+        timestamp = readTime;
+        ads->RDATA(frame);
+        sequence++;
+        frames++;
+        ready = true;
+        if (--remaining == 0) {
+            sleep(ADS129X_HAL::micros());
+        }
+    } else if ((long) (now - deadline) >= 0) {
+        // no DRDY, e.g. the START pin is not connected
+        timeouts++;
+        sleep(now);
+    }
+    return ready;
+}
+
+/**
+ * Returns the frame read by the last poll().
+ * @param _buffer    buffer for getFrameWords() words, as filled by
+ *                   ADS129X::getData
+ * @param _sequence  number of the frame since begin, counting from 1
+ * @param _timestamp time the frame was read in ADS129X_HAL::ticks()
+ * @return           false if there is no new frame
+ */
+boolean ADS129X_DutyCycle::getData(long *_buffer, unsigned long *_sequence, uint32_t *_timestamp) {
+    if (!ready) {
+        return false;
+    }
+    byte words = ads->getFrameWords();
+    for (byte i = 0; i < words; i++) {
+        _buffer[i] = frame[i];
+    }
+    if (_sequence != NULL) {
+        *_sequence = sequence;
+    }
+    if (_timestamp != NULL) {
+        *_timestamp = timestamp;
+    }
+    ready = false;
+    return true;
+}
+
+/**
+ * Current state (ADS129X_DUTY_*).
+ */
+byte ADS129X_DutyCycle::getState() {
+    return state;
+}
+
+/**
+ * Frames read since begin.
+ */
+unsigned long ADS129X_DutyCycle::getFrameCount() {
+    return frames;
+}
+
+/**
+ * Frames read per second since begin, as of the last poll().
+ * @return rate in Hz, 0 before the first poll()
+ */
+float ADS129X_DutyCycle::getAchievedRate() {
+    if (elapsed == 0) {
+        return 0;
+    }
+    return frames * 1e6f / (float) elapsed;
+}
+
+/**
+ * Fraction of the time since begin the device was awake, from WAKEUP to
+ * STANDBY, as of the last poll(). Its supply current is about the
+ * continuous one times this plus the standby current.
+ * @return duty cycle between 0 and 1
+ */
+float ADS129X_DutyCycle::getDutyCycle() {
+    if (elapsed == 0) {
+        return 0;
+    }
+    uint64_t active = awake;
+    if (state == ADS129X_DUTY_CONVERTING) {
+        active += lastUpdate - wakeTime;
+    }
+    return (float) active / (float) elapsed;
+}
+
+/**
+ * Wake-ups that could not be kept on schedule, because the requested rate
+ * is above getMaxRate() or poll() was called too rarely.
+ */
+unsigned long ADS129X_DutyCycle::getLate() {
+    return late;
+}
+
+/**
+ * Wake-ups given up because DRDY did not go low in time.
+ */
+unsigned long ADS129X_DutyCycle::getTimeouts() {
+    return timeouts;
+}
+
+/**
+ * Frames overwritten by the next one of a burst before getData.
+ */
+unsigned long ADS129X_DutyCycle::getOverruns() {
+    return overruns;
+}
+
+/**
+ * Conversions of a burst that were not read before the next one, as seen
+ * from the time between readbacks. A burst needs poll() and the RDATA
+ * readback to keep up with the data rate.
+ */
+unsigned long ADS129X_DutyCycle::getMissed() {
+    return missed;
+}
@@ -0,0 +1,82 @@
+/**
+ * ADS129X_DutyCycle.h
+ *
+ * Low-rate acquisition for battery-powered boards. Instead of converting
+ * continuously, the device is woken at the requested rate, takes one
+ * single-shot conversion (or a short burst of conversions), the data is
+ * read with RDATA and the device goes back to standby until the next
+ * wake-up. Driven by poll() from the loop:
+ *
+ *     ADS.setRegister(...);              // data rate, channels, ...
+ *     ADS.commit();
+ *     duty.setRate(10);                  // 10 SPS effective
+ *     duty.begin();
+ *     ...
+ *     void loop() {
+ *         if (duty.poll()) {
+ *             duty.getData(buffer);
+ *             ...
+ *         }
+ *     }
+ *
+ * Each wake-up costs the settling time of the data rate in CONFIG1
+ * (getSettlingTime), so the fastest data rate gives the lowest duty cycle.
+ * The achieved rate and the fraction of time the device was awake are
+ * reported, to trade sample rate against battery life.
+ */
+
+#ifndef ____ADS129X_DUTY_CYCLE__
+#define ____ADS129X_DUTY_CYCLE__
+
+#include "ADS129X.h"
+
+// Time in us a wake-up waits for DRDY beyond the expected settling time
+// before it is given up
+#ifndef ADS129X_DUTY_TIMEOUT
+#define ADS129X_DUTY_TIMEOUT 1000UL
+#endif
+
+// Duty cycle states
+#define ADS129X_DUTY_IDLE       0
+#define ADS129X_DUTY_STANDBY    1 // waiting for the next wake-up
+#define ADS129X_DUTY_CONVERTING 2 // awake, waiting for DRDY
+
+class ADS129X_DutyCycle {
+    public:
+        ADS129X_DutyCycle(ADS129X *_ads, int _START = -1);
+
+        void setRate(float _rate, byte _burst = 1);
+        float getMaxRate();
+        void begin();
+        void end();
+        boolean poll();
+        boolean getData(long *_buffer, unsigned long *_sequence = NULL, uint32_t *_timestamp = NULL);
+        byte getState();
+
+        unsigned long getFrameCount();
+        float getAchievedRate();
+        float getDutyCycle();
+        unsigned long getLate();
+        unsigned long getTimeouts();
+        unsigned long getOverruns();
+        unsigned long getMissed();
+
+    private:
+        ADS129X *ads;
+        int START; // -1 if not connected
+        byte state, burst, remaining, config4;
+        boolean ready;
+        unsigned long interval;   // us between wake-ups
+        unsigned long nextWake, wakeTime, deadline, lastUpdate;
+        uint64_t elapsed, awake;  // us since begin, and of it outside standby
+        long frame[ADS129X_FRAME_WORDS];
+        unsigned long sequence;
+        uint32_t timestamp;
+        uint32_t period;          // conversion period in ticks, for bursts
+        unsigned long frames, late, timeouts, overruns, missed;
+
+        void wake(unsigned long _now);
+        void sleep(unsigned long _now);
+};
+
+#endif
@@ -0,0 +1,425 @@
+/**
+ * ADS129X_Features.cpp
+ *
+ * Sliding-window feature extraction for ADS129X frames.
+ */
+
+#include <math.h>
+#include "ADS129X_Features.h"
+
+#define ADS129X_EVENT_ZC  0x01
+#define ADS129X_EVENT_SSC 0x02
+
+/**
+ * Creates a feature engine with a window of 128 frames (or
+ * ADS129X_FEATURES_WINDOW, if smaller), a hop of half the window, no
+ * threshold and no spectrum stage.
+ * @param _channels number of channels per frame (1-ADS129X_FEATURES_CHANNELS)
+ */
+ADS129X_Features::ADS129X_Features(byte _channels) {
+    channels = (_channels > ADS129X_FEATURES_CHANNELS) ? ADS129X_FEATURES_CHANNELS : _channels;
+    threshold = 0;
+#if ADS129X_FEATURES_FFT > 0
+    spectrum = false;
+    numBands = 0;
+#endif
+    unsigned int length = (ADS129X_FEATURES_WINDOW < 128) ? ADS129X_FEATURES_WINDOW : 128;
+    setWindow(length, length / 2);
+}
+
+/**
+ * Sets the window and how often features are computed. Clears the window.
+ * @param _window frames per window (3-ADS129X_FEATURES_WINDOW)
+ * @param _hop    frames between feature vectors (1-_window)
+ * @return        false if out of range, or if the window no longer suits
+ *                the spectrum stage, which is then turned off
+ */
+boolean ADS129X_Features::setWindow(unsigned int _window, unsigned int _hop) {
+    if (_window < 3 || _window > ADS129X_FEATURES_WINDOW || _hop < 1 || _hop > _window) {
+        return false;
+    }
+#if ADS129X_FEATURES_FFT > 0
+    float fs = spectrum ? binWidth * window : 0;
+#endif
+    window = _window;
+    hop = _hop;
+    reset();
+#if ADS129X_FEATURES_FFT > 0
+    if (fs > 0 && !setSpectrum(fs, numBands, edges)) {
+        return false;
+    }
+#endif
+    return true;
+}
+
+/**
+ * Sets the smallest step between neighbouring samples that counts for zero
+ * crossings and slope sign changes, to keep noise from being counted.
+ * @param _threshold step in LSB
+ */
+void ADS129X_Features::setThreshold(long _threshold) {
+    threshold = _threshold < 0 ? -_threshold : _threshold;
+}
+
+/**
+ * Turns on the spectrum stage: mean and median frequency and the power in
+ * up to ADS129X_FEATURES_BANDS bands. The window has to be a power of two
+ * of at most ADS129X_FEATURES_FFT frames; its length sets the frequency
+ * resolution, _fs / window.
+ * @param _fs       sample rate of the frames in Hz, 0 to turn the stage off
+ * @param _numBands number of bands
+ * @param _edges    _numBands + 1 ascending band edges in Hz; band n covers
+ *                  _edges[n] up to, not including, _edges[n + 1]
+ * @return          false if the stage is left out or the window does not suit it
+ */
+boolean ADS129X_Features::setSpectrum(float _fs, byte _numBands, const float *_edges) {
+#if ADS129X_FEATURES_FFT > 0
+    spectrum = false;
+    if (_fs <= 0) {
+        return true;
+    }
+    if (window > ADS129X_FEATURES_FFT || (window & (window - 1)) || _numBands > ADS129X_FEATURES_BANDS ||
+        (_numBands > 0 && _edges == NULL)) {
+        return false;
+    }
+    numBands = _numBands;
+    for (byte b = 0; b < numBands + 1 && numBands > 0; b++) {
+        edges[b] = _edges[b];
+    }
+    binWidth = _fs / window;
+    float power = 0;
+    for (unsigned int i = 0; i < window; i++) {
+        // periodic Hann window
+        hann[i] = 0.5f - 0.5f * cosf(2 * M_PI * i / window);
+        power += hann[i] * hann[i];
+    }
+    for (unsigned int i = 0; i < window / 2; i++) {
+        cosines[i] = cosf(2 * M_PI * i / window);
+        sines[i] = -sinf(2 * M_PI * i / window);
+    }
+    // one-sided power spectrum that adds up to the mean square
+    scale = 2.0f / (window * power);
+    for (byte c = 0; c < channels; c++) {
+        mnf[c] = 0;
+        mdf[c] = 0;
+        for (byte b = 0; b < ADS129X_FEATURES_BANDS; b++) {
+            bands[b][c] = 0;
+        }
+    }
+    spectrum = true;
+    return true;
+#else
+    (void) _fs;
+    (void) _numBands;
+    (void) _edges;
+    return false;
+#endif
+}
+
+/**
+ * Clears the window; settings are kept. The next feature vector is ready
+ * once the window has filled again.
+ */
+void ADS129X_Features::reset() {
+    memset(samples, 0, sizeof(samples));
+    memset(events, 0, sizeof(events));
+    position = 0;
+    count = 0;
+    sinceHop = hop - 1;
+    for (byte c = 0; c < channels; c++) {
+        squares[c] = 0;
+        crossings[c] = 0;
+        slopeChanges[c] = 0;
+        previous[c] = 0;
+        beforePrevious[c] = 0;
+        rms[c] = 0;
+        zc[c] = 0;
+        ssc[c] = 0;
+    }
+}
+
+/**
+ * Adds a frame to the window.
+ * @param _frame frame in the getData layout; word 0 is the status word
+ * @return       true if a new feature vector is ready, every hop frames
+ *               once the window is full
+ */
+boolean ADS129X_Features::process(const long *_frame) {
+    const long *in = _frame + 1;
+    int32_t *slot = samples[position];
+    byte *event = events[position];
+    // events need one or two samples before; the slots of a window that is
+    // not full yet are cleared, so nothing leaves it
+    byte valid = (count >= 2) ? ADS129X_EVENT_ZC | ADS129X_EVENT_SSC : (count ? ADS129X_EVENT_ZC : 0);
+    for (byte c = 0; c < channels; c++) {
+        int32_t x = in[c];
+        int32_t x1 = previous[c];
+        int32_t rise = x1 - beforePrevious[c];
+        int32_t fall = x1 - x;
+        int32_t step = (fall < 0) ? -fall : fall;
+        // sign change of the sample, or x1 is a peak or a trough
+        byte e = ((x ^ x1) < 0 && step >= threshold) ? ADS129X_EVENT_ZC : 0;
+        if ((rise ^ fall) >= 0 && rise != 0 && fall != 0 &&
+            (step >= threshold || rise >= threshold || -rise >= threshold)) {
+            e |= ADS129X_EVENT_SSC;
+        }
+        e &= valid;
+        int32_t old = slot[c];
+        byte gone = event[c];
+        squares[c] += (int64_t) x * x - (int64_t) old * old;
+        crossings[c] += (e & ADS129X_EVENT_ZC) - (gone & ADS129X_EVENT_ZC);
+        slopeChanges[c] += (e >> 1) - (gone >> 1);
+        slot[c] = x;
+        event[c] = e;
+        beforePrevious[c] = x1;
+        previous[c] = x;
+    }
+    if (++position >= window) {
+        position = 0;
+    }
+    if (count < window) {
+        count++;
+        if (count < window) {
+            return false;
+        }
+    }
+    if (++sinceHop < hop) {
+        return false;
+    }
+    sinceHop = 0;
+    for (byte c = 0; c < channels; c++) {
+        rms[c] = sqrtf((float) squares[c] / window);
+        zc[c] = crossings[c];
+        ssc[c] = slopeChanges[c];
+    }
+#if ADS129X_FEATURES_FFT > 0
+    if (spectrum) {
+        updateSpectrum();
+    }
+#endif
+    return true;
+}
+
+#if ADS129X_FEATURES_FFT > 0
+/**
+ * In-place radix-2 FFT of re/im over the window.
+ */
+void ADS129X_Features::fft() {
+    unsigned int n = window;
+    // bit-reversed order
+    for (unsigned int i = 1, j = 0; i < n; i++) {
+        unsigned int bit = n >> 1;
+        for (; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j ^= bit;
+        if (i < j) {
+            float t = re[i]; re[i] = re[j]; re[j] = t;
+            t = im[i]; im[i] = im[j]; im[j] = t;
+        }
+    }
+    for (unsigned int length = 2; length <= n; length <<= 1) {
+        unsigned int half = length >> 1;
+        unsigned int step = n / length;
+        for (unsigned int start = 0; start < n; start += length) {
+            for (unsigned int k = 0; k < half; k++) {
+                float wr = cosines[k * step];
+                float wi = sines[k * step];
+                unsigned int a = start + k;
+                unsigned int b = a + half;
+                float tr = re[b] * wr - im[b] * wi;
+                float ti = re[b] * wi + im[b] * wr;
+                re[b] = re[a] - tr;
+                im[b] = im[a] - ti;
+                re[a] += tr;
+                im[a] += ti;
+            }
+        }
+    }
+}
+
+/**
+ * Mean and median frequency and band powers of one channel.
+ * @param _channel channel index, 0-based
+ * @param _power   one-sided power spectrum, bins 1 to window/2
+ */
+void ADS129X_Features::analyze(byte _channel, const float *_power) {
+    unsigned int bins = window / 2;
+    float total = 0, moment = 0;
+    for (unsigned int k = 1; k <= bins; k++) {
+        total += _power[k];
+        moment += _power[k] * k;
+    }
+    for (byte b = 0; b < numBands; b++) {
+        bands[b][_channel] = 0;
+    }
+    // a silent channel only picks up rounding from the one it is paired with
+    if (total <= 0 || squares[_channel] == 0) {
+        mnf[_channel] = 0;
+        mdf[_channel] = 0;
+        return;
+    }
+    mnf[_channel] = moment / total * binWidth;
+    // bin k covers k - 0.5 to k + 0.5, the median is interpolated in it
+    float half = total / 2, below = 0;
+    for (unsigned int k = 1; k <= bins; k++) {
+        if (below + _power[k] >= half) {
+            mdf[_channel] = (k - 0.5f + (half - below) / _power[k]) * binWidth;
+            break;
+        }
+        below += _power[k];
+    }
+    for (unsigned int k = 1; k <= bins; k++) {
+        float f = k * binWidth;
+        for (byte b = 0; b < numBands; b++) {
+            if (f >= edges[b] && f < edges[b + 1]) {
+                bands[b][_channel] += _power[k];
+            }
+        }
+    }
+}
+
+/**
+ * Transforms two channels at a time, one as the real and one as the
+ * imaginary part, and separates their spectra by symmetry.
+ */
+void ADS129X_Features::updateSpectrum() {
+    unsigned int n = window;
+    for (byte c = 0; c < channels; c += 2) {
+        boolean pair = c + 1 < channels;
+        // oldest sample first
+        unsigned int i = position;
+        for (unsigned int t = 0; t < n; t++) {
+            re[t] = samples[i][c] * hann[t];
+            im[t] = pair ? samples[i][c + 1] * hann[t] : 0;
+            if (++i >= n) {
+                i = 0;
+            }
+        }
+        fft();
+        // X[k] = (Z[k] + conj Z[n-k]) / 2, Y[k] = (Z[k] - conj Z[n-k]) / 2j;
+        // bin k is only overwritten after its last use
+        for (unsigned int k = 1; k <= n / 2; k++) {
+            float zr = re[k], zi = im[k];
+            float mr = re[n - k], mi = im[n - k];
+            float xr = zr + mr, xi = zi - mi;
+            float yr = zi + mi, yi = mr - zr;
+            float weight = (k == n / 2) ? scale / 8 : scale / 4;
+            re[k] = (xr * xr + xi * xi) * weight;
+            im[k] = (yr * yr + yi * yi) * weight;
+        }
+        analyze(c, re);
+        if (pair) {
+            analyze(c + 1, im);
+        }
+    }
+}
+#endif
+
+/**
+ * RMS of a channel over the window.
+ * @param _channel 1-n
+ * @return         RMS in LSB
+ */
+float ADS129X_Features::getRms(byte _channel) {
+    return (_channel >= 1 && _channel <= channels) ? rms[_channel - 1] : 0;
+}
+
+/**
+ * Zero crossings of a channel in the window.
+ * @param _channel 1-n
+ */
+unsigned int ADS129X_Features::getZeroCrossings(byte _channel) {
+    return (_channel >= 1 && _channel <= channels) ? zc[_channel - 1] : 0;
+}
+
+/**
+ * Slope sign changes of a channel in the window.
+ * @param _channel 1-n
+ */
+unsigned int ADS129X_Features::getSlopeSignChanges(byte _channel) {
+    return (_channel >= 1 && _channel <= channels) ? ssc[_channel - 1] : 0;
+}
+
+/**
+ * Mean frequency of the power spectrum of a channel.
+ * @param _channel 1-n
+ * @return         frequency in Hz, 0 without the spectrum stage
+ */
+float ADS129X_Features::getMeanFrequency(byte _channel) {
+#if ADS129X_FEATURES_FFT > 0
+    if (spectrum && _channel >= 1 && _channel <= channels) {
+        return mnf[_channel - 1];
+    }
+#endif
+    return 0;
+}
+
+/**
+ * Median frequency of the power spectrum of a channel, which splits it
+ * into halves of equal power.
+ * @param _channel 1-n
+ * @return         frequency in Hz, 0 without the spectrum stage
+ */
+float ADS129X_Features::getMedianFrequency(byte _channel) {
+#if ADS129X_FEATURES_FFT > 0
+    if (spectrum && _channel >= 1 && _channel <= channels) {
+        return mdf[_channel - 1];
+    }
+#endif
+    return 0;
+}
+
+/**
+ * Power of a channel in a band, as the mean square of the signal components
+ * in it.
+ * @param _channel 1-n
+ * @param _band    0 to the number of bands - 1
+ * @return         power in LSB^2, 0 without the spectrum stage
+ */
+float ADS129X_Features::getBandPower(byte _channel, byte _band) {
+#if ADS129X_FEATURES_FFT > 0
+    if (spectrum && _channel >= 1 && _channel <= channels && _band < numBands) {
+        return bands[_band][_channel - 1];
+    }
+#endif
+    return 0;
+}
+
+/**
+ * Number of features per channel: RMS, ZC and SSC, and with the spectrum
+ * stage MNF, MDF and the band powers (see ADS129X_FEATURE_*).
+ */
+byte ADS129X_Features::getFeatureCount() {
+#if ADS129X_FEATURES_FFT > 0
+    if (spectrum) {
+        return ADS129X_FEATURE_BAND + numBands;
+    }
+#endif
+    return ADS129X_FEATURE_MNF;
+}
+
+/**
+ * Copies the features of the last hop, channel after channel.
+ * @param _out buffer for channels * getFeatureCount() values
+ * @return     number of values written
+ */
+unsigned int ADS129X_Features::getVector(float *_out) {
+    byte features = getFeatureCount();
+    for (byte c = 0; c < channels; c++) {
+        float *out = _out + c * features;
+        out[ADS129X_FEATURE_RMS] = rms[c];
+        out[ADS129X_FEATURE_ZC] = zc[c];
+        out[ADS129X_FEATURE_SSC] = ssc[c];
+#if ADS129X_FEATURES_FFT > 0
+        if (spectrum) {
+            out[ADS129X_FEATURE_MNF] = mnf[c];
+            out[ADS129X_FEATURE_MDF] = mdf[c];
+            for (byte b = 0; b < numBands; b++) {
+                out[ADS129X_FEATURE_BAND + b] = bands[b][c];
+            }
+        }
+#endif
+    }
+    return (unsigned int) channels * features;
+}
@@ -0,0 +1,123 @@
+/**
+ * ADS129X_Features.h
+ *
+ * Per-channel EMG features over a sliding window, fed frame by frame with
+ * the frames returned by getData (or by ADS129X_Filter). Every hop frames
+ * a feature vector is ready:
+ *
+ *     RMS     root mean square, the amplitude envelope
+ *     ZC      zero crossings with an amplitude step of at least the threshold
+ *     SSC     slope sign changes with a step of at least the threshold
+ *     MNF     mean frequency of the power spectrum     (spectrum stage)
+ *     MDF     median frequency of the power spectrum   (spectrum stage)
+ *     band    mean square in each frequency band        (spectrum stage)
+ *
+ * RMS, ZC and SSC are kept in running sums that are updated with the
+ * sample entering and the one leaving the window, so each frame costs the
+ * same few operations per channel whatever the window length. The optional
+ * spectrum stage runs a Hann-windowed FFT over the window once per hop,
+ * two channels per complex transform.
+ *
+ * The signal should have no DC offset, e.g. after a high-pass in
+ * ADS129X_Filter. State is stored per sample across channels, like in
+ * ADS129X_Filter, so the loops run over channels. Nothing depends on the
+ * device, so the same code extracts features from recordings on the host.
+ */
+
+#ifndef ____ADS129X_FEATURES__
+#define ____ADS129X_FEATURES__
+
+#include "ADS129X_HAL.h"
+
+// Maximum number of channels per frame
+#ifndef ADS129X_FEATURES_CHANNELS
+#define ADS129X_FEATURES_CHANNELS 8
+#endif
+
+// Longest window in frames; every frame of it is kept per channel
+#ifndef ADS129X_FEATURES_WINDOW
+#define ADS129X_FEATURES_WINDOW 128
+#endif
+
+// Largest FFT of the spectrum stage, a power of two; 0 leaves the stage out
+#ifndef ADS129X_FEATURES_FFT
+#define ADS129X_FEATURES_FFT 128
+#endif
+
+// Maximum number of frequency bands
+#ifndef ADS129X_FEATURES_BANDS
+#define ADS129X_FEATURES_BANDS 4
+#endif
+
+// Position of each feature in a channel's part of the feature vector; the
+// spectral ones are only there with the spectrum stage
+#define ADS129X_FEATURE_RMS  0
+#define ADS129X_FEATURE_ZC   1
+#define ADS129X_FEATURE_SSC  2
+#define ADS129X_FEATURE_MNF  3
+#define ADS129X_FEATURE_MDF  4
+#define ADS129X_FEATURE_BAND 5
+
+class ADS129X_Features {
+    public:
+        ADS129X_Features(byte _channels = 8);
+
+        boolean setWindow(unsigned int _window, unsigned int _hop);
+        void setThreshold(long _threshold);
+        boolean setSpectrum(float _fs, byte _numBands = 0, const float *_edges = NULL);
+        void reset();
+
+        boolean process(const long *_frame);
+
+        // features of the last hop; _channel 1-n
+        float getRms(byte _channel);
+        unsigned int getZeroCrossings(byte _channel);
+        unsigned int getSlopeSignChanges(byte _channel);
+        float getMeanFrequency(byte _channel);
+        float getMedianFrequency(byte _channel);
+        float getBandPower(byte _channel, byte _band);
+
+        byte getFeatureCount();
+        unsigned int getVector(float *_out);
+
+    private:
+        byte channels;
+        unsigned int window, hop, position, count, sinceHop;
+        int32_t threshold;
+
+        // the window, and for each sample whether it completed a zero
+        // crossing (bit 0) or a slope sign change (bit 1)
+        int32_t samples[ADS129X_FEATURES_WINDOW][ADS129X_FEATURES_CHANNELS];
+        byte events[ADS129X_FEATURES_WINDOW][ADS129X_FEATURES_CHANNELS];
+        int64_t squares[ADS129X_FEATURES_CHANNELS];
+        unsigned int crossings[ADS129X_FEATURES_CHANNELS];
+        unsigned int slopeChanges[ADS129X_FEATURES_CHANNELS];
+        int32_t previous[ADS129X_FEATURES_CHANNELS];
+        int32_t beforePrevious[ADS129X_FEATURES_CHANNELS];
+
+        // results of the last hop
+        float rms[ADS129X_FEATURES_CHANNELS];
+        unsigned int zc[ADS129X_FEATURES_CHANNELS];
+        unsigned int ssc[ADS129X_FEATURES_CHANNELS];
+
+#if ADS129X_FEATURES_FFT > 0
+        boolean spectrum;
+        float binWidth, scale;
+        byte numBands;
+        float edges[ADS129X_FEATURES_BANDS + 1];
+        float hann[ADS129X_FEATURES_FFT];
+        float cosines[ADS129X_FEATURES_FFT / 2];
+        float sines[ADS129X_FEATURES_FFT / 2];
+        float re[ADS129X_FEATURES_FFT];
+        float im[ADS129X_FEATURES_FFT];
+        float mnf[ADS129X_FEATURES_CHANNELS];
+        float mdf[ADS129X_FEATURES_CHANNELS];
+        float bands[ADS129X_FEATURES_BANDS][ADS129X_FEATURES_CHANNELS];
+
+        void fft();
+        void analyze(byte _channel, const float *_power);
+        void updateSpectrum();
+#endif
+};
+
+#endif
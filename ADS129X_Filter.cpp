@@ -0,0 +1,286 @@
+/**
+ * ADS129X_Filter.cpp
+ *
+ * Fixed-point filter stage for ADS129X frames.
+ */
+
+#include <math.h>
+#include "ADS129X_Filter.h"
+
+#define ADS129X_Q30 1073741824.0f
+#define ADS129X_Q31 2147483648.0f
+
+/**
+ * Creates a filter stage that passes all channels through unchanged.
+ * @param _channels number of channels per frame (1-ADS129X_FILTER_CHANNELS)
+ */
+ADS129X_Filter::ADS129X_Filter(byte _channels) {
+    channels = (_channels > ADS129X_FILTER_CHANNELS) ? ADS129X_FILTER_CHANNELS : _channels;
+    activeSections = 0;
+    for (byte s = 0; s < ADS129X_FILTER_SECTIONS; s++) {
+        setBypass(s, 0);
+    }
+    setDecimation(1, 0, NULL);
+}
+
+/**
+ * Clears all filter state; coefficients are kept.
+ */
+void ADS129X_Filter::reset() {
+    memset(x1, 0, sizeof(x1));
+    memset(x2, 0, sizeof(x2));
+    memset(y1, 0, sizeof(y1));
+    memset(y2, 0, sizeof(y2));
+    memset(err1, 0, sizeof(err1));
+    memset(err2, 0, sizeof(err2));
+    memset(sums, 0, sizeof(sums));
+    phase = 0;
+    headSlot = 0;
+}
+
+void ADS129X_Filter::setSection(byte _section, byte _channel, int32_t _b0, int32_t _b1, int32_t _b2, int32_t _a1, int32_t _a2) {
+    if (_section >= ADS129X_FILTER_SECTIONS || _channel > channels) {
+        return;
+    }
+    byte first = _channel ? _channel - 1 : 0;
+    byte last = _channel ? _channel : channels;
+    for (byte c = first; c < last; c++) {
+        b0[_section][c] = _b0;
+        b1[_section][c] = _b1;
+        b2[_section][c] = _b2;
+        a1[_section][c] = _a1;
+        a2[_section][c] = _a2;
+        x1[_section][c] = x2[_section][c] = 0;
+        y1[_section][c] = y2[_section][c] = 0;
+        err1[_section][c] = err2[_section][c] = 0;
+    }
+    // a section only costs time if one of the channels uses it
+    activeSections &= ~(1 << _section);
+    for (byte c = 0; c < channels; c++) {
+        if (b0[_section][c] != (1L << 30) || b1[_section][c] || b2[_section][c] ||
+            a1[_section][c] || a2[_section][c]) {
+            activeSections |= 1 << _section;
+        }
+    }
+}
+
+/**
+ * Set biquad coefficients, normalized to a0 = 1:
+ * y[n] = b0 x[n] + b1 x[n-1] + b2 x[n-2] - a1 y[n-1] - a2 y[n-2].
+ * Coefficients have to be within [-2, 2).
+ * @param _section biquad section (0-ADS129X_FILTER_SECTIONS-1)
+ * @param _channel channel (1-n), 0 for all channels
+ */
+void ADS129X_Filter::setBiquad(byte _section, byte _channel, float _b0, float _b1, float _b2, float _a1, float _a2) {
+    setSection(_section, _channel,
+               lroundf(_b0 * ADS129X_Q30), lroundf(_b1 * ADS129X_Q30), lroundf(_b2 * ADS129X_Q30),
+               lroundf(_a1 * ADS129X_Q30), lroundf(_a2 * ADS129X_Q30));
+}
+
+/**
+ * Set biquad coefficients designed in double precision. Single precision
+ * has fewer bits than Q2.30, which shifts poles close to z = 1 (low
+ * cut-off frequencies) and limits the depth of notches.
+ */
+void ADS129X_Filter::setDesign(byte _section, byte _channel, double _b0, double _b1, double _b2, double _a1, double _a2) {
+    setSection(_section, _channel,
+               (int32_t) floor(_b0 * ADS129X_Q30 + 0.5), (int32_t) floor(_b1 * ADS129X_Q30 + 0.5),
+               (int32_t) floor(_b2 * ADS129X_Q30 + 0.5), (int32_t) floor(_a1 * ADS129X_Q30 + 0.5),
+               (int32_t) floor(_a2 * ADS129X_Q30 + 0.5));
+}
+
+/**
+ * Notch filter, e.g. for 50/60 Hz mains (RBJ audio EQ cookbook).
+ * @param _section biquad section
+ * @param _channel channel (1-n), 0 for all channels
+ * @param _f0      notch frequency in Hz
+ * @param _fs      sample rate in Hz
+ * @param _q       quality factor (f0 / bandwidth)
+ */
+void ADS129X_Filter::setNotch(byte _section, byte _channel, float _f0, float _fs, float _q) {
+    double w0 = 2 * M_PI * _f0 / _fs;
+    double alpha = sin(w0) / (2 * _q);
+    double a0 = 1 + alpha;
+    setDesign(_section, _channel, 1 / a0, -2 * cos(w0) / a0, 1 / a0, -2 * cos(w0) / a0, (1 - alpha) / a0);
+}
+
+/**
+ * Second-order high-pass filter (RBJ audio EQ cookbook).
+ * @param _section biquad section
+ * @param _channel channel (1-n), 0 for all channels
+ * @param _fc      cut-off frequency in Hz
+ * @param _fs      sample rate in Hz
+ * @param _q       quality factor, 0.7071 for Butterworth
+ */
+void ADS129X_Filter::setHighPass(byte _section, byte _channel, float _fc, float _fs, float _q) {
+    double w0 = 2 * M_PI * _fc / _fs;
+    double alpha = sin(w0) / (2 * _q);
+    double c = cos(w0);
+    double a0 = 1 + alpha;
+    // b1 = -2 b0 after rounding keeps both zeros at DC; otherwise the
+    // rounding error leaks through at low cut-off frequencies
+    double b0 = floor((1 + c) / 2 / a0 * ADS129X_Q30 + 0.5) / ADS129X_Q30;
+    setDesign(_section, _channel, b0, -2 * b0, b0, -2 * c / a0, (1 - alpha) / a0);
+}
+
+/**
+ * Second-order low-pass filter (RBJ audio EQ cookbook).
+ * @param _section biquad section
+ * @param _channel channel (1-n), 0 for all channels
+ * @param _fc      cut-off frequency in Hz
+ * @param _fs      sample rate in Hz
+ * @param _q       quality factor, 0.7071 for Butterworth
+ */
+void ADS129X_Filter::setLowPass(byte _section, byte _channel, float _fc, float _fs, float _q) {
+    double w0 = 2 * M_PI * _fc / _fs;
+    double alpha = sin(w0) / (2 * _q);
+    double c = cos(w0);
+    double a0 = 1 + alpha;
+    setDesign(_section, _channel, (1 - c) / 2 / a0, (1 - c) / a0, (1 - c) / 2 / a0, -2 * c / a0, (1 - alpha) / a0);
+}
+
+/**
+ * Pass data through section _section unchanged.
+ * @param _section biquad section
+ * @param _channel channel (1-n), 0 for all channels
+ */
+void ADS129X_Filter::setBypass(byte _section, byte _channel) {
+    setSection(_section, _channel, 1L << 30, 0, 0, 0, 0);
+}
+
+/**
+ * Set up the FIR decimator. Output is produced for every _factor-th input
+ * frame. A factor of 1 with no taps disables the decimator.
+ * @param _factor  decimation factor
+ * @param _numTaps number of taps (at most ADS129X_FILTER_TAPS)
+ * @param _taps    Q1.31 coefficients
+ * @return false if the configuration does not fit
+ */
+boolean ADS129X_Filter::setDecimation(byte _factor, byte _numTaps, const long *_taps) {
+    if (_factor < 1 || _numTaps > ADS129X_FILTER_TAPS || _factor > ADS129X_FILTER_TAPS ||
+        (_numTaps + _factor - 1) / _factor > ADS129X_FILTER_SLOTS) {
+        return false;
+    }
+    factor = _factor;
+    numTaps = _numTaps;
+    numSlots = (_numTaps + _factor - 1) / _factor;
+    if (numSlots == 0) numSlots = 1;
+
+    // Tap k of input phase r contributes to the output (k+r)/factor frames
+    // ahead. Outputs are emitted at phase 0, after which the next output
+    // is already one frame closer.
+    byte n = 0;
+    for (byte r = 0; r < factor; r++) {
+        phaseStart[r] = n;
+        for (byte k = 0; k < numTaps; k++) {
+            if ((k + r) % factor == 0) {
+                taps[n] = _taps[k];
+                tapSlot[n] = (k + r) / factor - (r ? 1 : 0);
+                n++;
+            }
+        }
+    }
+    phaseStart[factor] = n;
+    reset();
+    return true;
+}
+
+/**
+ * Set up the FIR decimator with a Hamming-windowed sinc low-pass at
+ * 0.8 times the output Nyquist frequency.
+ * @param _factor  decimation factor
+ * @param _numTaps number of taps
+ * @return false if the configuration does not fit
+ */
+boolean ADS129X_Filter::setDecimation(byte _factor, byte _numTaps) {
+    long design[ADS129X_FILTER_TAPS];
+    if (_numTaps > ADS129X_FILTER_TAPS || _factor < 1) {
+        return false;
+    }
+    float fc = 0.8f * 0.5f / _factor;
+    float sum = 0;
+    float h[ADS129X_FILTER_TAPS];
+    for (byte k = 0; k < _numTaps; k++) {
+        float m = k - (_numTaps - 1) / 2.0f;
+        float sinc = (m == 0) ? 2 * fc : sinf(2 * M_PI * fc * m) / (M_PI * m);
+        float window = (_numTaps > 1) ? 0.54f - 0.46f * cosf(2 * M_PI * k / (_numTaps - 1)) : 1;
+        h[k] = sinc * window;
+        sum += h[k];
+    }
+    for (byte k = 0; k < _numTaps; k++) {
+        // unity DC gain, kept just below 1.0 to fit Q1.31
+        design[k] = lroundf(h[k] / sum * (ADS129X_Q31 - 128));
+    }
+    return setDecimation(_factor, _numTaps, design);
+}
+
+/**
+ * Decimation factor.
+ * @return number of input frames per output frame
+ */
+byte ADS129X_Filter::getDecimation() {
+    return factor;
+}
+
+/**
+ * Filter one frame.
+ * @param _in  frame as returned by getData
+ * @param _out filtered frame; only valid when true is returned
+ * @return true when an output frame is ready
+ */
+boolean ADS129X_Filter::process(const long *_in, long *_out) {
+    int32_t x[ADS129X_FILTER_CHANNELS];
+    for (byte c = 0; c < channels; c++) {
+        x[c] = _in[c + 1];
+    }
+
+    for (byte s = 0; s < ADS129X_FILTER_SECTIONS; s++) {
+        if (!(activeSections & (1 << s))) {
+            continue;
+        }
+        for (byte c = 0; c < channels; c++) {
+            int64_t acc = (int64_t) b0[s][c] * x[c] + (int64_t) b1[s][c] * x1[s][c] + (int64_t) b2[s][c] * x2[s][c]
+                        - (int64_t) a1[s][c] * y1[s][c] - (int64_t) a2[s][c] * y2[s][c]
+                        + 2 * (int64_t) err1[s][c] - err2[s][c];
+            int32_t y = (int32_t) (acc >> 30);
+            err2[s][c] = err1[s][c];
+            err1[s][c] = (int32_t) (acc - ((int64_t) y << 30));
+            x2[s][c] = x1[s][c];
+            x1[s][c] = x[c];
+            y2[s][c] = y1[s][c];
+            y1[s][c] = y;
+            x[c] = y;
+        }
+    }
+
+    if (numTaps == 0) {
+        _out[0] = _in[0];
+        for (byte c = 0; c < channels; c++) {
+            _out[c + 1] = x[c];
+        }
+        return true;
+    }
+
+    for (byte t = phaseStart[phase]; t < phaseStart[phase + 1]; t++) {
+        byte slot = headSlot + tapSlot[t];
+        if (slot >= numSlots) slot -= numSlots;
+        int32_t tap = taps[t];
+        int64_t *sum = sums[slot];
+        for (byte c = 0; c < channels; c++) {
+            sum[c] += (int64_t) tap * x[c];
+        }
+    }
+
+    boolean ready = (phase == 0);
+    if (ready) {
+        int64_t *sum = sums[headSlot];
+        _out[0] = _in[0];
+        for (byte c = 0; c < channels; c++) {
+            _out[c + 1] = (long) ((sum[c] + (1LL << 30)) >> 31);
+            sum[c] = 0;
+        }
+        if (++headSlot >= numSlots) headSlot = 0;
+    }
+    if (++phase >= factor) phase = 0;
+    return ready;
+}
@@ -0,0 +1,94 @@
+/**
+ * ADS129X_Filter.h
+ *
+ * Optional fixed-point filter stage for frames returned by getData:
+ * per-channel biquad IIR sections (notch, high-pass, low-pass) followed by
+ * a polyphase FIR decimator.
+ *
+ * Biquad coefficients are Q2.30, FIR coefficients Q1.31, both multiplied
+ * into 64-bit accumulators (SMLAL on Cortex-M). Filter state is stored
+ * structure-of-arrays, one array per coefficient/state variable indexed by
+ * channel, so the inner loops run over channels and vectorize.
+ * The polyphase decimator spreads the FIR work over all input frames, so
+ * every frame costs at most SECTIONS*channels biquads plus
+ * ceil(taps/factor)*channels multiply-accumulates.
+ *
+ * Frame layout is the one used by getData: word 0 is the status word, which
+ * is passed through, words 1..channels are channel data.
+ */
+
+#ifndef ____ADS129X_FILTER__
+#define ____ADS129X_FILTER__
+
+#include "ADS129X_HAL.h"
+
+// Maximum number of channels per frame
+#ifndef ADS129X_FILTER_CHANNELS
+#define ADS129X_FILTER_CHANNELS 8
+#endif
+
+// Biquad sections per channel
+#ifndef ADS129X_FILTER_SECTIONS
+#define ADS129X_FILTER_SECTIONS 2
+#endif
+
+// Maximum number of FIR decimator taps
+#ifndef ADS129X_FILTER_TAPS
+#define ADS129X_FILTER_TAPS 32
+#endif
+
+// Partial output sums kept by the decimator; limits taps/factor
+#define ADS129X_FILTER_SLOTS (ADS129X_FILTER_TAPS/2 + 2)
+
+class ADS129X_Filter {
+    public:
+        ADS129X_Filter(byte _channels = 8);
+
+        // Biquad sections; _channel 1-n, 0 for all channels
+        void setBiquad(byte _section, byte _channel, float _b0, float _b1, float _b2, float _a1, float _a2);
+        void setNotch(byte _section, byte _channel, float _f0, float _fs, float _q);
+        void setHighPass(byte _section, byte _channel, float _fc, float _fs, float _q = 0.7071f);
+        void setLowPass(byte _section, byte _channel, float _fc, float _fs, float _q = 0.7071f);
+        void setBypass(byte _section, byte _channel);
+
+        // FIR decimator, applied to all channels
+        boolean setDecimation(byte _factor, byte _numTaps, const long *_taps);
+        boolean setDecimation(byte _factor, byte _numTaps);
+        byte getDecimation();
+
+        void reset();
+        boolean process(const long *_in, long *_out);
+
+    private:
+        byte channels;
+
+        // biquads, Q2.30 coefficients; err1/err2 hold the truncated
+        // fractions of the last two outputs (second-order error feedback),
+        // so rounding noise is not amplified by poles close to z = 1
+        int32_t b0[ADS129X_FILTER_SECTIONS][ADS129X_FILTER_CHANNELS];
+        int32_t b1[ADS129X_FILTER_SECTIONS][ADS129X_FILTER_CHANNELS];
+        int32_t b2[ADS129X_FILTER_SECTIONS][ADS129X_FILTER_CHANNELS];
+        int32_t a1[ADS129X_FILTER_SECTIONS][ADS129X_FILTER_CHANNELS];
+        int32_t a2[ADS129X_FILTER_SECTIONS][ADS129X_FILTER_CHANNELS];
+        int32_t x1[ADS129X_FILTER_SECTIONS][ADS129X_FILTER_CHANNELS];
+        int32_t x2[ADS129X_FILTER_SECTIONS][ADS129X_FILTER_CHANNELS];
+        int32_t y1[ADS129X_FILTER_SECTIONS][ADS129X_FILTER_CHANNELS];
+        int32_t y2[ADS129X_FILTER_SECTIONS][ADS129X_FILTER_CHANNELS];
+        int32_t err1[ADS129X_FILTER_SECTIONS][ADS129X_FILTER_CHANNELS];
+        int32_t err2[ADS129X_FILTER_SECTIONS][ADS129X_FILTER_CHANNELS];
+        byte activeSections; // bit n set if section n is not bypassed anywhere
+
+        // polyphase decimator: for input phase p the taps
+        // phaseStart[p]..phaseStart[p+1]-1 are added to the partial sum
+        // tapSlot[] slots ahead of the next output
+        byte factor, numTaps, numSlots, phase, headSlot;
+        int32_t taps[ADS129X_FILTER_TAPS];
+        byte tapSlot[ADS129X_FILTER_TAPS];
+        byte phaseStart[ADS129X_FILTER_TAPS + 1];
+        int64_t sums[ADS129X_FILTER_SLOTS][ADS129X_FILTER_CHANNELS];
+
+        void setSection(byte _section, byte _channel, int32_t _b0, int32_t _b1, int32_t _b2, int32_t _a1, int32_t _a2);
+        void setDesign(byte _section, byte _channel, double _b0, double _b1, double _b2, double _a1, double _a2);
+};
+
+#endif
@@ -0,0 +1,154 @@
+/**
+ * ADS129X_HAL.h
+ *
+ * Thin hardware abstraction for the ADS129X library: SPI bus, pins,
+ * interrupts and timing. On Arduino every call maps directly onto the
+ * core and SPI library. Anywhere else (host builds) the functions are
+ * implemented by extras/host/ADS129X_HAL_host.cpp, which connects them to
+ * a simulated ADS129x (see extras/host/ADS129X_Sim.h).
+ */
+
+#ifndef ____ADS129X_HAL__
+#define ____ADS129X_HAL__
+
+#if defined(ARDUINO)
+
+// Compatibility with the Arduino 1.0 library standard
+#if ARDUINO >= 100
+#include "Arduino.h"
+#else
+#include "WProgram.h"
+#endif
+#include <SPI.h>
+
+class ADS129X_HAL {
+    public:
+        // SPI bus, always MSB first and SPI mode 1 (Datasheet, pg. 8)
+        static inline void spiBegin() {
+            SPI.begin();
+        }
+        static inline void spiBeginTransaction(unsigned long _clock) {
+            SPI.beginTransaction(SPISettings(_clock, MSBFIRST, SPI_MODE1));
+        }
+        static inline void spiEndTransaction() {
+            SPI.endTransaction();
+        }
+        static inline byte spiTransfer(byte _data) {
+            return SPI.transfer(_data);
+        }
+        static inline void spiTransfer(byte *_buffer, size_t _count) {
+            SPI.transfer(_buffer, _count);
+        }
+        static inline void spiUsingInterrupt(int _pin) {
+            SPI.usingInterrupt(digitalPinToInterrupt(_pin));
+        }
+
+        // Pins and interrupts
+        static inline void pinMode(int _pin, byte _mode) {
+            ::pinMode(_pin, _mode);
+        }
+        static inline void digitalWrite(int _pin, byte _value) {
+            ::digitalWrite(_pin, _value);
+        }
+        static inline int digitalRead(int _pin) {
+            return ::digitalRead(_pin);
+        }
+        static inline void attachInterrupt(int _pin, void (*_isr)()) {
+            ::attachInterrupt(digitalPinToInterrupt(_pin), _isr, FALLING);
+        }
+        static inline void detachInterrupt(int _pin) {
+            ::detachInterrupt(digitalPinToInterrupt(_pin));
+        }
+        static inline void disableInterrupts() {
+            noInterrupts();
+        }
+        static inline void enableInterrupts() {
+            interrupts();
+        }
+
+        // Timing
+        static inline void delay(unsigned long _ms) {
+            ::delay(_ms);
+        }
+        static inline void delayMicroseconds(unsigned int _us) {
+            ::delayMicroseconds(_us);
+        }
+        static inline unsigned long micros() {
+            return ::micros();
+        }
+
+        // High-resolution timestamps: the DWT cycle counter on Cortex-M3,
+        // M4 and M7, micros() elsewhere. Ticks wrap around, only differences
+        // are meaningful.
+#if defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__)
+        static inline void ticksBegin() {
+            *(volatile uint32_t *) 0xE000EDFC |= (1UL << 24); // DEMCR.TRCENA
+            *(volatile uint32_t *) 0xE0001000 |= 1;           // DWT_CTRL.CYCCNTENA
+        }
+        static inline uint32_t ticks() {
+            return *(volatile uint32_t *) 0xE0001004;         // DWT_CYCCNT
+        }
+        static inline uint32_t ticksPerSecond() {
+            return F_CPU;
+        }
+#else
+        static inline void ticksBegin() {
+        }
+        static inline uint32_t ticks() {
+            return ::micros();
+        }
+        static inline uint32_t ticksPerSecond() {
+            return 1000000UL;
+        }
+#endif
+};
+
+#else
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH         0x1
+#define LOW          0x0
+#define INPUT        0x0
+#define OUTPUT       0x1
+#define INPUT_PULLUP 0x2
+
+class ADS129X_HAL {
+    public:
+        // SPI bus, always MSB first and SPI mode 1 (Datasheet, pg. 8)
+        static void spiBegin();
+        static void spiBeginTransaction(unsigned long _clock);
+        static void spiEndTransaction();
+        static byte spiTransfer(byte _data);
+        static void spiTransfer(byte *_buffer, size_t _count);
+        static void spiUsingInterrupt(int _pin);
+
+        // Pins and interrupts
+        static void pinMode(int _pin, byte _mode);
+        static void digitalWrite(int _pin, byte _value);
+        static int digitalRead(int _pin);
+        static void attachInterrupt(int _pin, void (*_isr)());
+        static void detachInterrupt(int _pin);
+        static void disableInterrupts();
+        static void enableInterrupts();
+
+        // Timing; on the host this is virtual time that only advances with
+        // delays and bus transfers
+        static void delay(unsigned long _ms);
+        static void delayMicroseconds(unsigned int _us);
+        static unsigned long micros();
+
+        // High-resolution timestamps, virtual nanoseconds on the host
+        static void ticksBegin();
+        static uint32_t ticks();
+        static uint32_t ticksPerSecond();
+};
+
+#endif
+
+#endif
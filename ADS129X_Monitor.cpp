@@ -0,0 +1,177 @@
+/**
+ * ADS129X_Monitor.cpp
+ *
+ * Debounced lead-off and GPIO events from the frame status word.
+ */
+
+#include "ADS129X_Monitor.h"
+
+/**
+ * Creates a monitor with all electrodes on and all GPIOs low, so electrodes
+ * that are off from the start are reported once they are debounced.
+ * @param _debounce frames a bit has to be stable (1-255)
+ */
+ADS129X_Monitor::ADS129X_Monitor(byte _debounce) {
+    callback = NULL;
+    setDebounce(_debounce);
+    reset();
+}
+
+/**
+ * Sets how many consecutive frames a bit has to keep its new value before
+ * the change is reported. At 500 SPS the default of 4 frames is 8 ms.
+ * @param _frames frames, 1 reports every change
+ */
+void ADS129X_Monitor::setDebounce(byte _frames) {
+    debounce = _frames ? _frames : 1;
+}
+
+/**
+ * Sets a function that is called from process() for every event. Events
+ * are then not queued.
+ * @param _callback function to call, NULL to queue events
+ */
+void ADS129X_Monitor::setCallback(void (*_callback)(const ADS129X_Event *_event)) {
+    callback = _callback;
+}
+
+/**
+ * Forgets the debounced state and drops queued events.
+ */
+void ADS129X_Monitor::reset() {
+    state = 0;
+    pending = 0;
+    memset(count, 0, sizeof(count));
+    invalidFrames = 0;
+    lostEvents = 0;
+    head = 0;
+    tail = 0;
+}
+
+/**
+ * Decodes the status word of a frame.
+ * @param _frame    frame as returned by getData, word 0 is the status word
+ * @param _sequence sequence number of the frame, copied into events
+ * @return          number of events raised
+ */
+byte ADS129X_Monitor::process(const long *_frame, unsigned long _sequence) {
+    uint32_t status = _frame[0];
+    if ((status & 0xF00000UL) != 0xC00000UL) {
+        invalidFrames++;
+        return 0;
+    }
+    uint32_t diff = (status & ADS129X_MONITOR_MASK) ^ state;
+    if ((diff | pending) == 0) {
+        return 0;
+    }
+    // bits that bounced back start over
+    uint32_t settled = pending & ~diff;
+    for (byte i = 0; settled; i++, settled >>= 1) {
+        if (settled & 1) count[i] = 0;
+    }
+    pending = diff;
+    byte raised = 0;
+    for (byte i = 0; diff; i++, diff >>= 1) {
+        if ((diff & 1) && ++count[i] >= debounce) {
+            uint32_t bit = 1UL << i;
+            state ^= bit;
+            pending &= ~bit;
+            count[i] = 0;
+            raise(i, (state & bit) != 0, _sequence);
+            raised++;
+        }
+    }
+    return raised;
+}
+
+void ADS129X_Monitor::raise(byte _bit, boolean _active, unsigned long _sequence) {
+    ADS129X_Event event;
+    event.sequence = _sequence;
+    event.active = _active;
+    if (_bit < 4) {
+        event.source = ADS129X_EVENT_GPIO;
+        event.channel = _bit + 1;
+    } else if (_bit < 12) {
+        event.source = ADS129X_EVENT_N;
+        event.channel = _bit - 3;
+    } else {
+        event.source = ADS129X_EVENT_P;
+        event.channel = _bit - 11;
+    }
+    if (callback != NULL) {
+        callback(&event);
+        return;
+    }
+    if ((byte) (head - tail) >= ADS129X_MONITOR_EVENTS) {
+        lostEvents++;
+        return;
+    }
+    events[head++ & (ADS129X_MONITOR_EVENTS - 1)] = event;
+}
+
+/**
+ * Takes the oldest queued event.
+ * @param _event receives the event
+ * @return       false if the queue is empty
+ */
+boolean ADS129X_Monitor::getEvent(ADS129X_Event *_event) {
+    if (head == tail) {
+        return false;
+    }
+    *_event = events[tail++ & (ADS129X_MONITOR_EVENTS - 1)];
+    return true;
+}
+
+/**
+ * Number of queued events.
+ */
+byte ADS129X_Monitor::available() {
+    return head - tail;
+}
+
+/**
+ * Debounced positive electrode status.
+ * @return bit n set if the electrode of channel n+1 is off
+ */
+byte ADS129X_Monitor::getLeadOffP() {
+    return state >> 12;
+}
+
+/**
+ * Debounced negative electrode status.
+ * @return bit n set if the electrode of channel n+1 is off
+ */
+byte ADS129X_Monitor::getLeadOffN() {
+    return state >> 4;
+}
+
+/**
+ * Debounced GPIO levels.
+ * @return bit n set if GPIO n+1 is high
+ */
+byte ADS129X_Monitor::getGpio() {
+    return state & 0x0F;
+}
+
+/**
+ * Whether either electrode of a channel is off.
+ * @param _channel channel (1-8)
+ */
+boolean ADS129X_Monitor::isLeadOff(byte _channel) {
+    byte bit = 1 << (_channel - 1);
+    return ((getLeadOffP() | getLeadOffN()) & bit) != 0;
+}
+
+/**
+ * Frames whose status word did not start with 1100; they are ignored.
+ */
+unsigned long ADS129X_Monitor::getInvalidFrames() {
+    return invalidFrames;
+}
+
+/**
+ * Events dropped because the queue was full.
+ */
+unsigned long ADS129X_Monitor::getLostEvents() {
+    return lostEvents;
+}
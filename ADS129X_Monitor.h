@@ -0,0 +1,86 @@
+/**
+ * ADS129X_Monitor.h
+ *
+ * Decodes the status word that starts every frame (Datasheet, pg. 32):
+ *
+ *     1100 | LOFF_STATP[7:0] | LOFF_STATN[7:0] | GPIO[4:1]
+ *
+ * Electrode status and GPIO inputs are debounced per bit over consecutive
+ * frames, and every change of the debounced state is reported as an event,
+ * either to a callback or through a small queue. Lead-off detection then
+ * costs a mask and a compare per frame while nothing changes, and never
+ * touches the bus, so streaming continues.
+ *
+ * The monitor takes the status word of one device; in a daisy chain use one
+ * monitor per device with the frame offset by d*(1 + channels).
+ */
+
+#ifndef ____ADS129X_MONITOR__
+#define ____ADS129X_MONITOR__
+
+#include "ADS129X_HAL.h"
+
+// Length of the event queue, a power of two
+#ifndef ADS129X_MONITOR_EVENTS
+#define ADS129X_MONITOR_EVENTS 8
+#endif
+
+// Frames a bit has to keep its new value before an event is raised
+#ifndef ADS129X_MONITOR_DEBOUNCE
+#define ADS129X_MONITOR_DEBOUNCE 4
+#endif
+
+// Status bits: GPIO in 3:0, LOFF_STATN in 11:4, LOFF_STATP in 19:12
+#define ADS129X_MONITOR_BITS 20
+#define ADS129X_MONITOR_MASK 0xFFFFFUL
+
+// Event sources
+#define ADS129X_EVENT_GPIO 0
+#define ADS129X_EVENT_N    1 // negative electrode
+#define ADS129X_EVENT_P    2 // positive electrode
+
+/**
+ * Change of a debounced status bit.
+ */
+struct ADS129X_Event {
+    unsigned long sequence; // frame on which the change was confirmed
+    byte source;            // ADS129X_EVENT_*
+    byte channel;           // channel 1-8, GPIO 1-4
+    boolean active;         // electrode off, GPIO high
+};
+
+class ADS129X_Monitor {
+    public:
+        ADS129X_Monitor(byte _debounce = ADS129X_MONITOR_DEBOUNCE);
+
+        void setDebounce(byte _frames);
+        void setCallback(void (*_callback)(const ADS129X_Event *_event));
+        void reset();
+
+        byte process(const long *_frame, unsigned long _sequence = 0);
+        boolean getEvent(ADS129X_Event *_event);
+        byte available();
+
+        // debounced state
+        byte getLeadOffP();
+        byte getLeadOffN();
+        byte getGpio();
+        boolean isLeadOff(byte _channel);
+        unsigned long getInvalidFrames();
+        unsigned long getLostEvents();
+
+    private:
+        byte debounce;
+        uint32_t state;   // debounced status bits
+        uint32_t pending; // bits that differ from state, being debounced
+        byte count[ADS129X_MONITOR_BITS];
+        unsigned long invalidFrames, lostEvents;
+        void (*callback)(const ADS129X_Event *_event);
+
+        ADS129X_Event events[ADS129X_MONITOR_EVENTS];
+        byte head, tail;
+
+        void raise(byte _bit, boolean _active, unsigned long _sequence);
+};
+
+#endif
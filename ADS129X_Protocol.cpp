@@ -0,0 +1,228 @@
+/**
+ * ADS129X_Protocol.cpp
+ *
+ * Encoder and decoder for the framed ADS129X wire format.
+ */
+
+#include "ADS129X_Protocol.h"
+
+// CRC-16/CCITT-FALSE (polynomial 0x1021), processed a nibble at a time
+static const uint16_t ADS129X_CRC_TABLE[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+/**
+ * CRC-16/CCITT-FALSE (initial value 0xFFFF).
+ * @param _data   data
+ * @param _length number of bytes
+ * @return CRC
+ */
+uint16_t ADS129X_crc16(const byte *_data, byte _length) {
+    uint16_t crc = 0xFFFF;
+    for (byte i = 0; i < _length; i++) {
+        crc = (crc << 4) ^ ADS129X_CRC_TABLE[(crc >> 12) ^ (_data[i] >> 4)];
+        crc = (crc << 4) ^ ADS129X_CRC_TABLE[(crc >> 12) ^ (_data[i] & 0x0F)];
+    }
+    return crc;
+}
+
+/**
+ * Encode one frame into a delimited packet.
+ * @param _frame    frame as returned by getData
+ * @param _channels number of channels (1-ADS129X_PROTOCOL_CHANNELS)
+ * @param _sequence sequence number
+ * @param _packet   buffer for ADS129X_PACKET_SIZE(_channels) bytes
+ * @return packet length in bytes
+ */
+byte ADS129X_encodeFrame(const long *_frame, byte _channels, byte _sequence, byte *_packet) {
+    byte payload[ADS129X_PAYLOAD_SIZE(ADS129X_PROTOCOL_CHANNELS)];
+    if (_channels > ADS129X_PROTOCOL_CHANNELS) {
+        _channels = ADS129X_PROTOCOL_CHANNELS;
+    }
+    byte n = 0;
+    payload[n++] = _sequence;
+    for (byte i = 0; i <= _channels; i++) {
+        payload[n++] = (byte) (_frame[i] >> 16);
+        payload[n++] = (byte) (_frame[i] >> 8);
+        payload[n++] = (byte) _frame[i];
+    }
+    uint16_t crc = ADS129X_crc16(payload, n);
+    payload[n++] = crc >> 8;
+    payload[n++] = crc;
+    return ADS129X_cobsEncode(payload, n, _packet);
+}
+
+/**
+ * COBS-encode a payload and append the 0x00 delimiter. Every zero is
+ * replaced by the distance to the next one, so the output contains no
+ * zeros except the delimiter.
+ * @param _data   payload (at most ADS129X_COBS_MAX bytes)
+ * @param _length payload length
+ * @param _packet buffer for _length + 2 bytes
+ * @return packet length in bytes
+ */
+byte ADS129X_cobsEncode(const byte *_data, byte _length, byte *_packet) {
+    byte code = 0, out = 1, run = 1;
+    for (byte i = 0; i < _length; i++) {
+        if (_data[i] == 0) {
+            _packet[code] = run;
+            code = out++;
+            run = 1;
+        } else {
+            _packet[out++] = _data[i];
+            if (++run == 0xFF) {
+                _packet[code] = run;
+                code = out++;
+                run = 1;
+            }
+        }
+    }
+    _packet[code] = run;
+    _packet[out++] = 0x00;
+    return out;
+}
+
+/**
+ * COBS-decode a packet in place. The delimiter must not be included.
+ * @param _buffer encoded packet, overwritten with the payload
+ * @param _length encoded length
+ * @return payload length, 0 if the packet is malformed
+ */
+byte ADS129X_cobsDecode(byte *_buffer, byte _length) {
+    byte n = 0, i = 0;
+    while (i < _length) {
+        byte code = _buffer[i++];
+        if (code == 0 || i + code - 1 > _length) {
+            return 0;
+        }
+        for (byte j = 1; j < code; j++) {
+            _buffer[n++] = _buffer[i++];
+        }
+        if (code < 0xFF && i < _length) {
+            _buffer[n++] = 0x00;
+        }
+    }
+    return n;
+}
+
+ADS129X_Decoder::ADS129X_Decoder() {
+    reset();
+    frames = 0;
+    lostFrames = 0;
+    errors = 0;
+    droppedBytes = 0;
+}
+
+/**
+ * Discard partial input; the next packet starts after a delimiter.
+ */
+void ADS129X_Decoder::reset() {
+    length = 0;
+    overflow = false;
+    synced = false;
+    haveSequence = false;
+    channels = 0;
+    sequence = 0;
+}
+
+/**
+ * Feed one received byte. Bytes before the first delimiter after reset()
+ * are dropped, so the sender starts its stream with a 0x00.
+ * @param _data received byte
+ * @return true when a complete, valid frame was decoded
+ */
+boolean ADS129X_Decoder::feed(byte _data) {
+    if (_data != 0x00) {
+        if (length < sizeof(buffer)) {
+            buffer[length++] = _data;
+        } else {
+            overflow = true;
+        }
+        return false;
+    }
+    boolean valid = false;
+    if (!synced) {
+        // bytes before the first delimiter belong to a partial packet
+        droppedBytes += length;
+        synced = true;
+    } else if (length > 0) {
+        valid = !overflow && decodePacket();
+        if (!valid) {
+            errors++;
+            droppedBytes += length;
+        }
+    }
+    length = 0;
+    overflow = false;
+    return valid;
+}
+
+/**
+ * COBS-decode the buffered packet in place and check it.
+ */
+boolean ADS129X_Decoder::decodePacket() {
+    byte n = ADS129X_cobsDecode(buffer, length);
+    if (n < ADS129X_PAYLOAD_SIZE(1) || (n - ADS129X_PAYLOAD_SIZE(0)) % 3 != 0) {
+        return false;
+    }
+    uint16_t crc = ((uint16_t) buffer[n-2] << 8) | buffer[n-1];
+    if (ADS129X_crc16(buffer, n - 2) != crc) {
+        return false;
+    }
+
+    byte _sequence = buffer[0];
+    if (haveSequence) {
+        lostFrames += (byte) (_sequence - sequence - 1);
+    }
+    sequence = _sequence;
+    haveSequence = true;
+    channels = (n - ADS129X_PAYLOAD_SIZE(0)) / 3;
+    const byte *p = buffer + 1;
+    frame[0] = ((long) p[0] << 16) | ((long) p[1] << 8) | p[2];
+    for (byte c = 1; c <= channels; c++) {
+        p += 3;
+        long value = ((long) p[0] << 16) | ((long) p[1] << 8) | p[2];
+        frame[c] = (value ^ 0x800000L) - 0x800000L;
+    }
+    frames++;
+    return true;
+}
+
+const long *ADS129X_Decoder::getFrame() {
+    return frame;
+}
+
+byte ADS129X_Decoder::getChannels() {
+    return channels;
+}
+
+byte ADS129X_Decoder::getSequence() {
+    return sequence;
+}
+
+unsigned long ADS129X_Decoder::getFrames() {
+    return frames;
+}
+
+/**
+ * Frames missing according to the sequence numbers. The sequence is 8 bits,
+ * so each gap counts modulo 256.
+ */
+unsigned long ADS129X_Decoder::getLostFrames() {
+    return lostFrames;
+}
+
+/**
+ * Packets rejected because of framing or CRC errors.
+ */
+unsigned long ADS129X_Decoder::getErrors() {
+    return errors;
+}
+
+/**
+ * Bytes discarded while resynchronizing or in rejected packets.
+ */
+unsigned long ADS129X_Decoder::getDroppedBytes() {
+    return droppedBytes;
+}
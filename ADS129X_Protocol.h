@@ -0,0 +1,75 @@
+/**
+ * ADS129X_Protocol.h
+ *
+ * Compact framed wire format for streaming ADS129X frames, one frame per
+ * packet:
+ *
+ *     sequence (1) | status word (3) | channel data (3 per channel) | CRC-16 (2)
+ *
+ * All values are big-endian. The CRC is CRC-16/CCITT-FALSE over the bytes
+ * before it. The packet is COBS-encoded and terminated by a 0x00 byte, so a
+ * receiver resynchronizes at the next delimiter and dropped frames show up
+ * as gaps in the sequence number. For 8 channels a packet takes 32 bytes
+ * on the wire.
+ *
+ * The decoder drops everything before the first delimiter it sees, since
+ * it may have joined in the middle of a packet. A sender therefore writes a
+ * single 0x00 when the stream starts, or its first packet is lost. The
+ * sequence number is 8 bits, so lost frames are only counted modulo 256: a
+ * gap of 256 frames or more is undercounted.
+ */
+
+#ifndef ____ADS129X_PROTOCOL__
+#define ____ADS129X_PROTOCOL__
+
+#include "ADS129X_HAL.h"
+
+// Maximum number of channels per packet
+#define ADS129X_PROTOCOL_CHANNELS 64
+
+// Packet payload before COBS encoding
+#define ADS129X_PAYLOAD_SIZE(channels) (6 + 3*(channels))
+
+// Encoded packet including COBS overhead and delimiter
+#define ADS129X_PACKET_SIZE(channels) (ADS129X_PAYLOAD_SIZE(channels) + 2)
+
+// Largest payload that fits one COBS packet of at most 255 bytes
+#define ADS129X_COBS_MAX 253
+
+uint16_t ADS129X_crc16(const byte *_data, byte _length);
+byte ADS129X_cobsEncode(const byte *_data, byte _length, byte *_packet);
+byte ADS129X_cobsDecode(byte *_buffer, byte _length);
+byte ADS129X_encodeFrame(const long *_frame, byte _channels, byte _sequence, byte *_packet);
+
+/**
+ * Incremental decoder for the packet format, fed one byte at a time.
+ */
+class ADS129X_Decoder {
+    public:
+        ADS129X_Decoder();
+
+        boolean feed(byte _data);
+        void reset();
+
+        // last decoded frame: word 0 status, words 1..channels data
+        const long *getFrame();
+        byte getChannels();
+        byte getSequence();
+
+        unsigned long getFrames();
+        unsigned long getLostFrames();
+        unsigned long getErrors();
+        unsigned long getDroppedBytes();
+
+    private:
+        byte buffer[ADS129X_PACKET_SIZE(ADS129X_PROTOCOL_CHANNELS)];
+        byte length;
+        boolean overflow, synced, haveSequence;
+        long frame[1 + ADS129X_PROTOCOL_CHANNELS];
+        byte channels, sequence;
+        unsigned long frames, lostFrames, errors, droppedBytes;
+
+        boolean decodePacket();
+};
+
+#endif
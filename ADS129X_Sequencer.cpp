@@ -0,0 +1,99 @@
+/**
+ * ADS129X_Sequencer.cpp
+ *
+ * Non-blocking start-up sequence for ADS129X devices.
+ */
+
+#include "ADS129X_Sequencer.h"
+
+/**
+ * Creates a sequencer for an ADS129X.
+ * @param _ads   device
+ * @param _PWDN  PWDN pin, -1 if it is tied high
+ * @param _START START pin, -1 if it is tied low; it is held low and
+ *               conversions are started with the START command
+ */
+ADS129X_Sequencer::ADS129X_Sequencer(ADS129X *_ads, int _PWDN, int _START) {
+    ads = _ads;
+    PWDN = _PWDN;
+    START = _START;
+    state = ADS129X_SEQ_IDLE;
+    startupTime = 0;
+}
+
+/**
+ * Start the sequence. Stage the configuration with setRegister/setChannel
+ * before; it is committed after the reset.
+ * @param _powerUp     wait for the power-on reset (tPOR); false if the
+ *                     device has been powered for a while
+ * @param _supplyDelay time in us the supplies need to come up, added to tPOR
+ */
+void ADS129X_Sequencer::begin(boolean _powerUp, unsigned long _supplyDelay) {
+    startTime = ADS129X_HAL::micros();
+    startupTime = 0;
+    if (START >= 0) {
+        ADS129X_HAL::pinMode(START, OUTPUT);
+        ADS129X_HAL::digitalWrite(START, LOW);
+    }
+    if (PWDN >= 0) {
+        ADS129X_HAL::pinMode(PWDN, OUTPUT);
+        ADS129X_HAL::digitalWrite(PWDN, HIGH);
+    }
+    wait(ADS129X_SEQ_POWER_UP, _powerUp ? _supplyDelay + ADS129X_tclkToMicros(ADS129X_TPOR_CYCLES) : 0);
+}
+
+void ADS129X_Sequencer::wait(byte _state, unsigned long _us) {
+    state = _state;
+    waitStart = ADS129X_HAL::micros();
+    waitTime = _us;
+}
+
+/**
+ * Advance the sequence; call this regularly until it returns true. Steps
+ * whose wait is over are run right away, so a fast loop does not add
+ * latency.
+ * @return true once conversions are running and the first data is ready
+ */
+boolean ADS129X_Sequencer::poll() {
+    while (state != ADS129X_SEQ_IDLE && state != ADS129X_SEQ_RUNNING) {
+        if (ADS129X_HAL::micros() - waitStart < waitTime) {
+            return false;
+        }
+        switch (state) {
+            case ADS129X_SEQ_POWER_UP:
+                // the device powers up in RDATAC mode, registers can only
+                // be written after SDATAC
+                ads->RESET();
+                ads->SDATAC();
+                ads->commit();
+                wait(ADS129X_SEQ_PROGRAM,
+                     (ads->getRegister(ADS129X_REG_CONFIG3) & (1<<ADS129X_BIT_PD_REFBUF)) ? ADS129X_TREF_US : 0);
+                break;
+            case ADS129X_SEQ_PROGRAM:
+                ads->RDATAC();
+                ads->START();
+                wait(ADS129X_SEQ_SETTLING, ads->getSettlingTime());
+                break;
+            case ADS129X_SEQ_SETTLING:
+                startupTime = ADS129X_HAL::micros() - startTime;
+                state = ADS129X_SEQ_RUNNING;
+                break;
+        }
+    }
+    return state == ADS129X_SEQ_RUNNING;
+}
+
+/**
+ * Current step of the sequence (ADS129X_SEQ_*).
+ */
+byte ADS129X_Sequencer::getState() {
+    return state;
+}
+
+/**
+ * Time from begin to the first data.
+ * @return startup time in us, 0 while the sequence is running
+ */
+unsigned long ADS129X_Sequencer::getStartupTime() {
+    return startupTime;
+}
@@ -0,0 +1,57 @@
+/**
+ * ADS129X_Sequencer.h
+ *
+ * Non-blocking start-up of an ADS129X: power-up, reset, SDATAC, register
+ * programming, RDATAC and START, as a state machine driven by poll().
+ * Waits are derived from the master clock (ADS129X_FCLK) and the data rate
+ * instead of fixed delays, and the sketch can do other work meanwhile:
+ *
+ *     ADS.setRegister(...);      // stage the configuration
+ *     sequencer.begin();
+ *     ...
+ *     void loop() {
+ *         if (!sequencer.poll()) return;  // true once data is flowing
+ *         ...
+ *     }
+ */
+
+#ifndef ____ADS129X_SEQUENCER__
+#define ____ADS129X_SEQUENCER__
+
+#include "ADS129X.h"
+
+// Power-on reset time after the supplies are up: 2^18 tCLK (Datasheet, pg. 48)
+#define ADS129X_TPOR_CYCLES 262144UL
+
+// Time the internal reference buffer needs after PD_REFBUF is set; the
+// examples have always waited 1 ms
+#ifndef ADS129X_TREF_US
+#define ADS129X_TREF_US 1000UL
+#endif
+
+// Sequencer states
+#define ADS129X_SEQ_IDLE      0
+#define ADS129X_SEQ_POWER_UP  1 // waiting for supplies and tPOR
+#define ADS129X_SEQ_PROGRAM   2 // reset and programmed, reference settling
+#define ADS129X_SEQ_SETTLING  3 // START sent, waiting for the first data
+#define ADS129X_SEQ_RUNNING   4
+
+class ADS129X_Sequencer {
+    public:
+        ADS129X_Sequencer(ADS129X *_ads, int _PWDN = -1, int _START = -1);
+
+        void begin(boolean _powerUp = true, unsigned long _supplyDelay = 0);
+        boolean poll();
+        byte getState();
+        unsigned long getStartupTime();
+
+    private:
+        ADS129X *ads;
+        int PWDN, START; // -1 if not connected
+        byte state;
+        unsigned long startTime, waitStart, waitTime, startupTime;
+
+        void wait(byte _state, unsigned long _us);
+};
+
+#endif
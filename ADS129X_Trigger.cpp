@@ -0,0 +1,366 @@
+/**
+ * ADS129X_Trigger.cpp
+ *
+ * Threshold-triggered capture with pre-trigger history.
+ */
+
+#include "ADS129X_Trigger.h"
+
+// Condition types
+#define ADS129X_CONDITION_LEVEL  0
+#define ADS129X_CONDITION_SLOPE  1
+#define ADS129X_CONDITION_STATUS 2 // (status & mask) == value
+#define ADS129X_CONDITION_ANY    3 // status & mask != 0
+
+/**
+ * Creates a disarmed trigger without conditions, with a window of 16
+ * pre-trigger and 48 post-trigger frames.
+ * @param _channels number of channels per frame (1-8)
+ */
+ADS129X_Trigger::ADS129X_Trigger(byte _channels) {
+    channels = (_channels > ADS129X_TRIGGER_WORDS - 1) ? ADS129X_TRIGGER_WORDS - 1 : _channels;
+    state = ADS129X_TRIGGER_IDLE;
+    clearConditions();
+    if (!setWindow(16, 48)) {
+        setWindow(ADS129X_TRIGGER_FRAMES / 4, ADS129X_TRIGGER_FRAMES);
+    }
+    triggerSequence = 0;
+    triggerTime = 0;
+    triggerConditions = 0;
+    preFrames = 0;
+    triggers = 0;
+    dropped = 0;
+}
+
+byte ADS129X_Trigger::add(byte _type, byte _channel, byte _direction, int32_t _threshold, uint32_t _mask, uint32_t _value) {
+    if (numConditions >= ADS129X_TRIGGER_CONDITIONS || _channel > channels ||
+        _direction > ADS129X_TRIGGER_OUTSIDE) {
+        return ADS129X_TRIGGER_NONE;
+    }
+    byte i = numConditions++;
+    type[i] = _type;
+    channel[i] = _channel;
+    direction[i] = _direction;
+    threshold[i] = _threshold;
+    mask[i] = _mask;
+    value[i] = _value;
+    return i;
+}
+
+/**
+ * Adds a condition on the value of a channel.
+ * @param _channel   1-n, 0 for any channel
+ * @param _level     threshold in LSB
+ * @param _direction ADS129X_TRIGGER_ABOVE, _BELOW or _OUTSIDE (|value|)
+ * @return           number of the condition for setLogic, or
+ *                   ADS129X_TRIGGER_NONE if it does not fit
+ */
+byte ADS129X_Trigger::addLevel(byte _channel, long _level, byte _direction) {
+    return add(ADS129X_CONDITION_LEVEL, _channel, _direction, _level, 0, 0);
+}
+
+/**
+ * Adds a condition on the change of a channel from one frame to the next.
+ * @param _channel   1-n, 0 for any channel
+ * @param _step      change in LSB, positive
+ * @param _direction ADS129X_TRIGGER_ABOVE (rising), _BELOW (falling) or
+ *                   _OUTSIDE (either)
+ * @return           number of the condition, or ADS129X_TRIGGER_NONE
+ */
+byte ADS129X_Trigger::addSlope(byte _channel, long _step, byte _direction) {
+    return add(ADS129X_CONDITION_SLOPE, _channel, _direction, _step < 0 ? -_step : _step, 0, 0);
+}
+
+/**
+ * Adds a condition on the status word, e.g. a GPIO input. Bits: GPIO in
+ * 3:0, LOFF_STATN in 11:4, LOFF_STATP in 19:12 (see ADS129X_Monitor.h).
+ * @param _mask  bits to compare
+ * @param _value required value of these bits
+ * @return       number of the condition, or ADS129X_TRIGGER_NONE
+ */
+byte ADS129X_Trigger::addStatus(unsigned long _mask, unsigned long _value) {
+    return add(ADS129X_CONDITION_STATUS, 0, 0, 0, _mask, _value & _mask);
+}
+
+/**
+ * Adds a condition that is true while an electrode of a channel is off.
+ * Lead-off detection has to be enabled in the LOFF registers.
+ * @param _channel 1-n, 0 for any channel
+ * @return         number of the condition, or ADS129X_TRIGGER_NONE
+ */
+byte ADS129X_Trigger::addLeadOff(byte _channel) {
+    uint32_t bits = _channel ? ((1UL << (12 + _channel - 1)) | (1UL << (4 + _channel - 1))) : 0xFFFF0UL;
+    return add(ADS129X_CONDITION_ANY, _channel, 0, 0, bits, 0);
+}
+
+/**
+ * Removes all conditions and terms.
+ */
+void ADS129X_Trigger::clearConditions() {
+    numConditions = 0;
+    numTerms = 0;
+}
+
+/**
+ * Sets how conditions combine: the trigger fires when all conditions of
+ * any one term are true. Without terms any single condition fires it.
+ * @param _terms    one bit mask of condition numbers per term
+ * @param _numTerms number of terms (0-ADS129X_TRIGGER_TERMS)
+ * @return          false if there are too many terms
+ */
+boolean ADS129X_Trigger::setLogic(const byte *_terms, byte _numTerms) {
+    if (_numTerms > ADS129X_TRIGGER_TERMS) {
+        return false;
+    }
+    for (byte t = 0; t < _numTerms; t++) {
+        terms[t] = _terms[t];
+    }
+    numTerms = _numTerms;
+    return true;
+}
+
+/**
+ * Sets the event window. The trigger frame is the first post-trigger frame.
+ * Call before arm().
+ * @param _pre  frames before the trigger frame, less than
+ *              ADS129X_TRIGGER_FRAMES
+ * @param _post frames from the trigger frame on, at least 1
+ * @return      false if out of range
+ */
+boolean ADS129X_Trigger::setWindow(unsigned int _pre, unsigned int _post) {
+    if (_pre >= ADS129X_TRIGGER_FRAMES || _post < 1) {
+        return false;
+    }
+    pre = _pre;
+    post = _post;
+    return true;
+}
+
+/**
+ * Clears the history and starts watching for the next event. A condition
+ * that is already true fires on the first frame.
+ */
+void ADS129X_Trigger::arm() {
+    head = 0;
+    readPosition = 0;
+    eventEnd = 0;
+    filled = 0;
+    matched = false;
+    havePrevious = false;
+    state = ADS129X_TRIGGER_ARMED;
+}
+
+/**
+ * Stops watching; frames of an event that have not been read are dropped.
+ */
+void ADS129X_Trigger::disarm() {
+    state = ADS129X_TRIGGER_IDLE;
+}
+
+/**
+ * Current state (ADS129X_TRIGGER_*).
+ */
+byte ADS129X_Trigger::getState() {
+    return state;
+}
+
+/**
+ * Checks all conditions on a frame.
+ * @return bit n set if condition n is true
+ */
+byte ADS129X_Trigger::evaluate(const long *_frame) {
+    byte hits = 0;
+    for (byte i = 0; i < numConditions; i++) {
+        boolean hit = false;
+        if (type[i] == ADS129X_CONDITION_STATUS) {
+            hit = ((uint32_t) _frame[0] & mask[i]) == value[i];
+        } else if (type[i] == ADS129X_CONDITION_ANY) {
+            hit = ((uint32_t) _frame[0] & mask[i]) != 0;
+        } else if (type[i] == ADS129X_CONDITION_LEVEL || havePrevious) {
+            byte first = channel[i] ? channel[i] : 1;
+            byte last = channel[i] ? channel[i] : channels;
+            for (byte c = first; c <= last && !hit; c++) {
+                int32_t x = _frame[c];
+                if (type[i] == ADS129X_CONDITION_SLOPE) {
+                    x -= previous[c];
+                }
+                switch (direction[i]) {
+                    case ADS129X_TRIGGER_ABOVE:
+                        hit = x >= threshold[i];
+                        break;
+                    case ADS129X_TRIGGER_BELOW:
+                        hit = (type[i] == ADS129X_CONDITION_SLOPE) ? x <= -threshold[i] : x <= threshold[i];
+                        break;
+                    default:
+                        hit = (x < 0 ? -x : x) >= threshold[i];
+                        break;
+                }
+            }
+        }
+        if (hit) {
+            hits |= 1 << i;
+        }
+    }
+    for (byte c = 1; c <= channels; c++) {
+        previous[c] = _frame[c];
+    }
+    havePrevious = true;
+    return hits;
+}
+
+/**
+ * Adds a frame to the history. If the reader lags a whole history behind,
+ * the oldest unread frame of the event is dropped.
+ */
+void ADS129X_Trigger::store(const long *_frame, unsigned long _sequence, uint32_t _timestamp) {
+    if (state != ADS129X_TRIGGER_ARMED && head - readPosition >= ADS129X_TRIGGER_FRAMES) {
+        readPosition++;
+        dropped++;
+        if ((long) (readPosition - eventEnd) >= 0) {
+            state = ADS129X_TRIGGER_ARMED;
+        }
+    }
+    unsigned int slot = head % ADS129X_TRIGGER_FRAMES;
+    for (byte i = 0; i <= channels; i++) {
+        frames[slot][i] = _frame[i];
+    }
+    sequences[slot] = _sequence;
+    timestamps[slot] = _timestamp;
+    head++;
+    if (filled < ADS129X_TRIGGER_FRAMES) {
+        filled++;
+    }
+}
+
+/**
+ * Feeds a frame. The conditions are checked on every frame, also while an
+ * event is being captured, so the trigger only fires again once the
+ * combination was false.
+ * @param _frame     frame in the getData layout; word 0 is the status word
+ * @param _sequence  frame sequence number from getData, kept with the frame
+ * @param _timestamp frame timestamp from getData, kept with the frame
+ * @return           true if the trigger fired on this frame
+ */
+boolean ADS129X_Trigger::process(const long *_frame, unsigned long _sequence, uint32_t _timestamp) {
+    if (state == ADS129X_TRIGGER_IDLE) {
+        return false;
+    }
+    byte hits = evaluate(_frame);
+    boolean now;
+    if (numTerms == 0) {
+        now = hits != 0;
+    } else {
+        now = false;
+        for (byte t = 0; t < numTerms && !now; t++) {
+            now = terms[t] != 0 && (hits & terms[t]) == terms[t];
+        }
+    }
+    boolean edge = now && !matched;
+    matched = now;
+    store(_frame, _sequence, _timestamp);
+
+    if (state == ADS129X_TRIGGER_CAPTURING && (long) (head - eventEnd) >= 0) {
+        state = ADS129X_TRIGGER_DRAINING;
+    }
+    if (state != ADS129X_TRIGGER_ARMED || !edge) {
+        return false;
+    }
+    // as many pre-trigger frames as the history holds
+    unsigned long position = head - 1;
+    unsigned long start = position - ((filled - 1 < pre) ? filled - 1 : pre);
+    triggers++;
+    triggerSequence = _sequence;
+    triggerTime = _timestamp;
+    triggerConditions = hits;
+    preFrames = position - start;
+    readPosition = start;
+    eventEnd = position + post;
+    state = ((long) (head - eventEnd) >= 0) ? ADS129X_TRIGGER_DRAINING : ADS129X_TRIGGER_CAPTURING;
+    return true;
+}
+
+/**
+ * Returns the next frame of the event window, oldest first: the
+ * pre-trigger frames, then the trigger frame and the frames after it as
+ * they arrive.
+ * @param _buffer    buffer for 1 + channels words
+ * @param _sequence  sequence number passed to process
+ * @param _timestamp timestamp passed to process
+ * @return           false if no frame of the window is waiting
+ */
+boolean ADS129X_Trigger::read(long *_buffer, unsigned long *_sequence, uint32_t *_timestamp) {
+    if (available() == 0) {
+        return false;
+    }
+    unsigned int slot = readPosition % ADS129X_TRIGGER_FRAMES;
+    for (byte i = 0; i <= channels; i++) {
+        _buffer[i] = frames[slot][i];
+    }
+    if (_sequence != NULL) {
+        *_sequence = sequences[slot];
+    }
+    if (_timestamp != NULL) {
+        *_timestamp = timestamps[slot];
+    }
+    if ((long) (++readPosition - eventEnd) >= 0) {
+        // window complete; watch for the next event
+        state = ADS129X_TRIGGER_ARMED;
+    }
+    return true;
+}
+
+/**
+ * Frames of the event window that can be read now.
+ */
+unsigned int ADS129X_Trigger::available() {
+    if (state != ADS129X_TRIGGER_CAPTURING && state != ADS129X_TRIGGER_DRAINING) {
+        return 0;
+    }
+    unsigned long end = ((long) (head - eventEnd) < 0) ? head : eventEnd;
+    return end - readPosition;
+}
+
+/**
+ * Sequence number of the frame that fired the last event.
+ */
+unsigned long ADS129X_Trigger::getTriggerSequence() {
+    return triggerSequence;
+}
+
+/**
+ * Timestamp of the frame that fired the last event, in ADS129X_HAL::ticks()
+ * if taken from getData.
+ */
+uint32_t ADS129X_Trigger::getTriggerTime() {
+    return triggerTime;
+}
+
+/**
+ * Conditions that were true on the frame that fired the last event.
+ * @return bit n set for condition n
+ */
+byte ADS129X_Trigger::getTriggerConditions() {
+    return triggerConditions;
+}
+
+/**
+ * Pre-trigger frames in the last event window; fewer than set if it fired
+ * before the history had filled.
+ */
+unsigned int ADS129X_Trigger::getPreFrames() {
+    return preFrames;
+}
+
+/**
+ * Events since construction.
+ */
+unsigned long ADS129X_Trigger::getTriggers() {
+    return triggers;
+}
+
+/**
+ * Event frames overwritten before they were read.
+ */
+unsigned long ADS129X_Trigger::getDropped() {
+    return dropped;
+}
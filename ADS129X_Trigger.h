@@ -0,0 +1,146 @@
+/**
+ * ADS129X_Trigger.h
+ *
+ * Captures windows around rare events instead of streaming every frame.
+ * Each frame from getData is checked against a set of conditions: channel
+ * levels, sample-to-sample slopes and status word bits such as lead-off.
+ * Conditions are combined as an OR of AND terms. While armed, the last
+ * frames are kept in a circular history; when the combination becomes true
+ * the window of pre-trigger frames, the trigger frame and the post-trigger
+ * frames after it are handed out with read(), oldest first:
+ *
+ *     byte level = trigger.addLevel(1, 200000, ADS129X_TRIGGER_OUTSIDE);
+ *     byte slope = trigger.addSlope(1, 5000, ADS129X_TRIGGER_OUTSIDE);
+ *     byte loff = trigger.addLeadOff(0);
+ *     byte terms[] = { (1<<level) | (1<<slope), 1<<loff };
+ *     trigger.setLogic(terms, 2);        // level and slope, or lead-off
+ *     trigger.setWindow(32, 96);
+ *     trigger.arm();
+ *     ...
+ *     if (ADS.getData(buffer, &sequence, &timestamp)) {
+ *         trigger.process(buffer, sequence, timestamp);
+ *     }
+ *     while (trigger.read(frame)) ...   // send the event window
+ *
+ * One event is captured at a time. Frames stream out while the post-trigger
+ * frames come in, so the history only has to hold the pre-trigger frames
+ * plus what the reader lags behind. The next event can trigger once the
+ * window has been read, and only after the combination was false again.
+ *
+ * The trigger takes frames of one device; in a daisy chain pass the words
+ * of one device and set the channels accordingly.
+ */
+
+#ifndef ____ADS129X_TRIGGER__
+#define ____ADS129X_TRIGGER__
+
+#include "ADS129X_HAL.h"
+
+// Frames of history, pre-trigger frames plus reader lag; a power of two, so
+// the slot of a position stays continuous when the position wraps
+#ifndef ADS129X_TRIGGER_FRAMES
+#define ADS129X_TRIGGER_FRAMES 64
+#endif
+#if (ADS129X_TRIGGER_FRAMES < 2) || (ADS129X_TRIGGER_FRAMES & (ADS129X_TRIGGER_FRAMES - 1))
+#error "ADS129X_TRIGGER_FRAMES must be a power of two"
+#endif
+
+// Maximum number of conditions, at most 8
+#ifndef ADS129X_TRIGGER_CONDITIONS
+#define ADS129X_TRIGGER_CONDITIONS 8
+#endif
+#if ADS129X_TRIGGER_CONDITIONS < 1 || ADS129X_TRIGGER_CONDITIONS > 8
+#error "ADS129X_TRIGGER_CONDITIONS must be between 1 and 8"
+#endif
+
+// Words of a frame of one device
+#define ADS129X_TRIGGER_WORDS 9
+
+// Maximum number of AND terms
+#ifndef ADS129X_TRIGGER_TERMS
+#define ADS129X_TRIGGER_TERMS 4
+#endif
+
+// Directions of level and slope conditions
+#define ADS129X_TRIGGER_ABOVE   0 // value >= level, slope >= step
+#define ADS129X_TRIGGER_BELOW   1 // value <= level, slope <= -step
+#define ADS129X_TRIGGER_OUTSIDE 2 // |value| >= level, |slope| >= step
+
+// Returned when no more conditions fit
+#define ADS129X_TRIGGER_NONE 0xFF
+
+// Trigger states
+#define ADS129X_TRIGGER_IDLE      0
+#define ADS129X_TRIGGER_ARMED     1 // filling the history, waiting for the event
+#define ADS129X_TRIGGER_CAPTURING 2 // collecting post-trigger frames
+#define ADS129X_TRIGGER_DRAINING  3 // window complete, waiting for read()
+
+class ADS129X_Trigger {
+    public:
+        ADS129X_Trigger(byte _channels = 8);
+
+        // conditions; _channel 1-n, 0 for any channel
+        byte addLevel(byte _channel, long _level, byte _direction);
+        byte addSlope(byte _channel, long _step, byte _direction);
+        byte addStatus(unsigned long _mask, unsigned long _value);
+        byte addLeadOff(byte _channel);
+        void clearConditions();
+        boolean setLogic(const byte *_terms, byte _numTerms);
+
+        boolean setWindow(unsigned int _pre, unsigned int _post);
+        void arm();
+        void disarm();
+        byte getState();
+
+        boolean process(const long *_frame, unsigned long _sequence = 0, uint32_t _timestamp = 0);
+        boolean read(long *_buffer, unsigned long *_sequence = NULL, uint32_t *_timestamp = NULL);
+        unsigned int available();
+
+        // last event
+        unsigned long getTriggerSequence();
+        uint32_t getTriggerTime();
+        byte getTriggerConditions();
+        unsigned int getPreFrames();
+
+        unsigned long getTriggers();
+        unsigned long getDropped();
+
+    private:
+        byte channels, state;
+        unsigned int pre, post;
+
+        // conditions, structure-of-arrays
+        byte numConditions;
+        byte type[ADS129X_TRIGGER_CONDITIONS];
+        byte channel[ADS129X_TRIGGER_CONDITIONS];
+        byte direction[ADS129X_TRIGGER_CONDITIONS];
+        int32_t threshold[ADS129X_TRIGGER_CONDITIONS];
+        uint32_t mask[ADS129X_TRIGGER_CONDITIONS];
+        uint32_t value[ADS129X_TRIGGER_CONDITIONS];
+        byte numTerms;
+        byte terms[ADS129X_TRIGGER_TERMS];
+        boolean matched;  // combination on the last frame
+        int32_t previous[ADS129X_TRIGGER_WORDS];
+        boolean havePrevious;
+
+        // history; positions count frames since arm() and wrap, so they
+        // are only compared by their difference
+        long frames[ADS129X_TRIGGER_FRAMES][ADS129X_TRIGGER_WORDS];
+        unsigned long sequences[ADS129X_TRIGGER_FRAMES];
+        uint32_t timestamps[ADS129X_TRIGGER_FRAMES];
+        unsigned long head;       // frames stored
+        unsigned long readPosition, eventEnd;
+        unsigned int filled;      // frames in the history, at most ADS129X_TRIGGER_FRAMES
+
+        unsigned long triggerSequence;
+        uint32_t triggerTime;
+        byte triggerConditions;
+        unsigned int preFrames;
+        unsigned long triggers, dropped;
+
+        byte add(byte _type, byte _channel, byte _direction, int32_t _threshold, uint32_t _mask, uint32_t _value);
+        byte evaluate(const long *_frame);
+        void store(const long *_frame, unsigned long _sequence, uint32_t _timestamp);
+};
+
+#endif
@@ -1,10 +1,19 @@
-#define ADS129X_POLLING
+/* Send all channels compressed; comment out to send channel 1 uncompressed */
+#define SEND_COMPRESSED
 
 #include <LowPower_Teensy3.h>
 #include <Adafruit_BLE_UART.h>
 #include <ADS129X.h>
+#include <ADS129X_Codec.h>
+#include <ADS129X_Batcher.h>
+#include <ADS129X_Arbiter.h>
 #include <SPI.h>
 
+/* The nRF8001 shares the bus, so the whole build has to use polling mode
+   (see README, Build options) */
+#ifndef ADS129X_POLLING
+#error "BTLE_EMG needs -DADS129X_POLLING in the compiler flags"
+#endif
 
 /* ADS129X pins */
 const int PSU_NEG = 1;
@@ -31,9 +40,29 @@ const int NRF_RST = 7;
 /* Power saving */
 const int notconnectedTimeout = 30000;
 
-ADS129X ADS = ADS129X(ADS_DRDY, ADS_CS);
+/* Longest nRF8001 transactions in us, check with arbiter.getLongestTransaction() */
+const unsigned long NRF_POLL_US = 300;
+const unsigned long NRF_CHUNK_US = 1000; // one 20 byte notification
+
+/* Adafruit_BLE_UART sends 20 byte chunks 35 ms apart; blocks go out one
+   chunk per grant, paced the same way, so no transaction spans the pause */
+const byte NRF_CHUNK = 20;
+const unsigned long NRF_CHUNK_INTERVAL_US = 35000;
+
+ADS129X ADS(ADS_DRDY, ADS_CS);
 Adafruit_BLE_UART BTLEserial = Adafruit_BLE_UART(NRF_REQN, NRF_RDYN, NRF_RST);
 TEENSY3_LP LP = TEENSY3_LP();
+/* Schedules radio transactions between ADC readbacks */
+ADS129X_Arbiter arbiter = ADS129X_Arbiter(&ADS);
+
+#ifdef SEND_COMPRESSED
+/* Compression: 8 channels, 8 frames per block */
+ADS129X_Encoder encoder = ADS129X_Encoder(8, 8);
+#else
+/* Batching: as many channel 1 samples as fit a 20 byte notification */
+ADS129X_Batcher batcher = ADS129X_Batcher(20, 1, false);
+const unsigned long batchDeadline = 20000; // us
+#endif
 
 void setup() {
   pinMode(PSU_NEG, OUTPUT);
@@ -61,15 +90,16 @@ void setup() {
   delay(1); // Wait for 18 tCLKs AKA 9 microseconds, we use 1 millisec
   
   ADS.SDATAC(); // device wakes up in RDATAC mode, so send stop signal
-  ADS.WREG(ADS129X_REG_GPIO, 0x00);
-  ADS.WREG(ADS129X_REG_CONFIG3, (1<<ADS129X_BIT_PD_REFBUF) | (1<<6)); // enable internal reference
-  ADS.WREG(ADS129X_REG_CONFIG2, 0x10); // test signal generation
+  ADS.setRegister(ADS129X_REG_GPIO, 0x00);
+  ADS.setRegister(ADS129X_REG_CONFIG3, (1<<ADS129X_BIT_PD_REFBUF) | (1<<6)); // enable internal reference
+  ADS.setRegister(ADS129X_REG_CONFIG2, 0x10); // test signal generation
 
   // setup channels
-  ADS.configChannel(1, false, ADS129X_GAIN_1X, ADS129X_MUX_TEST);
+  ADS.setChannel(1, false, ADS129X_GAIN_1X, ADS129X_MUX_TEST);
   for (int i = 2; i <= 8; i++) {
-    ADS.configChannel(i, false, ADS129X_GAIN_1X, ADS129X_MUX_SHORT);
+    ADS.setChannel(i, false, ADS129X_GAIN_1X, ADS129X_MUX_SHORT);
   }
+  ADS.commit(); // write all registers in as few bursts as possible
   
   Serial.begin(0); // always at 12MBit/s
   
@@ -117,9 +147,14 @@ void loop() {
   static aci_evt_opcode_t laststatus = ACI_EVT_DISCONNECTED;
   static long lastConnected = 0;
   
-  // tell the nRF8001 to do whatever it should be working on.
-  spiSettingNrf();
-  BTLEserial.pollACI();
+  // tell the nRF8001 to do whatever it should be working on, unless the
+  // next frame has to be read first
+  spiSettingAds();
+  if (arbiter.request(NRF_POLL_US)) {
+    spiSettingNrf();
+    BTLEserial.pollACI();
+    arbiter.release();
+  }
   if (digitalRead(NRF_REQN) == LOW)
     return;
   
@@ -132,6 +167,7 @@ void loop() {
         lastConnected = millis();
         // end continous read mode
         spiSettingAds();
+        arbiter.end();
         ADS.STOP();
         ADS.SDATAC();
     }
@@ -141,8 +177,15 @@ void loop() {
         while (digitalRead(ADS_DRDY) == LOW) ;
         delayMicroseconds(2);
         spiSettingAds();
+#ifdef SEND_COMPRESSED
+        encoder.reset();
+#else
+        batcher.reset();
+        batcher.setDeadline(batchDeadline);
+#endif
         ADS.RDATAC();
         ADS.START();
+        arbiter.begin();
     }
     if (status == ACI_EVT_DISCONNECTED) {
         /*digitalWrite(LED2, LOW);
@@ -173,22 +216,67 @@ void loop() {
   }
   
   if (status == ACI_EVT_CONNECTED) {    
-    // try to receive data
+    // try to receive data; a block is sent in chunks, each waiting until
+    // the arbiter finds a gap between readbacks that is long enough. One
+    // more block can queue up behind it, further ones are dropped and show
+    // up as lost frames at the receiver
     long buffer[9];
+    unsigned long sequence;
+    static byte packet[ADS129X_BLOCK_SIZE];
+    static byte pending = 0, sent = 0;
+    static byte queued[ADS129X_BLOCK_SIZE];
+    static byte queuedLength = 0;
+    static unsigned long lastChunk, droppedBlocks = 0;
+    byte next[ADS129X_BLOCK_SIZE];
+    byte length = 0;
     spiSettingAds();
-    if (ADS.getData(buffer)) {
-      // write data
-      byte sendBuffer[20];
-      if (buffer[1] > 8388607) {
-        buffer[1] -= 16777215;
-      }
-      // send raw value with LSB first
-      for (byte i = 0; i < 4; i++) {
-        sendBuffer[i] = (byte) (buffer[1] >> i*8);
-      }
+    arbiter.poll();
+#ifdef SEND_COMPRESSED
+    if (ADS.getData(buffer, &sequence)) {
       Serial.println(buffer[1], DEC);
+      // compress all channels; a block is complete every 8 frames, or
+      // early when frames were lost so the receiver sees the gap
+      length = encoder.addFrame(buffer, sequence, next);
+    }
+#else
+    // a packet is complete when it is full or its oldest sample is too old,
+    // so the SPI mode only changes once per notification
+    if (ADS.getData(buffer, &sequence)) {
+      Serial.println(buffer[1], DEC);
+      length = batcher.add(buffer, sequence, next);
+    }
+    if (length == 0 && queuedLength == 0) {
+      length = batcher.poll(next);
+    }
+#endif
+    if (length > 0) {
+      if (pending == 0) {
+        memcpy(packet, next, length);
+        pending = length;
+        sent = 0;
+      } else if (queuedLength == 0) {
+        memcpy(queued, next, length);
+        queuedLength = length;
+      } else {
+        droppedBlocks++;
+        Serial.print("dropped blocks: ");
+        Serial.println(droppedBlocks);
+      }
+    }
+    if (pending > 0 && micros() - lastChunk >= NRF_CHUNK_INTERVAL_US && arbiter.request(NRF_CHUNK_US)) {
+      byte chunk = (pending - sent > NRF_CHUNK) ? NRF_CHUNK : pending - sent;
       spiSettingNrf();
-      BTLEserial.write(sendBuffer, 4);
+      BTLEserial.write(packet + sent, chunk);
+      arbiter.release();
+      lastChunk = micros();
+      sent += chunk;
+      if (sent >= pending) {
+        // block complete, move the queued one up
+        memcpy(packet, queued, queuedLength);
+        pending = queuedLength;
+        queuedLength = 0;
+        sent = 0;
+      }
     }
   }
 }
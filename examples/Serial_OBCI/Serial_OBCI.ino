@@ -6,7 +6,7 @@ const int ADS_RESET  = 3;
 const int ADS_DRDY = 5;
 const int ADS_CS = 10;
 
-ADS129X ADS = ADS129X(ADS_DRDY, ADS_CS);
+ADS129X ADS(ADS_DRDY, ADS_CS);
 
 void setup() {
   pinMode(ADS_RESET, OUTPUT);
@@ -19,16 +19,17 @@ void setup() {
   delay(1); // Wait for 18 tCLKs AKA 9 microseconds, we use 1 millisec
 
   ADS.SDATAC(); // device wakes up in RDATAC mode, so send stop signal
-  ADS.WREG(ADS129X_REG_CONFIG1, ADS129X_SAMPLERATE_1024); // enable 8kHz sample-rate
-  ADS.WREG(ADS129X_REG_CONFIG3, (1<<ADS129X_BIT_PD_REFBUF) | (1<<6)); // enable internal reference
-  //ADS.WREG(ADS129X_REG_CONFIG2, (1<<ADS129X_BIT_INT_TEST) | ADS129X_TEST_FREQ_2HZ);
+  ADS.setRegister(ADS129X_REG_CONFIG1, ADS129X_SAMPLERATE_1024); // enable 8kHz sample-rate
+  ADS.setRegister(ADS129X_REG_CONFIG3, (1<<ADS129X_BIT_PD_REFBUF) | (1<<6)); // enable internal reference
+  //ADS.setRegister(ADS129X_REG_CONFIG2, (1<<ADS129X_BIT_INT_TEST) | ADS129X_TEST_FREQ_2HZ);
 
   // setup channels
-  ADS.configChannel(1, false, ADS129X_GAIN_12X, ADS129X_MUX_NORMAL);
-  ADS.configChannel(2, false, ADS129X_GAIN_12X, ADS129X_MUX_NORMAL);
+  ADS.setChannel(1, false, ADS129X_GAIN_12X, ADS129X_MUX_NORMAL);
+  ADS.setChannel(2, false, ADS129X_GAIN_12X, ADS129X_MUX_NORMAL);
   for (int i = 3; i <= 8; i++) {
-    ADS.configChannel(i, false, ADS129X_GAIN_1X, ADS129X_MUX_SHORT);
+    ADS.setChannel(i, false, ADS129X_GAIN_1X, ADS129X_MUX_SHORT);
   }
+  ADS.commit(); // write all registers in as few bursts as possible
 
   delay(1);
   ADS.RDATAC();
@@ -0,0 +1,187 @@
+/**
+ * ADS129X_Capture.cpp
+ *
+ * Reading and writing raw frame captures.
+ */
+
+#include "ADS129X_Capture.h"
+
+static const char ADS129X_CAPTURE_MAGIC[8] = { 'A', 'D', 'S', '1', '2', '9', 'X', 'C' };
+
+ADS129X_CaptureWriter::ADS129X_CaptureWriter() {
+    file = NULL;
+    frames = 0;
+}
+
+ADS129X_CaptureWriter::~ADS129X_CaptureWriter() {
+    close();
+}
+
+/**
+ * Creates a capture file.
+ * @param _path       file to write
+ * @param _frameBytes size of a raw frame (1-ADS129X_CAPTURE_FRAME)
+ * @param _config1    CONFIG1 of the device, 0 if unknown
+ * @param _sampleRate nominal data rate in SPS
+ * @return            false if the file could not be created
+ */
+boolean ADS129X_CaptureWriter::open(const char *_path, byte _frameBytes, byte _config1, unsigned long _sampleRate) {
+    close();
+    if (_frameBytes == 0 || _frameBytes > ADS129X_CAPTURE_FRAME) {
+        return false;
+    }
+    file = fopen(_path, "wb");
+    if (file == NULL) {
+        return false;
+    }
+    setvbuf(file, NULL, _IOFBF, 1 << 16);
+    byte header[ADS129X_CAPTURE_HEADER] = { 0 };
+    memcpy(header, ADS129X_CAPTURE_MAGIC, 8);
+    header[8] = ADS129X_CAPTURE_VERSION;
+    header[9] = _frameBytes;
+    header[10] = _config1;
+    for (byte i = 0; i < 4; i++) {
+        header[12 + i] = _sampleRate >> (8*i);
+    }
+    fwrite(header, 1, sizeof(header), file);
+    frameBytes = _frameBytes;
+    lastTime = 0;
+    frames = 0;
+    return true;
+}
+
+/**
+ * Appends a frame.
+ * @param _time  time DRDY went low in ns, not before the previous frame
+ * @param _frame raw frame bytes
+ * @return       false on a write error
+ */
+boolean ADS129X_CaptureWriter::write(uint64_t _time, const byte *_frame) {
+    if (file == NULL) {
+        return false;
+    }
+    uint64_t delta = (_time > lastTime) ? _time - lastTime : 0;
+    lastTime += delta;
+    byte varint[10];
+    byte length = 0;
+    do {
+        varint[length] = delta & 0x7F;
+        delta >>= 7;
+        if (delta) varint[length] |= 0x80;
+        length++;
+    } while (delta);
+    fwrite(varint, 1, length, file);
+    frames++;
+    return fwrite(_frame, 1, frameBytes, file) == frameBytes;
+}
+
+void ADS129X_CaptureWriter::close() {
+    if (file != NULL) {
+        fclose(file);
+        file = NULL;
+    }
+}
+
+boolean ADS129X_CaptureWriter::isOpen() {
+    return file != NULL;
+}
+
+unsigned long ADS129X_CaptureWriter::getFrames() {
+    return frames;
+}
+
+ADS129X_CaptureReader::ADS129X_CaptureReader() {
+    file = NULL;
+    frameBytes = 0;
+    config1 = 0;
+    sampleRate = 0;
+}
+
+ADS129X_CaptureReader::~ADS129X_CaptureReader() {
+    close();
+}
+
+/**
+ * Opens a capture file.
+ * @param _path file to read
+ * @return      false if it is missing or not a capture
+ */
+boolean ADS129X_CaptureReader::open(const char *_path) {
+    close();
+    file = fopen(_path, "rb");
+    if (file == NULL) {
+        return false;
+    }
+    byte header[ADS129X_CAPTURE_HEADER];
+    if (fread(header, 1, sizeof(header), file) != sizeof(header) ||
+        memcmp(header, ADS129X_CAPTURE_MAGIC, 8) != 0 ||
+        header[8] != ADS129X_CAPTURE_VERSION ||
+        header[9] == 0 || header[9] > ADS129X_CAPTURE_FRAME) {
+        close();
+        return false;
+    }
+    frameBytes = header[9];
+    config1 = header[10];
+    sampleRate = 0;
+    for (byte i = 0; i < 4; i++) {
+        sampleRate |= (unsigned long) header[12 + i] << (8*i);
+    }
+    time = 0;
+    return true;
+}
+
+/**
+ * Reads the next frame.
+ * @param _time  receives the time DRDY went low in ns
+ * @param _frame buffer for getFrameBytes() bytes
+ * @return       false at the end of the capture
+ */
+boolean ADS129X_CaptureReader::next(uint64_t *_time, byte *_frame) {
+    if (file == NULL) {
+        return false;
+    }
+    uint64_t delta = 0;
+    for (byte shift = 0; ; shift += 7) {
+        int c = fgetc(file);
+        if (c == EOF || shift > 63) {
+            return false;
+        }
+        delta |= (uint64_t) (c & 0x7F) << shift;
+        if (!(c & 0x80)) break;
+    }
+    if (fread(_frame, 1, frameBytes, file) != frameBytes) {
+        return false;
+    }
+    time += delta;
+    *_time = time;
+    return true;
+}
+
+/**
+ * Goes back to the first frame.
+ */
+void ADS129X_CaptureReader::rewind() {
+    if (file != NULL) {
+        fseek(file, ADS129X_CAPTURE_HEADER, SEEK_SET);
+        time = 0;
+    }
+}
+
+void ADS129X_CaptureReader::close() {
+    if (file != NULL) {
+        fclose(file);
+        file = NULL;
+    }
+}
+
+byte ADS129X_CaptureReader::getFrameBytes() {
+    return frameBytes;
+}
+
+byte ADS129X_CaptureReader::getConfig1() {
+    return config1;
+}
+
+unsigned long ADS129X_CaptureReader::getSampleRate() {
+    return sampleRate;
+}
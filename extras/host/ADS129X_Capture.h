@@ -0,0 +1,70 @@
+/**
+ * ADS129X_Capture.h
+ *
+ * Raw frame captures for deterministic replay on the host. A capture holds
+ * the bytes of every frame exactly as they were clocked off the bus, with
+ * the time DRDY went low, so ADS129X_Sim can play them back through the
+ * unmodified library.
+ *
+ * File layout, little-endian:
+ *
+ *     "ADS129XC" | version (1) | frame bytes (1) | CONFIG1 (1) | reserved (1) |
+ *     sample rate (4) | record | record | ...
+ *
+ * Each record is the time since the previous record in ns as an unsigned
+ * LEB128 varint (the first one counts from 0), followed by the raw frame.
+ * At 8 kSPS a 27-byte frame takes 30 bytes. CONFIG1 is 0 if unknown.
+ */
+
+#ifndef ____ADS129X_CAPTURE__
+#define ____ADS129X_CAPTURE__
+
+#include <stdio.h>
+#include "ADS129X.h"
+
+#define ADS129X_CAPTURE_VERSION 1
+#define ADS129X_CAPTURE_HEADER  16
+
+// Largest frame in a capture: a chain of 8 devices
+#define ADS129X_CAPTURE_FRAME (8 * 27)
+
+class ADS129X_CaptureWriter {
+    public:
+        ADS129X_CaptureWriter();
+        ~ADS129X_CaptureWriter();
+
+        boolean open(const char *_path, byte _frameBytes, byte _config1, unsigned long _sampleRate);
+        boolean write(uint64_t _time, const byte *_frame);
+        void close();
+        boolean isOpen();
+        unsigned long getFrames();
+
+    private:
+        FILE *file;
+        byte frameBytes;
+        uint64_t lastTime;
+        unsigned long frames;
+};
+
+class ADS129X_CaptureReader {
+    public:
+        ADS129X_CaptureReader();
+        ~ADS129X_CaptureReader();
+
+        boolean open(const char *_path);
+        boolean next(uint64_t *_time, byte *_frame);
+        void rewind();
+        void close();
+
+        byte getFrameBytes();
+        byte getConfig1();
+        unsigned long getSampleRate();
+
+    private:
+        FILE *file;
+        byte frameBytes, config1;
+        unsigned long sampleRate;
+        uint64_t time;
+};
+
+#endif
@@ -0,0 +1,275 @@
+/**
+ * ADS129X_HAL_host.cpp
+ *
+ * Host implementation of ADS129X_HAL. Pins, SPI and interrupts are routed
+ * to simulated devices registered with ADS129X_Host::attach. Time is
+ * virtual: it advances with delays and with every byte on the bus (at the
+ * SCLK of the current transaction), and DRDY interrupts are delivered at
+ * the exact virtual time the model signals them.
+ */
+
+#include <time.h>
+#include "ADS129X_HAL.h"
+#include "ADS129X_Sim.h"
+
+#define ADS129X_HOST_DEVICES 8
+#define ADS129X_HOST_PINS    256
+
+struct ADS129X_HostDevice {
+    ADS129X_Sim *sim;
+    int CS, DRDY, START;
+    void (*isr)();
+    boolean pending;
+    byte lastMiso;
+};
+
+static ADS129X_HostDevice hostDevices[ADS129X_HOST_DEVICES];
+static byte hostNumDevices = 0;
+static byte hostPins[ADS129X_HOST_PINS];
+static uint64_t hostNow = 0;
+static unsigned long hostClock = 4000000;
+static boolean hostInterruptsEnabled = true;
+static boolean hostInIsr = false;
+static boolean hostInTransaction = false;
+static boolean hostUsingInterrupt = false;
+static boolean hostRealTime = false;
+static uint64_t hostWallStart, hostVirtualStart;
+
+static uint64_t hostWallClock() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * In real-time mode, waits until the wall clock has caught up with virtual
+ * time. Lags of up to 1 ms are not slept off, to keep syscalls rare.
+ */
+static void hostPace() {
+    if (!hostRealTime) return;
+    uint64_t elapsed = hostWallClock() - hostWallStart;
+    uint64_t virtualElapsed = hostNow - hostVirtualStart;
+    if (virtualElapsed > elapsed + 1000000ULL) {
+        uint64_t ahead = virtualElapsed - elapsed;
+        struct timespec ts;
+        ts.tv_sec = ahead / 1000000000ULL;
+        ts.tv_nsec = ahead % 1000000000ULL;
+        nanosleep(&ts, NULL);
+    }
+}
+
+/**
+ * Runs pending DRDY interrupts unless they are masked.
+ */
+static void hostDispatch() {
+    if (hostInIsr || !hostInterruptsEnabled || (hostInTransaction && hostUsingInterrupt)) {
+        return;
+    }
+    boolean again = true;
+    while (again) {
+        again = false;
+        for (byte i = 0; i < hostNumDevices; i++) {
+            ADS129X_HostDevice &device = hostDevices[i];
+            if (device.pending && device.isr != NULL) {
+                device.pending = false;
+                hostInIsr = true;
+                device.isr();
+                hostInIsr = false;
+                again = true;
+            }
+        }
+    }
+}
+
+/**
+ * Advances virtual time event by event so no DRDY edge is skipped.
+ */
+static void hostAdvanceTo(uint64_t _target) {
+    for (;;) {
+        uint64_t next = _target;
+        for (byte i = 0; i < hostNumDevices; i++) {
+            uint64_t event = hostDevices[i].sim->nextEvent();
+            if (event < next) next = event;
+        }
+        if (next > hostNow) hostNow = next;
+        hostPace();
+        for (byte i = 0; i < hostNumDevices; i++) {
+            ADS129X_HostDevice &device = hostDevices[i];
+            device.sim->update(hostNow);
+            if (device.sim->takeFallingEdge() && device.isr != NULL) {
+                device.pending = true;
+            }
+        }
+        hostDispatch();
+        if (hostNow >= _target) break;
+    }
+}
+
+static ADS129X_HostDevice *hostDeviceByCS(int _pin) {
+    for (byte i = 0; i < hostNumDevices; i++) {
+        if (hostDevices[i].CS == _pin) return &hostDevices[i];
+    }
+    return NULL;
+}
+
+static ADS129X_HostDevice *hostDeviceByDRDY(int _pin) {
+    for (byte i = 0; i < hostNumDevices; i++) {
+        if (hostDevices[i].DRDY == _pin) return &hostDevices[i];
+    }
+    return NULL;
+}
+
+void ADS129X_Host::attach(ADS129X_Sim *_sim, int _CS, int _DRDY, int _START) {
+    if (hostNumDevices >= ADS129X_HOST_DEVICES) return;
+    ADS129X_HostDevice &device = hostDevices[hostNumDevices++];
+    device.sim = _sim;
+    device.CS = _CS;
+    device.DRDY = _DRDY;
+    device.START = _START;
+    device.isr = NULL;
+    device.pending = false;
+    device.lastMiso = 0xFF;
+    _sim->update(hostNow);
+}
+
+void ADS129X_Host::advance(uint64_t _ns) {
+    hostAdvanceTo(hostNow + _ns);
+}
+
+uint64_t ADS129X_Host::now() {
+    return hostNow;
+}
+
+unsigned long ADS129X_Host::getSpiClock() {
+    return hostClock;
+}
+
+void ADS129X_Host::setRealTime(boolean _realTime) {
+    hostRealTime = _realTime;
+    hostWallStart = hostWallClock();
+    hostVirtualStart = hostNow;
+}
+
+// SPI bus
+
+void ADS129X_HAL::spiBegin() {
+}
+
+void ADS129X_HAL::spiBeginTransaction(unsigned long _clock) {
+    hostClock = _clock;
+    hostInTransaction = true;
+}
+
+void ADS129X_HAL::spiEndTransaction() {
+    hostInTransaction = false;
+    hostDispatch();
+}
+
+byte ADS129X_HAL::spiTransfer(byte _data) {
+    byte miso = 0xFF;
+    for (byte i = 0; i < hostNumDevices; i++) {
+        ADS129X_HostDevice &device = hostDevices[i];
+        byte out = device.sim->transfer(_data);
+        if (device.sim->getMaxSpiClock() != 0 && hostClock > device.sim->getMaxSpiClock()) {
+            // too fast for the board: every bit is sampled one bit late
+            byte late = (out >> 1) | (device.lastMiso << 7);
+            device.lastMiso = out;
+            out = late;
+        } else {
+            device.lastMiso = out;
+        }
+        if (hostPins[device.CS & 0xFF] == LOW) miso = out;
+    }
+    hostAdvanceTo(hostNow + 8000000000ULL / hostClock);
+    return miso;
+}
+
+void ADS129X_HAL::spiTransfer(byte *_buffer, size_t _count) {
+    for (size_t i = 0; i < _count; i++) {
+        _buffer[i] = spiTransfer(_buffer[i]);
+    }
+}
+
+void ADS129X_HAL::spiUsingInterrupt(int _pin) {
+    (void) _pin;
+    hostUsingInterrupt = true;
+}
+
+// Pins and interrupts
+
+void ADS129X_HAL::pinMode(int _pin, byte _mode) {
+    if (_mode == INPUT_PULLUP) {
+        hostPins[_pin & 0xFF] = HIGH;
+    }
+}
+
+void ADS129X_HAL::digitalWrite(int _pin, byte _value) {
+    hostPins[_pin & 0xFF] = _value;
+    ADS129X_HostDevice *device = hostDeviceByCS(_pin);
+    if (device != NULL) {
+        device->sim->select(_value == LOW);
+    }
+    for (byte i = 0; i < hostNumDevices; i++) {
+        if (hostDevices[i].START == _pin) {
+            hostDevices[i].sim->setStartPin(_value == HIGH);
+        }
+    }
+}
+
+int ADS129X_HAL::digitalRead(int _pin) {
+    ADS129X_HostDevice *device = hostDeviceByDRDY(_pin);
+    if (device != NULL) {
+        return device->sim->drdy();
+    }
+    return hostPins[_pin & 0xFF];
+}
+
+void ADS129X_HAL::attachInterrupt(int _pin, void (*_isr)()) {
+    ADS129X_HostDevice *device = hostDeviceByDRDY(_pin);
+    if (device != NULL) {
+        device->isr = _isr;
+        device->pending = false;
+    }
+}
+
+void ADS129X_HAL::detachInterrupt(int _pin) {
+    ADS129X_HostDevice *device = hostDeviceByDRDY(_pin);
+    if (device != NULL) {
+        device->isr = NULL;
+        device->pending = false;
+    }
+}
+
+void ADS129X_HAL::disableInterrupts() {
+    hostInterruptsEnabled = false;
+}
+
+void ADS129X_HAL::enableInterrupts() {
+    hostInterruptsEnabled = true;
+    hostDispatch();
+}
+
+// Timing
+
+void ADS129X_HAL::delay(unsigned long _ms) {
+    hostAdvanceTo(hostNow + (uint64_t) _ms * 1000000ULL);
+}
+
+void ADS129X_HAL::delayMicroseconds(unsigned int _us) {
+    hostAdvanceTo(hostNow + (uint64_t) _us * 1000ULL);
+}
+
+unsigned long ADS129X_HAL::micros() {
+    return (unsigned long) (hostNow / 1000ULL);
+}
+
+void ADS129X_HAL::ticksBegin() {
+}
+
+uint32_t ADS129X_HAL::ticks() {
+    return (uint32_t) hostNow;
+}
+
+uint32_t ADS129X_HAL::ticksPerSecond() {
+    return 1000000000UL;
+}
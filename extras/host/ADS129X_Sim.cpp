@@ -0,0 +1,526 @@
+/**
+ * ADS129X_Sim.cpp
+ *
+ * Cycle-approximate model of an ADS129x for host builds.
+ */
+
+#include <math.h>
+#include "ADS129X_Sim.h"
+
+// Gain for each ADS129X_GAIN_* code
+static const double ADS129X_SIM_GAIN[8] = { 6, 1, 2, 3, 4, 8, 12, 6 };
+
+/**
+ * Creates a device in power-up state (RDATAC, conversions stopped).
+ * @param _id   value of the ID register, selects 4, 6 or 8 channels
+ * @param _fCLK master clock frequency in Hz
+ */
+ADS129X_Sim::ADS129X_Sim(byte _id, double _fCLK) {
+    id = _id;
+    channels = 4 + 2*(_id & 0x03);
+    if (channels > 8) channels = 8;
+    fCLK = _fCLK;
+    maxSpiClock = 0;
+    now = 0;
+    state = IDLE;
+    selected = false;
+    readContinuous = true;
+    converting = false;
+    standby = false;
+    activeTime = 0;
+    activeSince = 0;
+    startPin = false;
+    outLength = 0;
+    outPosition = 0;
+    nextConversion = UINT64_MAX;
+    drdyLow = false;
+    fallingEdge = false;
+    conversions = 0;
+    statP = 0;
+    statN = 0;
+    daisyIn = NULL;
+    noiseState = 0x12345678 ^ _id;
+    replay = NULL;
+    capture = NULL;
+    replayValid = false;
+    memset(frame, 0, sizeof(frame));
+    memset(samples, 0, sizeof(samples));
+    resetRegisters();
+}
+
+/**
+ * Connects the model to the pins used by the library.
+ * @param _CS    chip-select pin
+ * @param _DRDY  data ready pin
+ * @param _START START pin, -1 if not connected
+ */
+void ADS129X_Sim::attach(int _CS, int _DRDY, int _START) {
+    ADS129X_Host::attach(this, _CS, _DRDY, _START);
+}
+
+/**
+ * Chains another device to DAISY_IN.
+ * @param _next device whose data follows ours on DOUT
+ */
+void ADS129X_Sim::setDaisyIn(ADS129X_Sim *_next) {
+    daisyIn = _next;
+}
+
+/**
+ * Sets the electrode status returned in the status word and in
+ * LOFF_STATP/LOFF_STATN.
+ * @param _statP positive electrodes off (bit n = channel n+1)
+ * @param _statN negative electrodes off (bit n = channel n+1)
+ */
+void ADS129X_Sim::setLeadOff(byte _statP, byte _statN) {
+    statP = _statP;
+    statN = _statN;
+    regs[ADS129X_REG_LOFF_STATP] = statP;
+    regs[ADS129X_REG_LOFF_STATN] = statN;
+}
+
+byte ADS129X_Sim::getRegister(byte _address) {
+    return regs[_address & 0x1F];
+}
+
+byte ADS129X_Sim::getChannels() {
+    return channels;
+}
+
+boolean ADS129X_Sim::isReadContinuous() {
+    return readContinuous;
+}
+
+boolean ADS129X_Sim::isConverting() {
+    return converting && !standby;
+}
+
+uint64_t ADS129X_Sim::getActiveTime() {
+    return standby ? activeTime : activeTime + (now - activeSince);
+}
+
+/**
+ * Data rate programmed in CONFIG1 (Datasheet, pg. 65).
+ * @return data rate in SPS
+ */
+double ADS129X_Sim::getDataRate() {
+    return 1e9 / conversionPeriod();
+}
+
+void ADS129X_Sim::setMaxSpiClock(unsigned long _clock) {
+    maxSpiClock = _clock;
+}
+
+unsigned long ADS129X_Sim::getMaxSpiClock() {
+    return maxSpiClock;
+}
+
+/**
+ * Replays a capture. Frames keep their recorded spacing; CONFIG1 only
+ * matters for the settling time before the first one.
+ * @param _replay open capture, NULL to return to synthetic signals
+ */
+void ADS129X_Sim::setReplay(ADS129X_CaptureReader *_replay) {
+    replay = _replay;
+    replayValid = (replay != NULL) && replay->next(&replayTime, replayFrame);
+    if (converting) startConversions();
+}
+
+/**
+ * Returns whether the last frame of the capture has been converted.
+ */
+boolean ADS129X_Sim::isReplayDone() {
+    return replay != NULL && !replayValid;
+}
+
+void ADS129X_Sim::setCapture(ADS129X_CaptureWriter *_capture) {
+    capture = _capture;
+}
+
+unsigned long ADS129X_Sim::getConversions() {
+    return conversions;
+}
+
+long ADS129X_Sim::getSample(byte _channel) {
+    return samples[(_channel - 1) & 7];
+}
+
+/**
+ * Reset all registers to their default values (Datasheet, pg. 63).
+ */
+void ADS129X_Sim::resetRegisters() {
+    memset(regs, 0, sizeof(regs));
+    regs[ADS129X_REG_ID] = id;
+    regs[ADS129X_REG_CONFIG1] = 0x06;
+    regs[ADS129X_REG_CONFIG2] = 0x40;
+    regs[ADS129X_REG_CONFIG3] = 0x40;
+    regs[ADS129X_REG_GPIO] = 0x0F;
+    regs[ADS129X_REG_LOFF_STATP] = statP;
+    regs[ADS129X_REG_LOFF_STATN] = statN;
+}
+
+uint64_t ADS129X_Sim::clockPeriods(double _periods) {
+    return (uint64_t) (_periods * 1e9 / fCLK + 0.5);
+}
+
+/**
+ * Conversion period in ns: fMOD/16 in high-resolution mode, fMOD/32 in
+ * low-power mode, divided by 2^DR (Datasheet, pg. 65).
+ */
+uint64_t ADS129X_Sim::conversionPeriod() {
+    byte config1 = regs[ADS129X_REG_CONFIG1];
+    byte dr = config1 & 0x07;
+    if (dr > 6) dr = 6;
+    double tMOD = (config1 & (1<<ADS129X_BIT_HR)) ? 4 : 8;
+    return clockPeriods(tMOD * (16 << dr));
+}
+
+/**
+ * Time from START to the first DRDY, from the settling time table in tCLK
+ * (Datasheet, pg. 29): 296 tCLK at 32 kSPS doubling with every DR step,
+ * in low-power mode the value of the next DR step.
+ */
+uint64_t ADS129X_Sim::settlingTime() {
+    byte config1 = regs[ADS129X_REG_CONFIG1];
+    byte dr = config1 & 0x07;
+    if (dr > 6) dr = 6;
+    if (!(config1 & (1<<ADS129X_BIT_HR))) dr++;
+    return clockPeriods(18.0 * (16 << dr) + 8);
+}
+
+byte ADS129X_Sim::frameBytes() {
+    return (replay != NULL) ? replay->getFrameBytes() : 3 + 3*channels;
+}
+
+byte ADS129X_Sim::getFrameBytes() {
+    return frameBytes();
+}
+
+void ADS129X_Sim::startConversions() {
+    converting = true;
+    nextConversion = now + settlingTime();
+    if (replay != NULL) {
+        // the capture continues where it stopped, shifted to this START
+        replayOffset = (int64_t) nextConversion - (int64_t) replayTime;
+        if (!replayValid) nextConversion = UINT64_MAX;
+    }
+}
+
+/**
+ * Time of the conversion after the current one.
+ */
+uint64_t ADS129X_Sim::followingConversion() {
+    if (replay == NULL) {
+        return nextConversion + conversionPeriod();
+    }
+    return replayValid ? (uint64_t) (replayTime + replayOffset) : UINT64_MAX;
+}
+
+/**
+ * Bus side: CS changed.
+ * In RDATAC mode the last conversion result is shifted out from the first
+ * SCLK on.
+ */
+void ADS129X_Sim::select(boolean _selected) {
+    // chained devices share CS, DIN and START with us
+    if (daisyIn != NULL) daisyIn->select(_selected);
+    selected = _selected;
+    state = IDLE;
+    outLength = 0;
+    outPosition = 0;
+    if (selected && readContinuous) {
+        outLength = loadFrame(out, sizeof(out));
+    }
+}
+
+/**
+ * Copies the current frame, followed by the frames of the chained devices,
+ * into _buffer.
+ * @return number of bytes copied
+ */
+byte ADS129X_Sim::loadFrame(byte *_buffer, byte _space) {
+    byte length = frameBytes();
+    if (length > _space) length = _space;
+    memcpy(_buffer, frame, length);
+    if (regs[ADS129X_REG_CONFIG1] & (1<<ADS129X_BIT_DAISY_EN)) {
+        // multiple readback mode: data repeats
+        while (length + frameBytes() <= _space) {
+            memcpy(_buffer + length, frame, frameBytes());
+            length += frameBytes();
+        }
+    } else if (daisyIn != NULL) {
+        length += daisyIn->loadFrame(_buffer + length, _space - length);
+    }
+    return length;
+}
+
+/**
+ * Bus side: exchange one byte.
+ * @param _mosi byte sent by the host
+ * @return byte shifted out on DOUT
+ */
+byte ADS129X_Sim::transfer(byte _mosi) {
+    if (!selected) {
+        return 0xFF;
+    }
+    if (daisyIn != NULL) daisyIn->transfer(_mosi);
+    // DRDY returns high with the first SCLK of a data read
+    drdyLow = false;
+    byte miso = (outPosition < outLength) ? out[outPosition++] : 0x00;
+
+    switch (state) {
+        case RREG_COUNT:
+            regCount = (_mosi & 0x1F) + 1;
+            outLength = 0;
+            outPosition = 0;
+            for (byte i = 0; i < regCount; i++) {
+                out[outLength++] = regs[(regAddress + i) & 0x1F];
+            }
+            state = IDLE;
+            break;
+        case WREG_COUNT:
+            regCount = (_mosi & 0x1F) + 1;
+            state = WREG_DATA;
+            break;
+        case WREG_DATA:
+            // ID and electrode status are read-only
+            if (regAddress != ADS129X_REG_ID &&
+                regAddress != ADS129X_REG_LOFF_STATP &&
+                regAddress != ADS129X_REG_LOFF_STATN &&
+                regAddress <= ADS129X_REG_WCT2) {
+                regs[regAddress] = _mosi;
+            }
+            regAddress++;
+            if (--regCount == 0) {
+                state = IDLE;
+            }
+            break;
+        default:
+            command(_mosi);
+            break;
+    }
+    return miso;
+}
+
+/**
+ * Decodes an opcode (Datasheet, pg. 35).
+ */
+void ADS129X_Sim::command(byte _opcode) {
+    if ((_opcode & 0xE0) == ADS129X_CMD_RREG || (_opcode & 0xE0) == ADS129X_CMD_WREG) {
+        // register commands are ignored in RDATAC mode (Datasheet, pg. 38)
+        if (readContinuous) return;
+        regAddress = _opcode & 0x1F;
+        state = ((_opcode & 0xE0) == ADS129X_CMD_RREG) ? RREG_COUNT : WREG_COUNT;
+        return;
+    }
+    switch (_opcode) {
+        case ADS129X_CMD_WAKEUP:
+            if (standby) activeSince = now;
+            standby = false;
+            break;
+        case ADS129X_CMD_STANDBY:
+            if (!standby) activeTime += now - activeSince;
+            standby = true;
+            break;
+        case ADS129X_CMD_RESET:
+            resetRegisters();
+            readContinuous = true;
+            if (converting) startConversions();
+            break;
+        case ADS129X_CMD_START:
+            startConversions();
+            break;
+        case ADS129X_CMD_STOP:
+            converting = startPin;
+            if (!converting) nextConversion = UINT64_MAX;
+            break;
+        case ADS129X_CMD_RDATAC:
+            readContinuous = true;
+            break;
+        case ADS129X_CMD_SDATAC:
+            readContinuous = false;
+            break;
+        case ADS129X_CMD_RDATA:
+            outLength = loadFrame(out, sizeof(out));
+            outPosition = 0;
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * Bus side: START pin changed.
+ */
+void ADS129X_Sim::setStartPin(boolean _high) {
+    if (daisyIn != NULL) daisyIn->setStartPin(_high);
+    if (_high && !startPin) {
+        startConversions();
+    } else if (!_high && startPin) {
+        converting = false;
+        nextConversion = UINT64_MAX;
+    }
+    startPin = _high;
+}
+
+/**
+ * Bus side: level of the DRDY pin.
+ */
+int ADS129X_Sim::drdy() {
+    return drdyLow ? LOW : HIGH;
+}
+
+/**
+ * Time of the next DRDY edge in ns, UINT64_MAX if conversions are stopped.
+ */
+uint64_t ADS129X_Sim::nextEvent() {
+    if (!converting || standby) return UINT64_MAX;
+    // DRDY is pulled high 4 tCLK before new data if it was not read
+    uint64_t high = nextConversion - clockPeriods(4);
+    if (drdyLow && high > now) return high;
+    return nextConversion;
+}
+
+/**
+ * Advances the model to time _now (ns).
+ */
+void ADS129X_Sim::update(uint64_t _now) {
+    if (daisyIn != NULL) daisyIn->update(_now);
+    if (_now > now) now = _now;
+    if (!converting || standby) return;
+    while (now >= nextConversion) {
+        if (replay != NULL) {
+            convertReplay();
+        } else {
+            convert();
+        }
+        nextConversion = followingConversion();
+        if (regs[ADS129X_REG_CONFIG4] & (1<<ADS129X_BIT_SINGLE_SHOT)) {
+            // single-shot mode: one conversion per START
+            converting = false;
+            nextConversion = UINT64_MAX;
+        }
+    }
+    if (drdyLow && now >= nextConversion - clockPeriods(4)) {
+        drdyLow = false;
+    }
+}
+
+/**
+ * Returns whether DRDY went low since the last call.
+ */
+boolean ADS129X_Sim::takeFallingEdge() {
+    boolean edge = fallingEdge;
+    fallingEdge = false;
+    return edge;
+}
+
+/**
+ * Gaussian-ish noise from a deterministic xorshift generator.
+ */
+double ADS129X_Sim::noise(double _rms) {
+    double sum = 0;
+    for (byte i = 0; i < 4; i++) {
+        noiseState ^= noiseState << 13;
+        noiseState ^= noiseState >> 17;
+        noiseState ^= noiseState << 5;
+        sum += (noiseState / 4294967296.0) - 0.5;
+    }
+    // four uniforms in [-0.5, 0.5) have a standard deviation of 0.577
+    return sum * _rms / 0.577;
+}
+
+/**
+ * Differential input voltage of a channel for its MUX setting.
+ * @param _channel channel (0-7)
+ * @param _t       time in s
+ */
+double ADS129X_Sim::channelVoltage(byte _channel, double _t) {
+    byte chset = regs[ADS129X_REG_CH1SET + _channel];
+    double vref = (regs[ADS129X_REG_CONFIG3] & (1<<ADS129X_BIT_VREF_4V)) ? 4.0 : 2.4;
+    switch (chset & 0x07) {
+        case ADS129X_MUX_NORMAL:
+            // EMG-like test input: slow carrier, mains pickup and noise
+            return 500e-6 * sin(2*M_PI*(3 + _channel)*_t)
+                 + 50e-6 * sin(2*M_PI*50*_t)
+                 + noise(20e-6);
+        case ADS129X_MUX_SHORT:
+            return 5e-6 + noise(1e-6);
+        case ADS129X_MUX_MVDD:
+            return 1.5;
+        case ADS129X_MUX_TEMP:
+            return 145.3e-3;
+        case ADS129X_MUX_TEST: {
+            byte config2 = regs[ADS129X_REG_CONFIG2];
+            if (!(config2 & (1<<ADS129X_BIT_INT_TEST))) return 0;
+            double amplitude = ((config2 & (1<<ADS129X_BIT_TEST_AMP)) ? 2 : 1) * vref / 2.4 * 1e-3;
+            switch (config2 & 0x03) {
+                case ADS129X_TEST_FREQ_1HZ:
+                    return (fmod(_t * fCLK / 2097152.0, 1.0) < 0.5) ? amplitude : -amplitude;
+                case ADS129X_TEST_FREQ_2HZ:
+                    return (fmod(_t * fCLK / 1048576.0, 1.0) < 0.5) ? amplitude : -amplitude;
+                case ADS129X_TEST_FREQ_DC:
+                    return amplitude;
+                default:
+                    return 0;
+            }
+        }
+        default:
+            // RLD measurement and drive settings
+            return noise(5e-6);
+    }
+}
+
+/**
+ * Runs one conversion and pulls DRDY low.
+ */
+void ADS129X_Sim::convert() {
+    double t = nextConversion * 1e-9;
+    double vref = (regs[ADS129X_REG_CONFIG3] & (1<<ADS129X_BIT_VREF_4V)) ? 4.0 : 2.4;
+    unsigned long status = 0xC00000UL | ((unsigned long) statP << 12) |
+                           ((unsigned long) statN << 4) | (regs[ADS129X_REG_GPIO] >> 4);
+    frame[0] = status >> 16;
+    frame[1] = status >> 8;
+    frame[2] = status;
+    for (byte i = 0; i < channels; i++) {
+        byte chset = regs[ADS129X_REG_CH1SET + i];
+        long code = 0;
+        if (!(chset & (1<<ADS129X_BIT_PD))) {
+            double gain = ADS129X_SIM_GAIN[(chset >> 4) & 0x07];
+            double value = channelVoltage(i, t) * gain / vref * 8388607.0;
+            if (value > 8388607.0) value = 8388607.0;
+            if (value < -8388608.0) value = -8388608.0;
+            code = lround(value);
+        }
+        samples[i] = code;
+        frame[3 + 3*i] = code >> 16;
+        frame[4 + 3*i] = code >> 8;
+        frame[5 + 3*i] = code;
+    }
+    if (capture != NULL) {
+        capture->write(nextConversion, frame);
+    }
+    conversions++;
+    drdyLow = true;
+    fallingEdge = true;
+}
+
+/**
+ * Presents the next recorded frame and pulls DRDY low.
+ */
+void ADS129X_Sim::convertReplay() {
+    byte length = replay->getFrameBytes();
+    memcpy(frame, replayFrame, length);
+    for (byte i = 0; i < 8; i++) {
+        const byte *word = frame + 3 + 3*i;
+        samples[i] = (3 + 3*i < length) ?
+            ((((long) word[0] << 16) | ((long) word[1] << 8) | word[2]) ^ 0x800000L) - 0x800000L : 0;
+    }
+    if (capture != NULL) {
+        capture->write(nextConversion, frame);
+    }
+    replayValid = replay->next(&replayTime, replayFrame);
+    conversions++;
+    drdyLow = true;
+    fallingEdge = true;
+}
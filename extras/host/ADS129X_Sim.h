@@ -0,0 +1,129 @@
+/**
+ * ADS129X_Sim.h
+ *
+ * Cycle-approximate model of an ADS129x for host builds. It implements the
+ * register map, the SPI command set including RDATAC/SDATAC, DRDY timing
+ * at the data rate programmed in CONFIG1 and synthetic signals for each
+ * channel MUX setting. Together with ADS129X_HAL_host.cpp it lets the
+ * unmodified library run on Linux against virtual time.
+ */
+
+#ifndef ____ADS129X_SIM__
+#define ____ADS129X_SIM__
+
+#include <stdint.h>
+#include "ADS129X.h"
+#include "ADS129X_Capture.h"
+
+class ADS129X_Sim {
+    public:
+        ADS129X_Sim(byte _id = ADS129X_ID_ADS1298, double _fCLK = 2048000.0);
+
+        // Connects the model to the host HAL pins.
+        void attach(int _CS, int _DRDY, int _START = -1);
+        // Output of _next is shifted through DAISY_IN after our own data.
+        void setDaisyIn(ADS129X_Sim *_next);
+        // Electrode status reported in LOFF_STATP/LOFF_STATN.
+        void setLeadOff(byte _statP, byte _statN);
+        // Fastest SCLK the board can read reliably, 0 for no limit. Above it
+        // DOUT is sampled one bit late.
+        void setMaxSpiClock(unsigned long _clock);
+        unsigned long getMaxSpiClock();
+        // Plays back recorded frames at their recorded times instead of
+        // synthetic conversions. The first frame follows START after the
+        // settling time; after the last one DRDY stays high.
+        void setReplay(ADS129X_CaptureReader *_replay);
+        boolean isReplayDone();
+        // Writes every conversion of this device (not the chain) to _capture,
+        // which must be opened with getFrameBytes().
+        void setCapture(ADS129X_CaptureWriter *_capture);
+
+        byte getRegister(byte _address);
+        byte getChannels();
+        boolean isReadContinuous();
+        boolean isConverting();
+        // Time spent outside standby in ns, for checking duty cycles
+        uint64_t getActiveTime();
+        double getDataRate();
+        unsigned long getConversions();
+        byte getFrameBytes();
+        // Sample of the last conversion, sign-extended
+        long getSample(byte _channel);
+
+        // Bus side, driven by the host HAL
+        void select(boolean _selected);
+        byte transfer(byte _mosi);
+        void setStartPin(boolean _high);
+        int drdy();
+        void update(uint64_t _now);
+        uint64_t nextEvent();
+        boolean takeFallingEdge();
+
+    private:
+        enum State { IDLE, RREG_COUNT, WREG_COUNT, WREG_DATA };
+
+        byte regs[ADS129X_REG_WCT2 + 1];
+        byte id, channels;
+        double fCLK;
+        unsigned long maxSpiClock;
+        uint64_t now;
+        uint64_t activeTime, activeSince;
+
+        // command decoder
+        State state;
+        byte regAddress, regCount;
+        boolean selected, readContinuous, converting, standby, startPin;
+
+        // output shift register, long enough for a chain of 8 devices
+        byte out[8 * 27];
+        byte outLength, outPosition;
+
+        // conversion timing
+        uint64_t nextConversion;
+        boolean drdyLow, fallingEdge;
+        unsigned long conversions;
+        byte frame[8 * 27];
+        long samples[8];
+        byte statP, statN;
+        ADS129X_Sim *daisyIn;
+        uint32_t noiseState;
+
+        // record and replay
+        ADS129X_CaptureReader *replay;
+        ADS129X_CaptureWriter *capture;
+        byte replayFrame[ADS129X_CAPTURE_FRAME];
+        uint64_t replayTime;
+        int64_t replayOffset;
+        boolean replayValid;
+
+        void resetRegisters();
+        void startConversions();
+        void convert();
+        void convertReplay();
+        uint64_t followingConversion();
+        double channelVoltage(byte _channel, double _t);
+        double noise(double _rms);
+        uint64_t clockPeriods(double _periods);
+        uint64_t conversionPeriod();
+        uint64_t settlingTime();
+        byte frameBytes();
+        byte loadFrame(byte *_buffer, byte _space);
+        void command(byte _opcode);
+};
+
+/**
+ * Host side of the HAL: registers simulated devices on pins and controls
+ * virtual time.
+ */
+class ADS129X_Host {
+    public:
+        static void attach(ADS129X_Sim *_sim, int _CS, int _DRDY, int _START);
+        static void advance(uint64_t _ns);
+        static uint64_t now();
+        static unsigned long getSpiClock();
+        // Paces virtual time against the wall clock, e.g. to replay a
+        // capture in real time.
+        static void setRealTime(boolean _realTime);
+};
+
+#endif
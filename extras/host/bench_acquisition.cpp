@@ -0,0 +1,176 @@
+/**
+ * bench_acquisition.cpp
+ *
+ * Streams from a simulated ADS1298 through the unmodified library and
+ * reports host CPU time per frame. Channel 1 is fed the internal test
+ * signal and checked against the model, and its positive electrode is off
+ * for the middle third of the run, watched by ADS129X_Monitor. So the run
+ * also acts as a regression check of the acquisition path: it exits
+ * non-zero if frames were lost or corrupted or lead-off was missed.
+ *
+ * The simulated master clock can be detuned to check the sample-rate
+ * estimate. With an SPI limit the board only reads reliably up to that
+ * clock, and the SPI clocks are calibrated before streaming; the register
+ * configuration read back afterwards has to match the one before.
+ *
+ * Frames are consumed one at a time with getData, in batches with
+ * getFrames, or in place with peek/release.
+ *
+ * usage: bench_acquisition [seconds] [DR (0-6)] [loop period in us] [clock error in ppm]
+ *                          [SPI limit in MHz] [consumer: 0 getData, 1 getFrames, 2 peek]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "ADS129X.h"
+#include "ADS129X_Monitor.h"
+#include "ADS129X_Sequencer.h"
+#include "ADS129X_Sim.h"
+
+static const int ADS_DRDY = 5;
+static const int ADS_CS = 10;
+
+static double hostSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv) {
+    double seconds = (argc > 1) ? atof(argv[1]) : 10.0;
+    byte dr = (argc > 2) ? atoi(argv[2]) & 0x07 : 2;
+    unsigned int loopPeriod = (argc > 3) ? atoi(argv[3]) : 100;
+    double clockError = (argc > 4) ? atof(argv[4]) : 0.0;
+    double spiLimit = (argc > 5) ? atof(argv[5]) : 0.0;
+    int consumer = (argc > 6) ? atoi(argv[6]) : 0;
+
+    ADS129X_Sim sim(ADS129X_ID_ADS1298, ADS129X_FCLK * (1 + clockError * 1e-6));
+    sim.attach(ADS_CS, ADS_DRDY);
+    sim.setMaxSpiClock(spiLimit * 1e6);
+    ADS129X ADS(ADS_DRDY, ADS_CS);
+    ADS129X_Sequencer sequencer(&ADS);
+
+    ADS.setRegister(ADS129X_REG_CONFIG1, (1<<ADS129X_BIT_HR) | dr);
+    ADS.setRegister(ADS129X_REG_CONFIG2, (1<<6) | (1<<ADS129X_BIT_INT_TEST) | ADS129X_TEST_FREQ_2HZ);
+    ADS.setRegister(ADS129X_REG_CONFIG3, (1<<ADS129X_BIT_PD_REFBUF) | (1<<6));
+    ADS.setChannel(1, false, ADS129X_GAIN_1X, ADS129X_MUX_TEST);
+    for (int i = 2; i <= 8; i++) {
+        ADS.setChannel(i, false, ADS129X_GAIN_12X, ADS129X_MUX_NORMAL);
+    }
+    sequencer.begin();
+    while (!sequencer.poll()) {
+        ADS129X_HAL::delayMicroseconds(loopPeriod);
+    }
+    long buffer[ADS129X_FRAME_WORDS];
+    unsigned long calibrationErrors = 0;
+    if (spiLimit > 0) {
+        ADS.STOP();
+        ADS.SDATAC();
+        while (ADS.getData(buffer)) ; // drop frames read before STOP
+        byte before[ADS129X_NUM_REGISTERS], after[ADS129X_NUM_REGISTERS];
+        ADS.RREG(ADS129X_REG_ID, ADS129X_NUM_REGISTERS, before);
+        unsigned long clock = ADS.calibrateSpiClock();
+        printf("SPI calibration:  %s, register %lu Hz, data %lu Hz\n", clock ? "ok" : "failed",
+               ADS.getRegisterClock(), ADS.getDataClock());
+        // the device configuration is restored; electrode status may change
+        ADS.RREG(ADS129X_REG_ID, ADS129X_NUM_REGISTERS, after);
+        for (byte i = 0; i < ADS129X_NUM_REGISTERS; i++) {
+            if (i != ADS129X_REG_LOFF_STATP && i != ADS129X_REG_LOFF_STATN && after[i] != before[i]) {
+                printf("SPI calibration:  register 0x%02X not restored\n", i);
+                calibrationErrors++;
+            }
+        }
+        ADS.RDATAC();
+        ADS.START();
+    }
+
+    // full-scale code of the 1x test signal at 2.4 V reference
+    const long testCode = 1e-3 / 2.4 * 8388607.0 + 0.5;
+    unsigned long frames = 0, gaps = 0, errors = 0;
+    unsigned long sequence, lastSequence = 0;
+    unsigned long begin = ADS129X_HAL::micros();
+    unsigned long end = begin + (unsigned long) (seconds * 1e6);
+
+    ADS129X_Monitor monitor;
+    ADS129X_Event event;
+    unsigned long leadOffEvents = 0;
+    unsigned long leadOff = begin + (end - begin) / 3, leadOn = begin + 2 * (end - begin) / 3;
+
+    auto check = [&](const long *_frame, unsigned long _sequence) {
+        if (frames > 0 && _sequence != lastSequence + 1) gaps++;
+        if ((_frame[0] & 0xF00000) != 0xC00000) errors++;
+        if (_frame[1] != testCode && _frame[1] != -testCode) errors++;
+        monitor.process(_frame, _sequence);
+        lastSequence = _sequence;
+        frames++;
+    };
+
+    double start = hostSeconds();
+    while (ADS129X_HAL::micros() < end) {
+        ADS129X_HAL::delayMicroseconds(loopPeriod);
+        sim.setLeadOff((ADS129X_HAL::micros() >= leadOff && ADS129X_HAL::micros() < leadOn) ? 0x01 : 0x00, 0x00);
+        if (consumer == 1) {
+            long batch[ADS129X_BUFFER_SIZE * ADS129X_FRAME_WORDS];
+            unsigned long sequences[ADS129X_BUFFER_SIZE];
+            byte count;
+            while ((count = ADS.getFrames(batch, ADS129X_BUFFER_SIZE, sequences)) > 0) {
+                for (byte i = 0; i < count; i++) {
+                    check(batch + i * ADS.getFrameWords(), sequences[i]);
+                }
+            }
+        } else if (consumer == 2) {
+            const long *borrowed;
+            const unsigned long *sequences;
+            byte count;
+            while ((count = ADS.peek(&borrowed, &sequences)) > 0) {
+                for (byte i = 0; i < count; i++) {
+                    check(borrowed + i * ADS129X_FRAME_WORDS, sequences[i]);
+                }
+                ADS.release(count);
+            }
+        } else {
+            while (ADS.getData(buffer, &sequence)) {
+                check(buffer, sequence);
+            }
+        }
+        while (monitor.getEvent(&event)) {
+            // P1 goes off, then on again
+            boolean expected = event.source == ADS129X_EVENT_P && event.channel == 1 &&
+                               event.active == (leadOffEvents == 0);
+            if (!expected) errors++;
+            leadOffEvents++;
+        }
+    }
+    if (leadOffEvents != 2) errors++;
+    double elapsed = hostSeconds() - start;
+    ADS.STOP();
+
+    printf("startup time:     %lu us\n", sequencer.getStartupTime());
+    printf("data rate:        %.0f SPS\n", sim.getDataRate());
+    printf("estimated rate:   %.3f SPS (nominal %.0f, %+.1f ppm)\n", ADS.getSampleRate(),
+           ADS.getNominalSampleRate(), ADS.getClockError());
+    printf("latency:          %lu us (max %lu us)\n", ADS.getLatency(), ADS.getMaxLatency());
+    printf("virtual time:     %.3f s\n", (ADS129X_HAL::micros() - begin) * 1e-6);
+    printf("conversions:      %lu\n", sim.getConversions());
+    printf("frames received:  %lu\n", frames);
+    printf("overruns:         %lu\n", ADS.getOverruns());
+    printf("sequence gaps:    %lu\n", gaps);
+    printf("lead-off events:  %lu\n", leadOffEvents);
+    printf("corrupt frames:   %lu\n", errors);
+    printf("host time:        %.3f s (%.1f ns/frame)\n", elapsed, frames ? elapsed * 1e9 / frames : 0.0);
+#ifdef ADS129X_STATS
+    ADS129X_Stats stats;
+    ADS.getStats(&stats);
+    printf("interrupts:       %lu\n", stats.interrupts);
+    printf("SPI bytes:        %lu\n", stats.spiBytes);
+    printf("polling misses:   %lu\n", stats.pollingMisses);
+    printf("bucket (us)       ISR time   latency\n");
+    for (byte i = 0; i < ADS129X_STATS_BUCKETS; i++) {
+        if (stats.isrTime[i] == 0 && stats.latency[i] == 0) continue;
+        printf("< %-14lu %9lu %9lu\n", 1UL << i, stats.isrTime[i], stats.latency[i]);
+    }
+    printf("max               %9lu %9lu\n", stats.maxIsrTime, stats.maxLatency);
+#endif
+    return (gaps || errors || calibrationErrors || ADS.getOverruns() || frames == 0) ? 1 : 0;
+}
@@ -0,0 +1,127 @@
+/**
+ * bench_arbiter.cpp
+ *
+ * Shares the simulated SPI bus between an ADS1298 and a busy radio that
+ * always has a transaction of random length queued. The same workload runs
+ * twice: first the radio gets the bus whenever the loop comes round, as in
+ * the old BTLE_EMG sketch, then only when ADS129X_Arbiter grants it. Frames
+ * lost are counted against the conversions of the model. Exits non-zero if
+ * the arbiter lost frames although no transaction was longer than a sample
+ * period, or did not notice lost frames.
+ *
+ * Build with make POLLING=1 for the shared-bus case the arbiter is meant
+ * for; in interrupt mode long transactions delay the DRDY interrupt.
+ *
+ * usage: bench_arbiter [seconds] [DR (0-6)] [longest transaction in us] [loop period in us]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "ADS129X.h"
+#include "ADS129X_Arbiter.h"
+#include "ADS129X_Sim.h"
+
+static const int ADS_DRDY = 5;
+static const int ADS_CS = 10;
+static const unsigned long RADIO_CLOCK = 2000000;
+static const unsigned int SHORTEST = 50;
+
+struct Result {
+    unsigned long conversions, frames, transactions, busy;
+};
+
+static Result run(ADS129X &_ads, ADS129X_Sim &_sim, ADS129X_Arbiter *_arbiter,
+                  double _seconds, unsigned int _longest, unsigned int _loopPeriod) {
+    srand(1);
+    Result result = { 0, 0, 0, 0 };
+    long buffer[ADS129X_FRAME_WORDS];
+    unsigned int pending = SHORTEST + rand() % (_longest - SHORTEST + 1);
+
+    _ads.START();
+    // wait for the first frame, so both runs start in phase
+    while (!_ads.getData(buffer)) {
+        ADS129X_HAL::delayMicroseconds(_loopPeriod);
+    }
+    unsigned long start = _sim.getConversions();
+    if (_arbiter != NULL) _arbiter->begin();
+    unsigned long end = ADS129X_HAL::micros() + (unsigned long) (_seconds * 1e6);
+    while (ADS129X_HAL::micros() < end) {
+        ADS129X_HAL::delayMicroseconds(_loopPeriod);
+        if (_arbiter != NULL) _arbiter->poll();
+        while (_ads.getData(buffer)) {
+            result.frames++;
+        }
+        if (_arbiter != NULL && !_arbiter->request(pending)) {
+            continue;
+        }
+        ADS129X_HAL::spiBeginTransaction(RADIO_CLOCK);
+        ADS129X_HAL::delayMicroseconds(pending);
+        ADS129X_HAL::spiEndTransaction();
+        if (_arbiter != NULL) _arbiter->release();
+        result.transactions++;
+        result.busy += pending;
+        pending = SHORTEST + rand() % (_longest - SHORTEST + 1);
+    }
+    // the last conversion may still be waiting
+    ADS129X_HAL::delayMicroseconds(_loopPeriod);
+    while (_ads.getData(buffer)) {
+        result.frames++;
+    }
+    result.conversions = _sim.getConversions() - start;
+    _ads.STOP();
+    if (_arbiter != NULL) _arbiter->end();
+    while (_ads.getData(buffer)) ;
+    return result;
+}
+
+static void print(const char *_name, const Result &_result, double _seconds) {
+    long lost = (long) _result.conversions - (long) _result.frames;
+    printf("%-10s %10lu %10lu %8ld %12lu %8.1f\n", _name, _result.conversions, _result.frames, lost,
+           _result.transactions, _result.busy * 1e-4 / _seconds);
+}
+
+int main(int argc, char **argv) {
+    double seconds = (argc > 1) ? atof(argv[1]) : 10.0;
+    byte dr = (argc > 2) ? atoi(argv[2]) & 0x07 : 5;
+    unsigned int longest = (argc > 3) ? atoi(argv[3]) : 1500;
+    unsigned int loopPeriod = (argc > 4) ? atoi(argv[4]) : 20;
+    if (longest < SHORTEST) longest = SHORTEST;
+
+    ADS129X_Sim sim(ADS129X_ID_ADS1298);
+    sim.attach(ADS_CS, ADS_DRDY);
+    ADS129X ADS(ADS_DRDY, ADS_CS);
+    ADS129X_Arbiter arbiter(&ADS);
+
+    ADS.SDATAC();
+    ADS.setRegister(ADS129X_REG_CONFIG1, (1<<ADS129X_BIT_HR) | dr);
+    ADS.setRegister(ADS129X_REG_CONFIG3, (1<<ADS129X_BIT_PD_REFBUF) | (1<<6));
+    ADS.commit();
+    ADS.RDATAC();
+
+    Result naive = run(ADS, sim, NULL, seconds, longest, loopPeriod);
+    Result arbitrated = run(ADS, sim, &arbiter, seconds, longest, loopPeriod);
+    long lost = (long) arbitrated.conversions - (long) arbitrated.frames;
+    unsigned long errors = 0;
+    // transactions up to a period long can always be scheduled
+    if (lost != 0 && longest <= 1e6 / sim.getDataRate()) errors++;
+    // a miss at the very end is not followed by a frame that reveals it
+    if (labs(lost - (long) arbiter.getMissed()) > 2) errors++;
+
+#ifdef ADS129X_POLLING
+    printf("mode:              polling\n");
+#else
+    printf("mode:              interrupt\n");
+#endif
+    printf("data rate:         %.0f SPS\n", sim.getDataRate());
+    printf("transactions:      %u-%u us\n", SHORTEST, longest);
+    printf("%-10s %10s %10s %8s %12s %8s\n", "bus", "converted", "read", "lost", "transactions", "busy %");
+    print("first come", naive, seconds);
+    print("arbiter", arbitrated, seconds);
+    printf("granted:           %lu\n", arbiter.getGrants());
+    printf("deferred:          %lu\n", arbiter.getDeferrals());
+    printf("missed (seen):     %lu\n", arbiter.getMissed());
+    printf("worst slack:       %ld us\n", arbiter.getWorstSlack());
+    printf("longest granted:   %lu us\n", arbiter.getLongestTransaction());
+    printf("errors:            %lu\n", errors);
+    return errors ? 1 : 0;
+}
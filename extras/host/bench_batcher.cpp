@@ -0,0 +1,161 @@
+/**
+ * bench_batcher.cpp
+ *
+ * Checks ADS129X_Batcher end to end: frames with random data and random
+ * gaps in their sequence numbers go through add and poll, every packet is
+ * taken apart with unpack and each frame is compared with what was added.
+ * Covers the nRF8001 MTU (20 bytes) and BLE 4.2 (244 bytes), with and
+ * without the status word. Without a deadline only full packets and packets
+ * cut short by a gap may be sent; with one, poll in virtual time has to send
+ * every frame within the deadline plus one frame period. Reports payload
+ * efficiency and host time per frame. Exits non-zero on a mismatch.
+ *
+ * usage: bench_batcher [frames]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <vector>
+#include "ADS129X_Batcher.h"
+
+static const byte CHANNELS = 8;
+static const byte WORDS = 1 + CHANNELS;
+static const unsigned long PERIOD_US = 500; // 2 kSPS
+
+static double hostSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+struct Setup {
+    byte mtu, channels;
+    boolean status;
+    unsigned long deadline;
+};
+
+struct Sent {
+    unsigned long sequence, time;
+    long words[WORDS];
+};
+
+/**
+ * Receiving side: unpacks packets and compares them with the frames added.
+ */
+struct Receiver {
+    const Setup &setup;
+    const std::vector<Sent> &sent;
+    byte framesPerPacket;
+    size_t next;
+    unsigned long packets, bytes, errors;
+
+    Receiver(const Setup &_setup, const std::vector<Sent> &_sent, byte _framesPerPacket)
+        : setup(_setup), sent(_sent), framesPerPacket(_framesPerPacket), next(0), packets(0), bytes(0), errors(0) {
+    }
+
+    void receive(const byte *_packet, byte _length, boolean _final) {
+        long frames[ADS129X_BATCH_MTU * WORDS];
+        uint16_t counter;
+        packets++;
+        bytes += _length;
+        byte n = ADS129X_Batcher::unpack(_packet, _length, setup.channels, setup.status, frames, &counter);
+        if (_length > setup.mtu || n == 0 || n > framesPerPacket || next + n > sent.size()) {
+            errors++;
+            return;
+        }
+        if (counter != (uint16_t) sent[next].sequence) errors++;
+        for (byte f = 0; f < n; f++) {
+            const Sent &frame = sent[next + f];
+            // a packet only holds consecutive frames
+            if (f > 0 && frame.sequence != sent[next + f - 1].sequence + 1) errors++;
+            if (frames[f * (1 + setup.channels)] != (setup.status ? frame.words[0] : 0)) errors++;
+            for (byte c = 1; c <= setup.channels; c++) {
+                if (frames[f * (1 + setup.channels) + c] != frame.words[c]) errors++;
+            }
+        }
+        // short packets are only sent before a gap, by the deadline or at
+        // the end; no frame waits longer than the deadline and one poll
+        boolean gap = next + n < sent.size() && sent[next + n].sequence != sent[next + n - 1].sequence + 1;
+        if (n < framesPerPacket && !gap && !_final && setup.deadline == 0) errors++;
+        if (setup.deadline > 0 && ADS129X_HAL::micros() - sent[next].time > setup.deadline + PERIOD_US) errors++;
+        next += n;
+    }
+};
+
+static std::vector<Sent> makeFrames(unsigned long _count) {
+    std::vector<Sent> sent(_count);
+    unsigned long sequence = 65530; // the 16-bit counter wraps early on
+    for (unsigned long f = 0; f < _count; f++) {
+        if (rand() % 50 == 0) {
+            sequence += 1 + rand() % 3; // frames lost to overruns
+        }
+        sent[f].sequence = sequence++;
+        sent[f].words[0] = 0xC00000L | (rand() & 0xFFFFF);
+        for (byte c = 1; c <= CHANNELS; c++) {
+            long value = (long) (((uint32_t) rand() << 8) ^ (uint32_t) rand()) & 0xFFFFFF;
+            sent[f].words[c] = (value ^ 0x800000L) - 0x800000L;
+        }
+    }
+    return sent;
+}
+
+int main(int argc, char **argv) {
+    unsigned long count = (argc > 1) ? strtoul(argv[1], NULL, 0) : 100000;
+    if (count < 1) count = 1;
+    unsigned long errors = 0;
+
+    const Setup setups[] = {
+        { 20, 1, false, 0 },
+        { 20, 1, false, 2000 },
+        { 20, 2, true, 1200 },
+        { 20, 8, false, 0 },  // a frame does not fit
+        { 244, 8, true, 0 },
+        { 244, 8, true, 3000 },
+        { 244, 3, false, 2000 },
+    };
+    std::vector<Sent> sent = makeFrames(count);
+    byte packet[ADS129X_BATCH_MTU];
+
+    printf("%5s %8s %6s %9s %7s %9s %11s %7s\n", "MTU", "channels", "status", "deadline", "frames", "packets",
+           "efficiency", "errors");
+    for (unsigned int s = 0; s < sizeof(setups) / sizeof(setups[0]); s++) {
+        const Setup &setup = setups[s];
+        ADS129X_Batcher batcher(setup.mtu, setup.channels, setup.status);
+        batcher.setDeadline(setup.deadline);
+        byte framesPerPacket = batcher.getFramesPerPacket();
+        Receiver receiver(setup, sent, framesPerPacket);
+
+        for (unsigned long f = 0; f < count; f++) {
+            ADS129X_HAL::delayMicroseconds(PERIOD_US);
+            sent[f].time = ADS129X_HAL::micros();
+            byte length = batcher.add(sent[f].words, sent[f].sequence, packet);
+            if (length > 0) receiver.receive(packet, length, false);
+            length = batcher.poll(packet);
+            if (length > 0) receiver.receive(packet, length, false);
+        }
+        byte length = batcher.flush(packet);
+        if (length > 0) receiver.receive(packet, length, true);
+
+        // every frame arrives, unless none fits the MTU
+        if (receiver.next != (framesPerPacket ? count : 0)) receiver.errors++;
+        byte frameBytes = 3 * (setup.channels + (setup.status ? 1 : 0));
+        double efficiency = receiver.bytes ? (double) receiver.next * frameBytes / receiver.bytes : 0;
+        printf("%5u %8u %6s %6lu us %7u %9lu %10.1f%% %7lu\n", setup.mtu, setup.channels, setup.status ? "yes" : "no",
+               setup.deadline, framesPerPacket, receiver.packets, 100 * efficiency, receiver.errors);
+        errors += receiver.errors;
+    }
+
+    // time for full 8-channel frames into BLE 4.2 packets
+    ADS129X_Batcher batcher(244, CHANNELS, true);
+    unsigned long lengths = 0;
+    double start = hostSeconds();
+    for (unsigned long f = 0; f < count; f++) {
+        lengths += batcher.add(sent[f].words, sent[f].sequence, packet);
+    }
+    double elapsed = hostSeconds() - start;
+    printf("add:          %.1f ns/frame (244 bytes, 8 channels and status, %lu bytes out)\n",
+           elapsed * 1e9 / count, lengths);
+    printf("errors:       %lu\n", errors);
+    return errors ? 1 : 0;
+}
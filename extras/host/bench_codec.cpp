@@ -0,0 +1,203 @@
+/**
+ * bench_codec.cpp
+ *
+ * Compresses frames streamed from a simulated ADS1298 with ADS129X_Encoder,
+ * decodes them again and reports the compression ratio and the host time
+ * and cycles spent per frame. Channels 1-7 carry the simulator's EMG-like
+ * signal, channel 8 is shorted. Every block is also decoded after dropping
+ * each tenth block, to check that a lost block costs only its own frames,
+ * and after encoding with frames missing, as if the acquisition had
+ * dropped them, to check that the receiver counts those as well. Exits
+ * non-zero if decoding is not lossless.
+ *
+ * usage: bench_codec [seconds] [DR (0-6)] [frames per block] [gain code (0-6)]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+#include "ADS129X.h"
+#include "ADS129X_Codec.h"
+#include "ADS129X_Sim.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+static const int ADS_DRDY = 5;
+static const int ADS_CS = 10;
+static const byte CHANNELS = 8;
+
+static double hostSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static unsigned long long cycles() {
+#ifdef HAVE_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+/**
+ * Feeds an encoded block to the decoder and compares decoded frames with
+ * the originals, placed by the block's frame counter.
+ */
+static void feedBlock(ADS129X_BlockDecoder &_decoder, const byte *_block, byte _length,
+                      const std::vector<long> &_frames, unsigned long *_decoded, unsigned long *_mismatches) {
+    for (byte i = 0; i < _length; i++) {
+        if (!_decoder.feed(_block[i])) continue;
+        for (byte f = 0; f < _decoder.getFrames(); f++, (*_decoded)++) {
+            unsigned long index = _decoder.getCounter() + f;
+            if (memcmp(_decoder.getFrame(f), &_frames[index * (1 + CHANNELS)], (1 + CHANNELS) * sizeof(long))) {
+                (*_mismatches)++;
+            }
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    double seconds = (argc > 1) ? atof(argv[1]) : 10.0;
+    byte dr = (argc > 2) ? atoi(argv[2]) & 0x07 : 6;
+    byte framesPerBlock = (argc > 3) ? atoi(argv[3]) : 16;
+    byte gain = (argc > 4) ? atoi(argv[4]) & 0x07 : 6;
+
+    ADS129X_Sim sim(ADS129X_ID_ADS1298);
+    sim.attach(ADS_CS, ADS_DRDY);
+    ADS129X ADS(ADS_DRDY, ADS_CS);
+
+    ADS.SDATAC();
+    ADS.setRegister(ADS129X_REG_CONFIG1, (1<<ADS129X_BIT_HR) | dr);
+    ADS.setRegister(ADS129X_REG_CONFIG3, (1<<ADS129X_BIT_PD_REFBUF) | (1<<6));
+    for (int i = 1; i <= 7; i++) {
+        ADS.setChannel(i, false, gain << ADS129X_BIT_GAIN0, ADS129X_MUX_NORMAL);
+    }
+    ADS.setChannel(8, false, gain << ADS129X_BIT_GAIN0, ADS129X_MUX_SHORT);
+    ADS.commit();
+    ADS.RDATAC();
+    ADS.START();
+
+    // acquire first so that only the codec is timed
+    std::vector<long> frames;
+    long buffer[ADS129X_FRAME_WORDS];
+    unsigned long end = (unsigned long) (seconds * 1e6);
+    while (ADS129X_HAL::micros() < end) {
+        ADS129X_HAL::delayMicroseconds(100);
+        while (ADS.getData(buffer)) {
+            frames.insert(frames.end(), buffer, buffer + 1 + CHANNELS);
+        }
+    }
+    ADS.STOP();
+    unsigned long numFrames = frames.size() / (1 + CHANNELS);
+
+    ADS129X_Encoder encoder(CHANNELS, framesPerBlock);
+    std::vector<byte> stream;
+    std::vector<unsigned long> blockEnds;
+    byte block[ADS129X_BLOCK_SIZE];
+    double encodeTime = 0;
+    unsigned long long encodeCycles = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        // the first pass warms up caches and fills the stream
+        encoder.reset();
+        double start = hostSeconds();
+        unsigned long long startCycles = cycles();
+        for (unsigned long f = 0; f < numFrames; f++) {
+            byte n = encoder.addFrame(&frames[f * (1 + CHANNELS)], f, block);
+            if (pass == 0 && n) {
+                stream.insert(stream.end(), block, block + n);
+                blockEnds.push_back(stream.size());
+            }
+        }
+        byte n = encoder.flush(block);
+        encodeCycles = cycles() - startCycles;
+        encodeTime = hostSeconds() - start;
+        if (pass == 0 && n) {
+            stream.insert(stream.end(), block, block + n);
+            blockEnds.push_back(stream.size());
+        }
+    }
+
+    // lossless check; a leading delimiter syncs the decoder
+    ADS129X_BlockDecoder decoder;
+    decoder.feed(0x00);
+    unsigned long decoded = 0, mismatches = 0;
+    double start = hostSeconds();
+    unsigned long long startCycles = cycles();
+    for (size_t i = 0; i < stream.size(); i++) {
+        if (!decoder.feed(stream[i])) continue;
+        for (byte f = 0; f < decoder.getFrames(); f++, decoded++) {
+            if (memcmp(decoder.getFrame(f), &frames[decoded * (1 + CHANNELS)], (1 + CHANNELS) * sizeof(long))) {
+                mismatches++;
+            }
+        }
+    }
+    unsigned long long decodeCycles = cycles() - startCycles;
+    double decodeTime = hostSeconds() - start;
+
+    // drop every tenth block and check the loss accounting
+    ADS129X_BlockDecoder lossy;
+    lossy.feed(0x00);
+    unsigned long lossyFrames = 0, lossyMismatches = 0, expectedLoss = 0;
+    for (size_t b = 0; b < blockEnds.size(); b++) {
+        size_t first = b ? blockEnds[b - 1] : 0;
+        if (b % 10 == 5 && b + 2 < blockEnds.size()) {
+            // feed half the block to simulate a cut-off transfer; it also
+            // corrupts the next block, and a later one has to show the gap
+            for (size_t i = first; i < (first + blockEnds[b]) / 2; i++) lossy.feed(stream[i]);
+            continue;
+        }
+        for (size_t i = first; i < blockEnds[b]; i++) {
+            if (!lossy.feed(stream[i])) continue;
+            for (byte f = 0; f < lossy.getFrames(); f++, lossyFrames++) {
+                unsigned long index = lossy.getCounter() + f;
+                if (memcmp(lossy.getFrame(f), &frames[index * (1 + CHANNELS)], (1 + CHANNELS) * sizeof(long))) {
+                    lossyMismatches++;
+                }
+            }
+        }
+    }
+    expectedLoss = numFrames - lossyFrames;
+
+    // skip frames before encoding, as acquisition overruns would
+    ADS129X_BlockDecoder gappy;
+    gappy.feed(0x00);
+    unsigned long gappyFrames = 0, gappyMismatches = 0, skipped = 0;
+    encoder.reset();
+    for (unsigned long f = 0; f < numFrames; f++) {
+        if (f % 97 == 50) {
+            skipped++;
+            continue;
+        }
+        byte n = encoder.addFrame(&frames[f * (1 + CHANNELS)], f, block);
+        feedBlock(gappy, block, n, frames, &gappyFrames, &gappyMismatches);
+    }
+    feedBlock(gappy, block, encoder.flush(block), frames, &gappyFrames, &gappyMismatches);
+
+    double rawBytes = numFrames * 3.0 * (1 + CHANNELS);
+    printf("data rate:         %.0f SPS\n", sim.getDataRate());
+    printf("frames:            %lu in %lu blocks\n", numFrames, (unsigned long) blockEnds.size());
+    printf("raw size:          %.0f bytes (%.1f bytes/frame)\n", rawBytes, rawBytes / numFrames);
+    printf("encoded size:      %lu bytes (%.2f bytes/frame, %.0f bytes/s)\n", (unsigned long) stream.size(),
+           (double) stream.size() / numFrames, stream.size() / seconds);
+    printf("compression ratio: %.2f\n", rawBytes / stream.size());
+    printf("encode:            %.1f ns/frame", encodeTime * 1e9 / numFrames);
+#ifdef HAVE_TSC
+    printf(", %.0f cycles/frame", (double) encodeCycles / numFrames);
+#endif
+    printf("\ndecode:            %.1f ns/frame", decodeTime * 1e9 / numFrames);
+#ifdef HAVE_TSC
+    printf(", %.0f cycles/frame", (double) decodeCycles / numFrames);
+#endif
+    printf("\ndecoded frames:    %lu, mismatches: %lu\n", decoded, mismatches);
+    printf("with 10%% blocks lost: %lu frames decoded, %lu lost (counted %lu), %lu errors, %lu mismatches\n",
+           lossyFrames, expectedLoss, lossy.getLostFrames(), lossy.getErrors(), lossyMismatches);
+    printf("with frames skipped: %lu frames decoded, %lu skipped (counted %lu), %lu mismatches\n",
+           gappyFrames, skipped, gappy.getLostFrames(), gappyMismatches);
+    return (decoded != numFrames || mismatches || lossyMismatches || lossy.getLostFrames() != expectedLoss ||
+            gappyMismatches || gappyFrames + skipped != numFrames || gappy.getLostFrames() != skipped) ? 1 : 0;
+}
@@ -0,0 +1,122 @@
+/**
+ * bench_convert.cpp
+ *
+ * Checks ADS129X_Converter against a double-precision reference for every
+ * gain and both internal references, checks that a converter attached to a
+ * device follows its register shadow once values are committed, and
+ * reports the host time per frame for float and fixed-point conversion of
+ * a long recording.
+ * Exits non-zero if a result is off by more than rounding.
+ *
+ * usage: bench_convert [frames]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <vector>
+#include "ADS129X.h"
+#include "ADS129X_Converter.h"
+
+static const byte CHANNELS = 8;
+static const byte WORDS = 1 + CHANNELS;
+static const double PGA_GAIN[7] = { 6, 1, 2, 3, 4, 8, 12 };
+
+static double hostSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * Random frames with a valid status word; the first frame holds full scale.
+ */
+static void fillFrames(long *_frames, unsigned long _count) {
+    for (unsigned long f = 0; f < _count; f++) {
+        long *frame = _frames + f * WORDS;
+        frame[0] = 0xC00000;
+        for (byte c = 1; c <= CHANNELS; c++) {
+            long value = (long) (((uint32_t) rand() << 8) ^ (uint32_t) rand()) & 0xFFFFFF;
+            frame[c] = (value ^ 0x800000L) - 0x800000L;
+        }
+    }
+    _frames[1] = 8388607;
+    _frames[2] = -8388608;
+}
+
+int main(int argc, char **argv) {
+    unsigned long count = (argc > 1) ? strtoul(argv[1], NULL, 0) : 1000000;
+    if (count < 1) count = 1;
+    unsigned long errors = 0;
+
+    std::vector<long> frames(count * WORDS);
+    std::vector<float> volts(count * WORDS);
+    std::vector<long> fixed(count * WORDS);
+    fillFrames(&frames[0], count);
+
+    // accuracy, over the first 10000 frames
+    unsigned long checked = count < 10000 ? count : 10000;
+    double maxFloat = 0, maxFixed = 0;
+    for (byte gain = 0; gain < 7; gain++) {
+        for (byte ref = 0; ref < 2; ref++) {
+            double vref = ref ? 4.0 : 2.4;
+            ADS129X_Converter converter(CHANNELS);
+            converter.setGain(0, gain);
+            converter.setReference(vref);
+            converter.toMicrovolts(&frames[0], checked, &volts[0]);
+            converter.toMicrovolts(&frames[0], checked, &fixed[0]);
+            double lsb = vref * 1e6 / PGA_GAIN[gain] / 8388607.0;
+            for (unsigned long i = 0; i < checked * WORDS; i++) {
+                if (i % WORDS == 0) {
+                    if (volts[i] != frames[i] || fixed[i] != frames[i]) errors++;
+                    continue;
+                }
+                double uV = frames[i] * lsb;
+                double errFloat = fabs(volts[i] - uV) / (fabs(uV) + lsb);
+                double errFixed = fabs(fixed[i] - uV * (1 << ADS129X_CONVERTER_FRACTION));
+                if (errFloat > maxFloat) maxFloat = errFloat;
+                if (errFixed > maxFixed) maxFixed = errFixed;
+                if (errFloat > 1e-6 || errFixed > 1.0) errors++;
+            }
+        }
+    }
+
+    // tracking of the device configuration
+    ADS129X ADS(5, 10);
+    ADS129X_Converter tracking(&ADS, CHANNELS);
+    if (fabs(tracking.getScale(1) - 2.4e6 / 6 / 8388607.0) > 1e-6) errors++;
+    // staged values only apply once they are written
+    ADS.setChannel(1, false, ADS129X_GAIN_12X, ADS129X_MUX_NORMAL);
+    if (fabs(tracking.getScale(1) - 2.4e6 / 6 / 8388607.0) > 1e-6) errors++;
+    ADS.commit();
+    if (fabs(tracking.getScale(1) - 2.4e6 / 12 / 8388607.0) > 1e-6) errors++;
+    ADS.setRegister(ADS129X_REG_CONFIG3, (1<<ADS129X_BIT_VREF_4V) | (1<<6));
+    ADS.setChannel(2, false, ADS129X_GAIN_1X, ADS129X_MUX_NORMAL);
+    if (fabs(tracking.getScale(1) - 2.4e6 / 12 / 8388607.0) > 1e-6) errors++;
+    ADS.commit();
+    if (fabs(tracking.getScale(1) - 4.0e6 / 12 / 8388607.0) > 1e-6) errors++;
+    if (fabs(tracking.getScale(2) - 4.0e6 / 1 / 8388607.0) > 1e-6) errors++;
+    if (fabs(tracking.getScale(3) - 4.0e6 / 6 / 8388607.0) > 1e-6) errors++;
+    // a value written directly is a change as well
+    ADS.WREG(ADS129X_REG_CH1SET + 2, (ADS129X_GAIN_4X << 4) | ADS129X_MUX_NORMAL);
+    if (fabs(tracking.getScale(3) - 4.0e6 / 4 / 8388607.0) > 1e-6) errors++;
+
+    // throughput
+    ADS129X_Converter converter(CHANNELS);
+    converter.setGain(0, ADS129X_GAIN_12X);
+    double start = hostSeconds();
+    converter.toMicrovolts(&frames[0], count, &volts[0]);
+    double floatTime = hostSeconds() - start;
+    start = hostSeconds();
+    converter.toMicrovolts(&frames[0], count, &fixed[0]);
+    double fixedTime = hostSeconds() - start;
+
+    printf("frames:           %lu\n", count);
+    printf("max float error:  %.2g (relative)\n", maxFloat);
+    printf("max fixed error:  %.3f LSB of the output\n", maxFixed);
+    printf("float:            %.2f ns/frame\n", floatTime * 1e9 / count);
+    printf("fixed-point:      %.2f ns/frame\n", fixedTime * 1e9 / count);
+    printf("errors:           %lu\n", errors);
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,117 @@
+/**
+ * bench_duty.cpp
+ *
+ * Runs ADS129X_DutyCycle against a simulated ADS1298 at a few effective
+ * rates, as single-shot conversions at the fastest data rate and as
+ * bursts at slower ones, and compares the achieved rate and duty cycle
+ * with the request and with the time the model spent outside standby. Every frame is read with RDATA and checked
+ * against the last conversion of the model. Exits non-zero if a frame was
+ * lost or corrupted, or a rate the device can keep up with was missed.
+ *
+ * usage: bench_duty [seconds] [START pin: 0 command, 1 pin]
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "ADS129X.h"
+#include "ADS129X_DutyCycle.h"
+#include "ADS129X_Sim.h"
+
+static const int ADS_DRDY = 5;
+static const int ADS_CS = 10;
+static const int ADS_START = 6;
+
+struct Schedule {
+    float rate;
+    byte burst;
+    byte dr;
+    boolean keepsUp; // RDATA readback is faster than the conversions
+};
+
+// the last two ask for more than the settling time and the bus allow
+static const Schedule SCHEDULES[] = {
+    { 1, 1, 0, true }, { 10, 1, 0, true }, { 100, 1, 0, true }, { 100, 10, 4, true },
+    { 50, 25, 6, true }, { 10000, 1, 0, true }, { 500, 10, 0, false }
+};
+
+int main(int argc, char **argv) {
+    double seconds = (argc > 1) ? atof(argv[1]) : 10.0;
+    boolean usePin = (argc > 2) ? atoi(argv[2]) != 0 : false;
+
+    ADS129X_Sim sim(ADS129X_ID_ADS1298);
+    sim.attach(ADS_CS, ADS_DRDY, ADS_START);
+    ADS129X ADS(ADS_DRDY, ADS_CS);
+    ADS129X_DutyCycle duty(&ADS, usePin ? ADS_START : -1);
+
+    ADS.SDATAC();
+    ADS.setRegister(ADS129X_REG_CONFIG2, (1<<6) | (1<<ADS129X_BIT_INT_TEST) | ADS129X_TEST_FREQ_2HZ);
+    ADS.setRegister(ADS129X_REG_CONFIG3, (1<<ADS129X_BIT_PD_REFBUF) | (1<<6));
+    for (int i = 1; i <= 8; i++) {
+        ADS.setChannel(i, false, ADS129X_GAIN_1X, ADS129X_MUX_TEST);
+    }
+    ADS.commit();
+
+    printf("mode:         %s, START %s\n",
+#ifdef ADS129X_POLLING
+           "polling",
+#else
+           "interrupt",
+#endif
+           usePin ? "pin" : "command");
+    printf("%8s %6s %6s %8s %10s %8s %8s %6s %6s %6s\n", "rate", "burst", "SPS", "max", "achieved",
+           "duty %", "model %", "late", "missed", "errors");
+
+    unsigned long errors = 0;
+    long buffer[ADS129X_FRAME_WORDS];
+    for (unsigned int s = 0; s < sizeof(SCHEDULES) / sizeof(SCHEDULES[0]); s++) {
+        const Schedule &schedule = SCHEDULES[s];
+        ADS.setRegister(ADS129X_REG_CONFIG1, (1<<ADS129X_BIT_HR) | schedule.dr);
+        duty.setRate(schedule.rate, schedule.burst);
+        float maxRate = duty.getMaxRate();
+        unsigned long conversions = sim.getConversions();
+        uint64_t active = sim.getActiveTime();
+        uint64_t start = ADS129X_Host::now();
+        unsigned long frames = 0, lastSequence = 0, failed = 0;
+        duty.begin();
+        unsigned long end = ADS129X_HAL::micros() + (unsigned long) (seconds * 1e6);
+        while (ADS129X_HAL::micros() < end) {
+            ADS129X_HAL::delayMicroseconds(20);
+            if (!duty.poll()) {
+                continue;
+            }
+            unsigned long sequence;
+            duty.getData(buffer, &sequence);
+            frames++;
+            if (sequence != lastSequence + 1) failed++;
+            lastSequence = sequence;
+            if ((buffer[0] & 0xF00000L) != 0xC00000L) failed++;
+            for (byte i = 0; i < 8; i++) {
+                if (buffer[1 + i] != sim.getSample(i)) failed++;
+            }
+        }
+        duty.end();
+        double elapsed = (ADS129X_Host::now() - start) * 1e-9;
+        double modelDuty = (sim.getActiveTime() - active) * 1e-9 / elapsed;
+        conversions = sim.getConversions() - conversions;
+        if (duty.getOverruns() || duty.getTimeouts()) failed++;
+        if (schedule.keepsUp) {
+            // every conversion was read, none twice
+            if (conversions != frames || duty.getMissed()) failed++;
+        } else {
+            // misses are seen; more conversions run until STOP gets through
+            if (duty.getMissed() == 0 || frames + duty.getMissed() > conversions) failed++;
+        }
+        if (schedule.rate < 0.9f * maxRate) {
+            if (duty.getLate() || fabs(duty.getAchievedRate() / schedule.rate - 1) > 0.01) failed++;
+        }
+        // the library sees the same awake time up to the command overhead
+        if (fabs(duty.getDutyCycle() - modelDuty) > 0.01) failed++;
+        printf("%8.0f %6u %6.0f %8.0f %10.2f %8.2f %8.2f %6lu %6lu %6lu\n", schedule.rate, schedule.burst,
+               ADS.getNominalSampleRate(), maxRate, duty.getAchievedRate(), duty.getDutyCycle() * 100,
+               modelDuty * 100, duty.getLate(), duty.getMissed(), failed);
+        errors += failed;
+    }
+    printf("errors:       %lu\n", errors);
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,201 @@
+/**
+ * bench_features.cpp
+ *
+ * Feeds ADS129X_Features with synthetic 8-channel signals (sines on FFT
+ * bins, a two-tone mix, noise and silence) and checks every feature vector
+ * against a brute-force recomputation over the same window: RMS, zero
+ * crossings and slope sign changes exactly, mean and median frequency of
+ * the sines to within half a bin, and band powers of the periodic
+ * signals adding up to the mean square. Reports host time per frame for the sliding-window features, with
+ * the spectrum stage and for recomputing the window every hop, and the
+ * link bandwidth of feature vectors against raw frames. Exits non-zero on
+ * a mismatch.
+ *
+ * usage: bench_features [seconds] [window (power of two)] [hop]
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <vector>
+#include "ADS129X_Features.h"
+
+static const float FS = 2000;
+static const long THRESHOLD = 500;
+
+static double hostSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint32_t noiseState = 0x2545F491;
+
+static double noise() {
+    // sum of uniforms, roughly gaussian with unit variance
+    double sum = 0;
+    for (int i = 0; i < 12; i++) {
+        noiseState = noiseState * 1664525UL + 1013904223UL;
+        sum += noiseState / 4294967296.0;
+    }
+    return sum - 6;
+}
+
+/**
+ * Channel 1-3 and 7 are sines on bins of windows of 32 to 128 frames, 4 is two
+ * tones, 5 noise, 6 silence and 8 a sine with noise.
+ */
+static void synthesize(unsigned long _n, long *_frame) {
+    double t = _n / FS;
+    _frame[0] = 0xC00000L;
+    _frame[1] = lround(100000 * sin(2 * M_PI * 62.5 * t));
+    _frame[2] = lround(50000 * sin(2 * M_PI * 187.5 * t));
+    _frame[3] = lround(20000 * sin(2 * M_PI * 500 * t));
+    _frame[4] = lround(30000 * sin(2 * M_PI * 93.75 * t) + 30000 * sin(2 * M_PI * 312.5 * t));
+    _frame[5] = lround(20000 * noise());
+    _frame[6] = 0;
+    _frame[7] = lround(80000 * sin(2 * M_PI * 750 * t));
+    _frame[8] = lround(40000 * sin(2 * M_PI * 125 * t) + 2000 * noise());
+}
+
+/**
+ * Window features recomputed from scratch, as the reference.
+ */
+struct Reference {
+    float rms;
+    unsigned int zc, ssc;
+};
+
+static Reference reference(const std::vector<long> &_history, unsigned long _end, unsigned int _window,
+                           byte _channel) {
+    Reference result = { 0, 0, 0 };
+    double squares = 0;
+    for (unsigned long n = _end - _window; n < _end; n++) {
+        long x = _history[n * 9 + _channel];
+        squares += (double) x * x;
+        if (n >= 1) {
+            long x1 = _history[(n - 1) * 9 + _channel];
+            if ((x < 0) != (x1 < 0) && labs(x - x1) >= THRESHOLD) result.zc++;
+        }
+        if (n >= 2) {
+            long x1 = _history[(n - 1) * 9 + _channel];
+            long x2 = _history[(n - 2) * 9 + _channel];
+            long rise = x1 - x2, fall = x1 - x;
+            if (rise * fall > 0 && (labs(rise) >= THRESHOLD || labs(fall) >= THRESHOLD)) result.ssc++;
+        }
+    }
+    result.rms = sqrt(squares / _window);
+    return result;
+}
+
+int main(int argc, char **argv) {
+    double seconds = (argc > 1) ? atof(argv[1]) : 10.0;
+    unsigned int window = (argc > 2) ? atoi(argv[2]) : 128;
+    unsigned int hop = (argc > 3) ? atoi(argv[3]) : 32;
+    unsigned long count = (unsigned long) (seconds * FS);
+
+    std::vector<long> history(count * 9);
+    for (unsigned long n = 0; n < count; n++) {
+        synthesize(n, &history[n * 9]);
+    }
+
+    const float edges[] = { 0, 100, 250, 500, 1000.1f };
+    ADS129X_Features features(8);
+    if (!features.setWindow(window, hop)) {
+        fprintf(stderr, "window %u or hop %u out of range\n", window, hop);
+        return 2;
+    }
+    features.setThreshold(THRESHOLD);
+
+    // sliding-window features alone
+    unsigned long vectors = 0;
+    double start = hostSeconds();
+    for (unsigned long n = 0; n < count; n++) {
+        if (features.process(&history[n * 9])) vectors++;
+    }
+    double sliding = hostSeconds() - start;
+
+    // recomputing the window every hop instead
+    volatile float sink = 0;
+    start = hostSeconds();
+    for (unsigned long n = window; n <= count; n += hop) {
+        for (byte c = 1; c <= 8; c++) {
+            sink += reference(history, n, window, c).rms;
+        }
+    }
+    double recompute = hostSeconds() - start;
+    (void) sink;
+
+    boolean spectrum = features.setSpectrum(FS, 4, edges);
+    if (!spectrum) {
+        printf("spectrum:     off, window is not a power of two up to %u\n", ADS129X_FEATURES_FFT);
+    }
+    features.reset();
+    unsigned long errors = 0, checked = 0;
+    float bin = FS / window;
+    float vector[8 * (ADS129X_FEATURE_BAND + ADS129X_FEATURES_BANDS)];
+    float worstBand = 0;
+    double spectral = 0;
+    for (unsigned long n = 0; n < count; n++) {
+        start = hostSeconds();
+        boolean ready = features.process(&history[n * 9]);
+        spectral += hostSeconds() - start;
+        if (!ready) {
+            continue;
+        }
+        checked++;
+        features.getVector(vector);
+        byte stride = features.getFeatureCount();
+        for (byte c = 1; c <= 8; c++) {
+            Reference ref = reference(history, n + 1, window, c);
+            const float *v = vector + (c - 1) * stride;
+            if (fabs(v[ADS129X_FEATURE_RMS] - ref.rms) > 1e-4 * ref.rms + 1e-3) errors++;
+            if (v[ADS129X_FEATURE_ZC] != ref.zc || v[ADS129X_FEATURE_SSC] != ref.ssc) errors++;
+            if (v[ADS129X_FEATURE_RMS] != features.getRms(c)) errors++;
+            if (!spectrum) {
+                continue;
+            }
+            float tone = 0;
+            switch (c) {
+                case 1: tone = 62.5; break;
+                case 2: tone = 187.5; break;
+                case 3: tone = 500; break;
+                case 7: tone = 750; break;
+            }
+            // only tones on a bin have no leakage
+            if (fmod(tone, bin) != 0) tone = 0;
+            if (tone >= 2 * bin && tone <= FS / 2 - 2 * bin) {
+                // for periodic signals the bands, which cover the whole
+                // spectrum but DC, add up to the mean square; tones next to
+                // DC or Nyquist leak into them
+                float total = 0;
+                for (byte b = 0; b < 4; b++) total += v[ADS129X_FEATURE_BAND + b];
+                float deviation = fabs(total / (ref.rms * ref.rms) - 1);
+                if (deviation > worstBand) worstBand = deviation;
+            }
+            if (tone > 0 && (fabs(v[ADS129X_FEATURE_MNF] - tone) > bin / 2 ||
+                             fabs(v[ADS129X_FEATURE_MDF] - tone) > bin / 2)) errors++;
+        }
+        // two tones of equal power: the mean frequency lies in between
+        if (spectrum && bin <= 31.25f && fabs(features.getMeanFrequency(4) - (93.75 + 312.5) / 2) > bin) errors++;
+        if (features.getRms(6) != 0 || features.getZeroCrossings(6) || features.getMedianFrequency(6)) errors++;
+    }
+    if (worstBand > 0.05) errors++;
+
+    unsigned long raw = (unsigned long) (FS * 3 * 9);
+    unsigned long sent = (unsigned long) (FS / hop * 8 * features.getFeatureCount() * sizeof(float));
+    printf("window:       %u frames, hop %u, %.1f Hz bins\n", window, hop, bin);
+    printf("vectors:      %lu, %lu checked\n", vectors, checked);
+    printf("sliding:      %.1f ns/frame\n", sliding * 1e9 / count);
+    printf("spectrum:     %.1f ns/frame\n", spectral * 1e9 / count);
+    printf("recompute:    %.1f ns/frame\n", recompute * 1e9 / count);
+    printf("channel 4:    MNF %.1f Hz, MDF %.1f Hz\n", features.getMeanFrequency(4), features.getMedianFrequency(4));
+    printf("channel 5:    RMS %.0f, ZC %u, SSC %u, MNF %.1f Hz, MDF %.1f Hz\n", features.getRms(5),
+           features.getZeroCrossings(5), features.getSlopeSignChanges(5), features.getMeanFrequency(5),
+           features.getMedianFrequency(5));
+    printf("band sum:     within %.2f %% of the mean square\n", worstBand * 100);
+    printf("bandwidth:    %lu B/s raw, %lu B/s features (%.0f:1)\n", raw, sent, (double) raw / sent);
+    printf("errors:       %lu\n", errors);
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,290 @@
+/**
+ * bench_filter.cpp
+ *
+ * Checks ADS129X_Filter against double-precision references. The biquads
+ * (notch, high-pass including a 0.5 Hz cut-off where error feedback
+ * matters, low-pass) run an impulse, a step and sines through all 8
+ * channels. Impulse and step responses are compared with the same Q2.30
+ * coefficients in double, so only rounding shows: a few LSB peak, under
+ * 2 LSB RMS, and steps settle to the DC gain without a limit cycle. The
+ * notch has to attenuate mains by at least 60 dB while its pass band and
+ * the other filters keep the gain of the design. The polyphase decimator
+ * has to match a direct-form FIR with the same Q1.31 taps bit for bit, for
+ * several factors and tap counts, and the designed decimator has to have
+ * unity DC gain. Reports host time per frame for a notch, a high-pass and
+ * a 4x decimator on 8 channels. Exits non-zero on a mismatch.
+ *
+ * usage: bench_filter [sample rate in Hz]
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <vector>
+#include "ADS129X_Filter.h"
+
+static const byte CHANNELS = 8;
+static const long AMPLITUDE = 1000000;
+
+static double hostSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint32_t randomState = 0x2545F491;
+
+static long randomSample() {
+    randomState = randomState * 1664525UL + 1013904223UL;
+    return (long) (randomState >> 8) - 0x800000L;
+}
+
+/**
+ * Biquad in double, designed as in ADS129X_Filter (RBJ audio EQ cookbook).
+ */
+struct Biquad {
+    double b0, b1, b2, a1, a2;
+    double x1, x2, y1, y2;
+
+    enum Type { NOTCH, HIGH_PASS, LOW_PASS };
+
+    /**
+     * @param _quantized round coefficients to Q2.30 as the filter does, so
+     *                   only the arithmetic differs
+     */
+    Biquad(Type _type, double _f, double _fs, double _q, bool _quantized) : x1(0), x2(0), y1(0), y2(0) {
+        double w0 = 2 * M_PI * _f / _fs;
+        double alpha = sin(w0) / (2 * _q), c = cos(w0), a0 = 1 + alpha;
+        switch (_type) {
+            case NOTCH:     b0 = 1; b1 = -2 * c; b2 = 1; break;
+            case HIGH_PASS: b0 = (1 + c) / 2; b1 = -(1 + c); b2 = (1 + c) / 2; break;
+            default:        b0 = (1 - c) / 2; b1 = 1 - c; b2 = (1 - c) / 2; break;
+        }
+        b0 /= a0; b1 /= a0; b2 /= a0;
+        a1 = -2 * c / a0;
+        a2 = (1 - alpha) / a0;
+        if (_quantized) {
+            b0 = quantize(b0); b1 = quantize(b1); b2 = quantize(b2);
+            a1 = quantize(a1); a2 = quantize(a2);
+            if (_type == HIGH_PASS) b1 = -2 * b0;
+        }
+    }
+
+    static double quantize(double _x) {
+        return floor(_x * 1073741824.0 + 0.5) / 1073741824.0;
+    }
+
+    double process(double _x) {
+        double y = b0 * _x + b1 * x1 + b2 * x2 - a1 * y1 - a2 * y2;
+        x2 = x1; x1 = _x;
+        y2 = y1; y1 = y;
+        return y;
+    }
+
+    double gain(double _f, double _fs) {
+        double w = 2 * M_PI * _f / _fs;
+        double nr = b0 + b1 * cos(w) + b2 * cos(2 * w), ni = -b1 * sin(w) - b2 * sin(2 * w);
+        double dr = 1 + a1 * cos(w) + a2 * cos(2 * w), di = -a1 * sin(w) - a2 * sin(2 * w);
+        return sqrt((nr * nr + ni * ni) / (dr * dr + di * di));
+    }
+};
+
+struct Case {
+    const char *name;
+    Biquad::Type type;
+    double f, q;
+};
+
+static void configure(ADS129X_Filter &_filter, const Case &_case, double _fs) {
+    switch (_case.type) {
+        case Biquad::NOTCH:     _filter.setNotch(0, 0, _case.f, _fs, _case.q); break;
+        case Biquad::HIGH_PASS: _filter.setHighPass(0, 0, _case.f, _fs, _case.q); break;
+        default:                _filter.setLowPass(0, 0, _case.f, _fs, _case.q); break;
+    }
+}
+
+/**
+ * Runs _input through the filter and returns channel 1 of every output;
+ * counts frames where the channels differ.
+ */
+static std::vector<long> run(ADS129X_Filter &_filter, const std::vector<long> &_input, unsigned long *_errors) {
+    std::vector<long> output;
+    long in[1 + CHANNELS], out[1 + CHANNELS];
+    for (size_t n = 0; n < _input.size(); n++) {
+        in[0] = 0xC00000L;
+        for (byte c = 1; c <= CHANNELS; c++) in[c] = _input[n];
+        if (!_filter.process(in, out)) continue;
+        output.push_back(out[1]);
+        for (byte c = 2; c <= CHANNELS; c++) {
+            if (out[c] != out[1]) {
+                (*_errors)++;
+                break;
+            }
+        }
+        if (out[0] != in[0]) (*_errors)++;
+    }
+    return output;
+}
+
+/**
+ * Gain for a sine, from the RMS of the output over the last second (whole
+ * periods for integer frequencies), after the filter settled.
+ */
+static double sineGain(ADS129X_Filter &_filter, double _f, double _fs, unsigned long *_errors) {
+    unsigned long count = (unsigned long) (4 * _fs);
+    std::vector<long> input(count);
+    for (unsigned long n = 0; n < count; n++) {
+        input[n] = lround(AMPLITUDE * sin(2 * M_PI * _f * n / _fs));
+    }
+    _filter.reset();
+    std::vector<long> output = run(_filter, input, _errors);
+    double squares = 0;
+    size_t first = output.size() - (size_t) _fs;
+    for (size_t n = first; n < output.size(); n++) {
+        squares += (double) output[n] * output[n];
+    }
+    return sqrt(2 * squares / (output.size() - first)) / AMPLITUDE;
+}
+
+static double decibels(double _ratio) {
+    return 20 * log10(_ratio > 1e-12 ? _ratio : 1e-12);
+}
+
+int main(int argc, char **argv) {
+    double fs = (argc > 1) ? atof(argv[1]) : 2000;
+    unsigned long errors = 0;
+
+    const Case cases[] = {
+        { "notch 50 Hz", Biquad::NOTCH, 50, 30 },
+        { "high-pass 20 Hz", Biquad::HIGH_PASS, 20, 0.7071 },
+        { "high-pass 0.5 Hz", Biquad::HIGH_PASS, 0.5, 0.7071 },
+        { "low-pass 200 Hz", Biquad::LOW_PASS, 200, 0.7071 },
+    };
+    printf("%-18s %10s %10s %10s %10s %14s\n", "biquad", "impulse", "rms", "ripple", "gain dB", "ref dB");
+    for (unsigned int i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        const Case &test = cases[i];
+        if (test.f >= fs / 2) continue;
+        ADS129X_Filter filter(CHANNELS);
+        configure(filter, test, fs);
+
+        // impulse response against the same coefficients in double, in LSB
+        // of an impulse of AMPLITUDE
+        unsigned long count = (unsigned long) (10 * fs);
+        std::vector<long> input(count, 0);
+        input[0] = AMPLITUDE;
+        std::vector<long> output = run(filter, input, &errors);
+        Biquad quantized(test.type, test.f, fs, test.q, true);
+        double worst = 0, squares = 0;
+        for (unsigned long n = 0; n < count; n++) {
+            double deviation = output[n] - quantized.process(input[n]);
+            if (fabs(deviation) > worst) worst = fabs(deviation);
+            squares += deviation * deviation;
+        }
+        double noise = sqrt(squares / count);
+        if (worst > 8 || noise > 2) errors++;
+
+        // a step settles to the DC gain; error feedback leaves a dither of
+        // about 1 LSB but no limit cycle
+        filter.reset();
+        std::vector<long> step(count, AMPLITUDE);
+        output = run(filter, step, &errors);
+        double dc = quantized.gain(0, fs) * AMPLITUDE;
+        double sum = 0;
+        squares = 0;
+        for (unsigned long n = count - (unsigned long) fs; n < count; n++) {
+            sum += output[n] - dc;
+            squares += (output[n] - dc) * (output[n] - dc);
+        }
+        double offset = sum / fs, ripple = sqrt(squares / fs);
+        if (fabs(offset) > 0.5 || ripple > 2) errors++;
+
+        // gain at the frequency the filter acts on, against the design
+        double f = (test.type == Biquad::LOW_PASS && 2 * test.f < fs / 2) ? 2 * test.f : test.f;
+        Biquad reference(test.type, test.f, fs, test.q, false);
+        double gain = sineGain(filter, f, fs, &errors);
+        double expected = reference.gain(f, fs);
+        if (test.type == Biquad::NOTCH) {
+            if (decibels(gain) > -60) errors++;
+        } else if (fabs(decibels(gain) - decibels(expected)) > 0.05) {
+            errors++;
+        }
+        printf("%-18s %6.1f LSB %6.2f LSB %6.2f LSB %10.2f %14.2f\n", test.name, worst, noise, ripple,
+               decibels(gain), decibels(expected));
+
+        // and in the pass band of the notch
+        if (test.type == Biquad::NOTCH) {
+            const double passes[] = { 10, 45, 55, 250 };
+            for (byte p = 0; p < 4; p++) {
+                if (passes[p] >= fs / 2) continue;
+                double passGain = sineGain(filter, passes[p], fs, &errors);
+                double passExpected = reference.gain(passes[p], fs);
+                if (fabs(decibels(passGain) - decibels(passExpected)) > 0.05) errors++;
+                printf("  at %5.0f Hz %51.2f %14.2f\n", passes[p], decibels(passGain), decibels(passExpected));
+            }
+        }
+    }
+
+    // polyphase decimator against a direct-form FIR with the same taps
+    const byte shapes[][2] = { { 2, 7 }, { 3, 12 }, { 4, 16 }, { 4, 32 }, { 8, 31 }, { 1, 5 } };
+    unsigned long count = (unsigned long) (2 * fs);
+    std::vector<long> input(count);
+    for (unsigned long n = 0; n < count; n++) {
+        input[n] = randomSample();
+    }
+    for (unsigned int s = 0; s < sizeof(shapes) / sizeof(shapes[0]); s++) {
+        byte factor = shapes[s][0], numTaps = shapes[s][1];
+        long taps[ADS129X_FILTER_TAPS];
+        for (byte k = 0; k < numTaps; k++) {
+            taps[k] = (long) (randomState = randomState * 1664525UL + 1013904223UL) / (2 * numTaps);
+        }
+        ADS129X_Filter filter(CHANNELS);
+        if (!filter.setDecimation(factor, numTaps, taps)) {
+            printf("decimator:    %ux with %u taps rejected\n", factor, numTaps);
+            errors++;
+            continue;
+        }
+        std::vector<long> output = run(filter, input, &errors);
+        unsigned long mismatches = 0;
+        if (output.size() != (count + factor - 1) / factor) mismatches++;
+        for (size_t m = 0; m < output.size(); m++) {
+            int64_t sum = 0;
+            for (byte k = 0; k < numTaps; k++) {
+                if (m * factor >= k) sum += (int64_t) taps[k] * input[m * factor - k];
+            }
+            if (output[m] != (long) ((sum + (1LL << 30)) >> 31)) mismatches++;
+        }
+        printf("decimator:    %ux, %2u taps, %lu outputs, %lu mismatches\n", factor, numTaps,
+               (unsigned long) output.size(), mismatches);
+        errors += mismatches;
+    }
+
+    // the designed decimator passes DC unchanged
+    ADS129X_Filter designed(CHANNELS);
+    designed.setDecimation(4, 31);
+    std::vector<long> step(count, AMPLITUDE);
+    std::vector<long> output = designed.getDecimation() == 4 ? run(designed, step, &errors) : std::vector<long>();
+    long last = output.empty() ? 0 : output.back();
+    if (labs(last - AMPLITUDE) > 1) errors++;
+    printf("DC gain:      %ld for %ld (4x, 31 taps)\n", last, AMPLITUDE);
+
+    // time for a typical chain
+    ADS129X_Filter chain(CHANNELS);
+    chain.setNotch(0, 0, 50, fs, 30);
+    chain.setHighPass(1, 0, 20, fs);
+    chain.setDecimation(4, 16);
+    long in[1 + CHANNELS], out[1 + CHANNELS];
+    volatile long sink = 0;
+    double start = hostSeconds();
+    for (unsigned long n = 0; n < count; n++) {
+        in[0] = 0xC00000L;
+        for (byte c = 1; c <= CHANNELS; c++) in[c] = input[n] >> c;
+        if (chain.process(in, out)) sink += out[1];
+    }
+    double elapsed = hostSeconds() - start;
+    (void) sink;
+    printf("chain:        %.1f ns/frame (notch, high-pass, 4x decimator, 8 channels)\n", elapsed * 1e9 / count);
+    printf("errors:       %lu\n", errors);
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,292 @@
+/**
+ * bench_pipeline.cpp
+ *
+ * Replays a raw frame capture (ADS129X_Capture.h) through the unmodified
+ * library and times each stage of a typical pipeline on the same frames:
+ * acquisition (getData on the simulated bus), unpack, filter (50 Hz notch
+ * and 20 Hz high-pass), block compression, per-frame packets and
+ * conversion to microvolts. Replay is deterministic, so results can be
+ * compared between builds and machines. Every frame returned by getData is
+ * checked against the capture; the run exits non-zero on a mismatch or a
+ * lost frame.
+ *
+ * Captures come from recorder (.cap output) or are generated here from the
+ * simulator with -g. Replay runs at maximum speed, or at the recorded pace
+ * with -r.
+ *
+ * usage: bench_pipeline [-g seconds] [-d DR (0-6)] [-r] capture.cap
+ *   -g  first record this many seconds of simulated EMG to the capture
+ *   -d  data rate for -g (default 2, 8 kSPS)
+ *   -r  replay in real time instead of as fast as possible
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+#include "ADS129X.h"
+#include "ADS129X_Filter.h"
+#include "ADS129X_Codec.h"
+#include "ADS129X_Converter.h"
+#include "ADS129X_Capture.h"
+#include "ADS129X_Sim.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+static const int ADS_DRDY = 5;
+static const int ADS_CS = 10;
+
+static double hostSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static unsigned long long cycles() {
+#ifdef HAVE_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+/**
+ * Host time and cycles spent in one stage.
+ */
+struct Stage {
+    double start, seconds;
+    unsigned long long startCycles, cycles;
+
+    void begin() {
+        start = hostSeconds();
+        startCycles = ::cycles();
+    }
+
+    void end() {
+        cycles = ::cycles() - startCycles;
+        seconds = hostSeconds() - start;
+    }
+
+    void print(const char *_name, unsigned long _frames) {
+        printf("%-12s %12.0f %10.1f", _name, seconds > 0 ? _frames / seconds : 0.0, seconds * 1e9 / _frames);
+#ifdef HAVE_TSC
+        printf(" %10.1f", (double) cycles / _frames);
+#endif
+        printf("\n");
+    }
+};
+
+static void usage() {
+    fprintf(stderr, "usage: bench_pipeline [-g seconds] [-d DR (0-6)] [-r] capture.cap\n");
+    exit(2);
+}
+
+static void drain(ADS129X &_ads) {
+    long buffer[ADS129X_FRAME_WORDS];
+    while (_ads.getData(buffer)) ;
+}
+
+/**
+ * Records simulated EMG on channels 1-7 and a shorted channel 8.
+ */
+static boolean generate(ADS129X &_ads, ADS129X_Sim &_sim, const char *_path, double _seconds, byte _dr) {
+    byte config1 = (1<<ADS129X_BIT_HR) | _dr;
+    _ads.SDATAC();
+    _ads.setRegister(ADS129X_REG_CONFIG1, config1);
+    _ads.setRegister(ADS129X_REG_CONFIG3, (1<<ADS129X_BIT_PD_REFBUF) | (1<<6));
+    for (int i = 1; i <= 7; i++) {
+        _ads.setChannel(i, false, ADS129X_GAIN_12X, ADS129X_MUX_NORMAL);
+    }
+    _ads.setChannel(8, false, ADS129X_GAIN_12X, ADS129X_MUX_SHORT);
+    _ads.commit();
+
+    ADS129X_CaptureWriter writer;
+    if (!writer.open(_path, _sim.getFrameBytes(), config1, 32000 >> _dr)) {
+        perror(_path);
+        return false;
+    }
+    _sim.setCapture(&writer);
+    _ads.RDATAC();
+    _ads.START();
+    unsigned long end = ADS129X_HAL::micros() + (unsigned long) (_seconds * 1e6);
+    while (ADS129X_HAL::micros() < end) {
+        ADS129X_HAL::delayMicroseconds(100);
+        drain(_ads);
+    }
+    _ads.STOP();
+    _sim.setCapture(NULL);
+    drain(_ads);
+    printf("generated:    %lu frames\n", writer.getFrames());
+    writer.close();
+    return true;
+}
+
+int main(int argc, char **argv) {
+    double generateSeconds = 0;
+    byte dr = 2;
+    boolean realTime = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "g:d:r")) != -1) {
+        switch (opt) {
+            case 'g': generateSeconds = atof(optarg); break;
+            case 'd': dr = atoi(optarg) & 0x07; break;
+            case 'r': realTime = true; break;
+            default: usage();
+        }
+    }
+    if (optind != argc - 1) usage();
+    const char *path = argv[optind];
+
+    ADS129X_Sim sim(ADS129X_ID_ADS1298);
+    sim.attach(ADS_CS, ADS_DRDY);
+    ADS129X ADS(ADS_DRDY, ADS_CS);
+    if (generateSeconds > 0 && !generate(ADS, sim, path, generateSeconds, dr)) {
+        return 1;
+    }
+
+    ADS129X_CaptureReader capture;
+    if (!capture.open(path)) {
+        fprintf(stderr, "%s: not a capture\n", path);
+        return 1;
+    }
+    byte frameBytes = capture.getFrameBytes();
+    byte channels = frameBytes / 3 - 1;
+    if (frameBytes % 3 || (channels != 4 && channels != 6 && channels != 8)) {
+        fprintf(stderr, "%s: %u-byte frames, only single devices are supported\n", path, frameBytes);
+        return 1;
+    }
+    byte words = 1 + channels;
+
+    // the recorded frames, for checking and for the offline stages
+    std::vector<byte> raw;
+    byte record[ADS129X_CAPTURE_FRAME];
+    uint64_t time, duration = 0;
+    while (capture.next(&time, record)) {
+        raw.insert(raw.end(), record, record + frameBytes);
+        duration = time;
+    }
+    unsigned long count = raw.size() / frameBytes;
+    if (count == 0) {
+        fprintf(stderr, "%s: empty capture\n", path);
+        return 1;
+    }
+    capture.rewind();
+
+    // replay through getData; the poll period stays below a frame period
+    ADS.STOP();
+    ADS.SDATAC();
+    drain(ADS);
+    if (capture.getConfig1()) {
+        ADS.setRegister(ADS129X_REG_CONFIG1, capture.getConfig1());
+    }
+    ADS.setDaisyChain(1, channels);
+    unsigned long period = count > 1 ? duration / 1000 / count : 100;
+    unsigned int loopPeriod = period / 2 > 100 ? 100 : (period / 2 ? period / 2 : 1);
+    sim.setReplay(&capture);
+    ADS.RDATAC();
+    if (realTime) ADS129X_Host::setRealTime(true);
+    ADS.START();
+
+    std::vector<long> frames(count * words);
+    std::vector<long> scratch(count * words);
+    unsigned long received = 0, errors = 0;
+    long buffer[ADS129X_FRAME_WORDS];
+    Stage acquisition;
+    acquisition.begin();
+    boolean done = false;
+    while (!done) {
+        done = sim.isReplayDone();
+        ADS129X_HAL::delayMicroseconds(loopPeriod);
+        while (ADS.getData(buffer)) {
+            if (received < count) {
+                memcpy(&frames[received * words], buffer, words * sizeof(long));
+            }
+            received++;
+        }
+    }
+    acquisition.end();
+    ADS.STOP();
+    ADS129X_Host::setRealTime(false);
+
+    Stage unpack;
+    unpack.begin();
+    for (unsigned long f = 0; f < count; f++) {
+        const byte *in = &raw[f * frameBytes];
+        long *out = &scratch[f * words];
+        switch (channels) {
+            case 4: ADS129X_Reader<4>::unpack(in, out, 1, 4); break;
+            case 6: ADS129X_Reader<6>::unpack(in, out, 1, 6); break;
+            default: ADS129X_Reader<8>::unpack(in, out, 1, 8); break;
+        }
+    }
+    unpack.end();
+
+    // deterministic replay: getData returns exactly the recorded frames
+    if (received != count) errors++;
+    for (unsigned long i = 0; i < count * words; i++) {
+        if (frames[i] != scratch[i]) errors++;
+    }
+
+    float fs = capture.getSampleRate() ? capture.getSampleRate() : 1e9f * count / (duration ? duration : 1);
+    ADS129X_Filter filter(channels);
+    filter.setNotch(0, 0, 50, fs, 30);
+    filter.setHighPass(1, 0, 20, fs);
+    Stage filtering;
+    filtering.begin();
+    for (unsigned long f = 0; f < count; f++) {
+        filter.process(&frames[f * words], &scratch[f * words]);
+    }
+    filtering.end();
+
+    ADS129X_Encoder encoder(channels);
+    byte block[ADS129X_BLOCK_SIZE];
+    unsigned long compressed = 0;
+    Stage encoding;
+    encoding.begin();
+    for (unsigned long f = 0; f < count; f++) {
+        compressed += encoder.addFrame(&frames[f * words], f, block);
+    }
+    compressed += encoder.flush(block);
+    encoding.end();
+
+    byte packet[ADS129X_PACKET_SIZE(8)];
+    unsigned long packed = 0;
+    Stage packets;
+    packets.begin();
+    for (unsigned long f = 0; f < count; f++) {
+        packed += ADS129X_encodeFrame(&frames[f * words], channels, (byte) f, packet);
+    }
+    packets.end();
+
+    ADS129X_Converter converter(channels);
+    converter.setGain(0, ADS129X_GAIN_12X);
+    Stage conversion;
+    conversion.begin();
+    converter.toMicrovolts(&frames[0], count, &scratch[0]);
+    conversion.end();
+
+    printf("capture:      %lu frames of %u channels, %.3f s at %lu SPS\n", count, channels,
+           duration * 1e-9, capture.getSampleRate());
+    printf("replay:       %s, %.3f s host time\n", realTime ? "real time" : "maximum speed",
+           acquisition.seconds);
+    printf("%-12s %12s %10s", "stage", "frames/s", "ns/frame");
+#ifdef HAVE_TSC
+    printf(" %10s", "cycles");
+#endif
+    printf("\n");
+    acquisition.print("acquisition", count);
+    unpack.print("unpack", count);
+    filtering.print("filter", count);
+    encoding.print("compress", count);
+    packets.print("packets", count);
+    conversion.print("convert", count);
+    printf("compressed:   %.2f:1\n", (double) count * 3 * words / compressed);
+    printf("packets:      %lu bytes\n", packed);
+    printf("frames read:  %lu\n", received);
+    printf("errors:       %lu\n", errors);
+    return errors ? 1 : 0;
+}
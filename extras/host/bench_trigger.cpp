@@ -0,0 +1,208 @@
+/**
+ * bench_trigger.cpp
+ *
+ * Feeds ADS129X_Trigger with synthetic 8-channel frames: noise with
+ * injected bursts on channel 1, slow drifts to the same level that must not
+ * fire, and lead-off on channel 3. The trigger fires on level and slope of
+ * channel 1 together, or on lead-off. Every decision is checked against a
+ * brute-force evaluation of the conditions, and every event window read
+ * back must hold the pre-trigger frames, the trigger frame and the
+ * post-trigger frames in order, unchanged and with their sequence numbers
+ * and timestamps. The reader can lag behind by a number of frames to show
+ * when the history overflows. Reports host time per frame and the link
+ * bandwidth of event windows against streaming. Exits non-zero on a
+ * mismatch.
+ *
+ * usage: bench_trigger [seconds] [pre] [post] [reader lag in frames]
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <vector>
+#include "ADS129X_Trigger.h"
+
+static const float FS = 2000;
+static const uint32_t PERIOD = 500; // timestamp ticks per frame, us
+static const long LEVEL = 200000;
+static const long STEP = 50000;
+static const unsigned long BURST = 50;
+static const unsigned long LOFF_BIT = 1UL << (12 + 3 - 1); // LOFF_STATP of channel 3
+
+static double hostSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint32_t randomState = 0x2545F491;
+
+static uint32_t random32() {
+    randomState = randomState * 1664525UL + 1013904223UL;
+    return randomState;
+}
+
+/**
+ * Noise on all channels. Every 1000 to 2000 frames one of: a 100 Hz burst
+ * of 50 frames on channel 1 (fires), a drift of channel 1 up to 1.25 times
+ * the level and back over 400 frames (too slow to fire), or 100 frames of
+ * lead-off on channel 3 (fires).
+ */
+static void synthesize(unsigned long _count, std::vector<long> &_history, unsigned long *_injected) {
+    unsigned long next = 500;
+    byte kind = 0;
+    for (unsigned long n = 0; n < _count; n++) {
+        long *frame = &_history[n * 9];
+        frame[0] = 0xC00000L;
+        for (byte c = 1; c <= 8; c++) {
+            frame[c] = (long) (random32() % 4001) - 2000;
+        }
+        if (n < next) {
+            continue;
+        }
+        unsigned long offset = n - next;
+        switch (kind) {
+            case 0:
+                frame[1] += lround(300000 * sin(2 * M_PI * 100 * offset / FS));
+                break;
+            case 1:
+                frame[1] += (offset < 200 ? offset : 400 - offset) * (LEVEL * 5 / 4) / 200;
+                break;
+            default:
+                frame[0] |= LOFF_BIT;
+                break;
+        }
+        unsigned long length = (kind == 0) ? BURST : (kind == 1) ? 400 : 100;
+        if (offset + 1 == length) {
+            _injected[kind]++;
+            kind = (kind + 1) % 3;
+            next = n + 1000 + random32() % 1000;
+        }
+    }
+}
+
+/**
+ * The combination recomputed directly: level and slope on channel 1, or
+ * lead-off.
+ */
+static boolean reference(const std::vector<long> &_history, unsigned long _n) {
+    const long *frame = &_history[_n * 9];
+    boolean level = labs(frame[1]) >= LEVEL;
+    boolean slope = _n > 0 && labs(frame[1] - _history[(_n - 1) * 9 + 1]) >= STEP;
+    boolean leadOff = (frame[0] & 0xFFFF0L) != 0;
+    return (level && slope) || leadOff;
+}
+
+int main(int argc, char **argv) {
+    double seconds = (argc > 1) ? atof(argv[1]) : 60.0;
+    unsigned int pre = (argc > 2) ? atoi(argv[2]) : 32;
+    unsigned int post = (argc > 3) ? atoi(argv[3]) : 96;
+    unsigned int lag = (argc > 4) ? atoi(argv[4]) : 1;
+    unsigned long count = (unsigned long) (seconds * FS);
+    if (lag < 1) lag = 1;
+
+    std::vector<long> history(count * 9);
+    unsigned long injected[3] = { 0, 0, 0 };
+    synthesize(count, history, injected);
+
+    ADS129X_Trigger trigger(8);
+    if (!trigger.setWindow(pre, post)) {
+        fprintf(stderr, "pre %u has to be below %u, post at least 1\n", pre, ADS129X_TRIGGER_FRAMES);
+        return 2;
+    }
+    byte level = trigger.addLevel(1, LEVEL, ADS129X_TRIGGER_OUTSIDE);
+    byte slope = trigger.addSlope(1, STEP, ADS129X_TRIGGER_OUTSIDE);
+    byte leadOff = trigger.addLeadOff(3);
+    byte terms[] = { (byte) ((1 << level) | (1 << slope)), (byte) (1 << leadOff) };
+    trigger.setLogic(terms, 2);
+    trigger.arm();
+
+    unsigned long errors = 0, events = 0, read = 0;
+    unsigned long nextAllowed = 0, eventEnd = 0, expectedPosition = 0;
+    boolean matched = false, open = false;
+    unsigned long causes[2] = { 0, 0 };
+    long frame[9];
+    unsigned long sequence;
+    uint32_t timestamp;
+    double processing = 0;
+    for (unsigned long n = 0; n < count; n++) {
+        double start = hostSeconds();
+        boolean fired = trigger.process(&history[n * 9], n, n * PERIOD);
+        processing += hostSeconds() - start;
+
+        boolean now = reference(history, n);
+        boolean expected = now && !matched && n >= nextAllowed;
+        matched = now;
+        if (fired != expected) {
+            if (errors < 10) printf("frame %lu: fired %u, expected %u\n", n, fired, expected);
+            errors++;
+        }
+        if (fired) {
+            if (open && expectedPosition != eventEnd) {
+                printf("event at %lu: window incomplete when the next fired\n", trigger.getTriggerSequence());
+                errors++;
+            }
+            unsigned int expectedPre = (n < pre) ? n : pre;
+            if (trigger.getTriggerSequence() != n || trigger.getTriggerTime() != n * PERIOD ||
+                trigger.getPreFrames() != expectedPre) errors++;
+            byte conditions = trigger.getTriggerConditions();
+            if (conditions & (1 << leadOff)) causes[1]++;
+            if ((conditions & terms[0]) == terms[0]) causes[0]++;
+            events++;
+            open = true;
+            expectedPosition = n - trigger.getPreFrames();
+            eventEnd = n + post;
+            nextAllowed = count;
+        }
+        if ((n + 1) % lag != 0) {
+            continue;
+        }
+        while (trigger.read(frame, &sequence, &timestamp)) {
+            read++;
+            if (sequence < expectedPosition) {
+                errors++;
+            } else if (sequence > expectedPosition) {
+                // overwritten before it was read
+                expectedPosition = sequence;
+            }
+            if (sequence >= count || timestamp != sequence * PERIOD) {
+                errors++;
+                continue;
+            }
+            for (byte c = 0; c <= 8; c++) {
+                if (frame[c] != history[sequence * 9 + c]) {
+                    errors++;
+                    break;
+                }
+            }
+            expectedPosition++;
+        }
+        if (open && expectedPosition >= eventEnd) {
+            // window read; the next event can fire from the next frame on
+            open = false;
+            nextAllowed = n + 1;
+        }
+    }
+    if (trigger.getTriggers() != events) errors++;
+    // with a window longer than a burst, every burst and every lead-off
+    // episode is one event
+    unsigned long expectedEvents = injected[0] + injected[2];
+    if (lag == 1 && post >= BURST && events != expectedEvents) {
+        printf("events:       %lu, expected %lu\n", events, expectedEvents);
+        errors++;
+    }
+    if (lag + pre <= ADS129X_TRIGGER_FRAMES && trigger.getDropped()) errors++;
+
+    unsigned long raw = (unsigned long) (FS * 3 * 9);
+    double sent = read * 3.0 * 9 / seconds;
+    printf("window:       %u pre, %u post, %u frames history, reader lag %u\n", pre, post,
+           ADS129X_TRIGGER_FRAMES, lag);
+    printf("injected:     %lu bursts, %lu drifts, %lu lead-off\n", injected[0], injected[1], injected[2]);
+    printf("events:       %lu (%lu level and slope, %lu lead-off)\n", events, causes[0], causes[1]);
+    printf("frames:       %lu of %lu read, %lu dropped\n", read, count, trigger.getDropped());
+    printf("process:      %.1f ns/frame\n", processing * 1e9 / count);
+    printf("bandwidth:    %lu B/s streaming, %.0f B/s events (%.0f:1)\n", raw, sent, raw / sent);
+    printf("errors:       %lu\n", errors);
+    return errors ? 1 : 0;
+}
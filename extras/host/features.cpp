@@ -0,0 +1,150 @@
+/**
+ * features.cpp
+ *
+ * Offline feature extraction: runs a raw frame capture (ADS129X_Capture.h,
+ * e.g. written by recorder) through ADS129X_Features, the same code that
+ * runs on the board, and writes one CSV line per feature vector: the time
+ * of its last frame in seconds, then RMS, ZC and SSC (and with -s MNF, MDF
+ * and the band powers) for every channel. Channels can be high-passed with
+ * ADS129X_Filter first, which zero crossings need if the signal has an
+ * offset.
+ *
+ * usage: features [-w window] [-o hop] [-t threshold] [-h high-pass Hz] [-s]
+ *                 [-b edge,edge,...] capture.cap [out.csv]
+ *   -w  window in frames (default 128)
+ *   -o  hop in frames (default 32)
+ *   -t  threshold for ZC and SSC in LSB (default 0)
+ *   -h  high-pass cut-off in Hz (default none)
+ *   -s  spectrum stage; the window has to be a power of two
+ *   -b  band edges in Hz for -s, ascending
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "ADS129X.h"
+#include "ADS129X_Features.h"
+#include "ADS129X_Filter.h"
+#include "ADS129X_Capture.h"
+
+static void usage() {
+    fprintf(stderr, "usage: features [-w window] [-o hop] [-t threshold] [-h high-pass Hz] [-s]\n"
+                    "                [-b edge,edge,...] capture.cap [out.csv]\n");
+    exit(2);
+}
+
+int main(int argc, char **argv) {
+    unsigned int window = 128, hop = 32;
+    long threshold = 0;
+    float highPass = 0;
+    boolean spectrum = false;
+    float edges[ADS129X_FEATURES_BANDS + 1];
+    byte numBands = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "w:o:t:h:sb:")) != -1) {
+        switch (opt) {
+            case 'w': window = atoi(optarg); break;
+            case 'o': hop = atoi(optarg); break;
+            case 't': threshold = atol(optarg); break;
+            case 'h': highPass = atof(optarg); break;
+            case 's': spectrum = true; break;
+            case 'b': {
+                byte edgeCount = 0;
+                for (char *edge = strtok(optarg, ","); edge != NULL; edge = strtok(NULL, ",")) {
+                    if (edgeCount > ADS129X_FEATURES_BANDS) {
+                        fprintf(stderr, "at most %u bands\n", ADS129X_FEATURES_BANDS);
+                        return 2;
+                    }
+                    edges[edgeCount++] = atof(edge);
+                }
+                numBands = edgeCount > 1 ? edgeCount - 1 : 0;
+                break;
+            }
+            default: usage();
+        }
+    }
+    if (optind != argc - 1 && optind != argc - 2) usage();
+    const char *path = argv[optind];
+
+    ADS129X_CaptureReader capture;
+    if (!capture.open(path)) {
+        fprintf(stderr, "%s: not a capture\n", path);
+        return 1;
+    }
+    byte frameBytes = capture.getFrameBytes();
+    byte channels = frameBytes / 3 - 1;
+    if (frameBytes % 3 || (channels != 4 && channels != 6 && channels != 8)) {
+        fprintf(stderr, "%s: %u-byte frames, only single devices are supported\n", path, frameBytes);
+        return 1;
+    }
+    float fs = capture.getSampleRate();
+    if ((spectrum || highPass > 0) && fs == 0) {
+        fprintf(stderr, "%s: no sample rate in the capture\n", path);
+        return 1;
+    }
+    FILE *out = stdout;
+    if (optind == argc - 2 && (out = fopen(argv[argc - 1], "w")) == NULL) {
+        perror(argv[argc - 1]);
+        return 1;
+    }
+
+    ADS129X_Features features(channels);
+    if (!features.setWindow(window, hop)) {
+        fprintf(stderr, "window %u or hop %u out of range (window up to %u)\n", window, hop,
+                ADS129X_FEATURES_WINDOW);
+        return 2;
+    }
+    features.setThreshold(threshold);
+    if (spectrum && !features.setSpectrum(fs, numBands, edges)) {
+        fprintf(stderr, "spectrum needs a window that is a power of two up to %u\n", ADS129X_FEATURES_FFT);
+        return 2;
+    }
+    ADS129X_Filter filter(channels);
+    if (highPass > 0) {
+        filter.setHighPass(0, 0, highPass, fs);
+    }
+
+    const char *names[] = { "rms", "zc", "ssc", "mnf", "mdf" };
+    fprintf(out, "time");
+    for (byte c = 1; c <= channels; c++) {
+        for (byte f = 0; f < features.getFeatureCount(); f++) {
+            if (f < ADS129X_FEATURE_BAND) {
+                fprintf(out, ",ch%u_%s", c, names[f]);
+            } else {
+                fprintf(out, ",ch%u_band%u", c, f - ADS129X_FEATURE_BAND);
+            }
+        }
+    }
+    fprintf(out, "\n");
+
+    byte raw[ADS129X_CAPTURE_FRAME];
+    long frame[ADS129X_FRAME_WORDS];
+    float vector[ADS129X_FEATURES_CHANNELS * (ADS129X_FEATURE_BAND + ADS129X_FEATURES_BANDS)];
+    uint64_t time;
+    unsigned long frames = 0, vectors = 0;
+    while (capture.next(&time, raw)) {
+        switch (channels) {
+            case 4: ADS129X_Reader<4>::unpack(raw, frame, 1, 4); break;
+            case 6: ADS129X_Reader<6>::unpack(raw, frame, 1, 6); break;
+            default: ADS129X_Reader<8>::unpack(raw, frame, 1, 8); break;
+        }
+        frames++;
+        if (highPass > 0) {
+            filter.process(frame, frame);
+        }
+        if (!features.process(frame)) {
+            continue;
+        }
+        vectors++;
+        unsigned int count = features.getVector(vector);
+        fprintf(out, "%.6f", time * 1e-9);
+        for (unsigned int i = 0; i < count; i++) {
+            fprintf(out, ",%g", vector[i]);
+        }
+        fprintf(out, "\n");
+    }
+    if (out != stdout) fclose(out);
+    fprintf(stderr, "%lu frames, %lu feature vectors\n", frames, vectors);
+    return 0;
+}
@@ -0,0 +1,403 @@
+/**
+ * recorder.cpp
+ *
+ * Records frames sent with the ADS129X wire protocol (see
+ * ADS129X_Protocol.h) from a serial port, file or pipe. Packets are decoded
+ * incrementally as bytes arrive and written straight to disk, so memory use
+ * is constant no matter how long the session runs. Stop with Ctrl-C.
+ *
+ * The output format is chosen by the file extension:
+ *   .raw  received bytes, unmodified
+ *   .wav  24-bit PCM, one WAV channel per ADC channel
+ *   .csv  one line per frame: sequence, status, channels
+ *   .bin  fixed-size little-endian records for mmap (see writeBinHeader)
+ *   .cap  raw frames with timestamps for replay (see ADS129X_Capture.h)
+ *
+ * usage: recorder [-p port | -i file] [-c] [-s samplerate] [-n frames per chunk] [-z]
+ *                 [-u gain] [-r vref] out
+ *   -p  serial port (raw mode, baud rate is ignored by USB CDC devices)
+ *   -i  file or pipe to read instead of a port, - for stdin
+ *   -c  input is compressed blocks (ADS129X_Codec.h) instead of packets
+ *   -s  sample rate written to WAV/bin headers and used for capture
+ *       timestamps (default 1000)
+ *   -n  start a new numbered output file every n frames, at the next
+ *       packet boundary
+ *   -z  insert zero frames for lost frames to keep the time base
+ *   -u  write CSV channels in microvolts for this PGA gain (1-12)
+ *   -r  reference voltage for -u (default 2.4)
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <time.h>
+#include <vector>
+#include "ADS129X_Protocol.h"
+#include "ADS129X_Codec.h"
+#include "ADS129X_Converter.h"
+#include "ADS129X_Capture.h"
+
+enum Format { FORMAT_RAW, FORMAT_WAV, FORMAT_CSV, FORMAT_BIN, FORMAT_CAP };
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void onSignal(int) {
+    stopRequested = 1;
+}
+
+static void putLE(FILE *f, uint32_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        fputc((value >> (8*i)) & 0xFF, f);
+    }
+}
+
+/**
+ * One output file. Headers that contain sizes are written with
+ * placeholders and patched on close.
+ */
+class Output {
+    public:
+        Output(Format _format, unsigned long _sampleRate, boolean _zeroFill)
+            : format(_format), sampleRate(_sampleRate), zeroFill(_zeroFill),
+              file(NULL), channels(0), frames(0), slots(0), scale(0) {
+        }
+
+        /**
+         * Write CSV channel data in microvolts, all channels at the same gain.
+         * @param _gain gain setting (ADS129X_GAIN_*)
+         * @param _vref reference voltage in V
+         */
+        void setMicrovolts(byte _gain, float _vref) {
+            ADS129X_Converter converter(1);
+            converter.setGain(1, _gain);
+            converter.setReference(_vref);
+            scale = converter.getScale(1);
+        }
+
+        boolean open(const char *_path, byte _channels) {
+            channels = _channels;
+            frames = 0;
+            slots = 0;
+            if (format == FORMAT_CAP) {
+                if (!capture.open(_path, 3 + 3*channels, 0, sampleRate)) {
+                    perror(_path);
+                    return false;
+                }
+                return true;
+            }
+            file = fopen(_path, "wb");
+            if (file == NULL) {
+                perror(_path);
+                return false;
+            }
+            setvbuf(file, NULL, _IOFBF, 1 << 16);
+            if (format == FORMAT_WAV) writeWavHeader();
+            if (format == FORMAT_BIN) writeBinHeader();
+            if (!pending.empty()) {
+                fwrite(&pending[0], 1, pending.size(), file);
+                pending.clear();
+            }
+            return true;
+        }
+
+        /**
+         * Raw stream bytes. Bytes that arrive before the first frame has
+         * opened the file are kept and written on open.
+         */
+        void writeBytes(const byte *_data, size_t _length) {
+            if (format != FORMAT_RAW) return;
+            if (file != NULL) {
+                fwrite(_data, 1, _length, file);
+            } else {
+                pending.insert(pending.end(), _data, _data + _length);
+            }
+        }
+
+        void writeFrame(const long *_frame, byte _sequence, unsigned long _lost) {
+            if (!isOpen()) return;
+            if (format == FORMAT_CAP && !zeroFill) {
+                // the frame is placed after the gap, so the time base holds
+                slots += _lost;
+            }
+            if (zeroFill) {
+                static const long zero[1 + ADS129X_PROTOCOL_CHANNELS] = { 0 };
+                for (unsigned long i = 0; i < _lost; i++) {
+                    writeRecord(zero, (byte) (_sequence - _lost + i));
+                }
+            }
+            writeRecord(_frame, _sequence);
+        }
+
+        void close() {
+            capture.close();
+            if (file == NULL) return;
+            if (format == FORMAT_WAV) {
+                uint32_t dataBytes = frames * channels * 3;
+                fseek(file, 4, SEEK_SET);
+                putLE(file, 36 + dataBytes, 4);
+                fseek(file, 40, SEEK_SET);
+                putLE(file, dataBytes, 4);
+            } else if (format == FORMAT_BIN) {
+                fseek(file, 16, SEEK_SET);
+                putLE(file, frames, 4);
+                putLE(file, frames >> 16 >> 16, 4);
+            }
+            fclose(file);
+            file = NULL;
+        }
+
+        boolean isOpen() {
+            return file != NULL || capture.isOpen();
+        }
+
+        unsigned long getFrames() {
+            return frames;
+        }
+
+    private:
+        Format format;
+        unsigned long sampleRate;
+        boolean zeroFill;
+        FILE *file;
+        byte channels;
+        unsigned long frames;
+        uint64_t slots; // frame periods since open, lost frames included
+        float scale; // uV per LSB, 0 for raw codes
+        ADS129X_CaptureWriter capture;
+        std::vector<byte> pending; // raw bytes read before the file is open
+
+        void writeRecord(const long *_frame, byte _sequence) {
+            switch (format) {
+                case FORMAT_WAV:
+                    for (byte c = 1; c <= channels; c++) {
+                        putLE(file, (uint32_t) _frame[c], 3);
+                    }
+                    break;
+                case FORMAT_CSV:
+                    fprintf(file, "%u,%ld", _sequence, _frame[0]);
+                    if (scale) {
+                        for (byte c = 1; c <= channels; c++) {
+                            fprintf(file, ",%.3f", _frame[c] * scale);
+                        }
+                    } else {
+                        for (byte c = 1; c <= channels; c++) {
+                            fprintf(file, ",%ld", _frame[c]);
+                        }
+                    }
+                    fputc('\n', file);
+                    break;
+                case FORMAT_BIN:
+                    for (byte c = 0; c <= channels; c++) {
+                        putLE(file, (uint32_t) _frame[c], 4);
+                    }
+                    break;
+                case FORMAT_CAP: {
+                    byte raw[ADS129X_CAPTURE_FRAME];
+                    for (byte c = 0; c <= channels; c++) {
+                        raw[3*c] = _frame[c] >> 16;
+                        raw[3*c + 1] = _frame[c] >> 8;
+                        raw[3*c + 2] = _frame[c];
+                    }
+                    capture.write(slots * 1000000000ULL / sampleRate, raw);
+                    break;
+                }
+                default:
+                    // raw output is written by writeBytes, only count
+                    break;
+            }
+            frames++;
+            slots++;
+        }
+
+        void writeWavHeader() {
+            fwrite("RIFF", 1, 4, file);
+            putLE(file, 36, 4);
+            fwrite("WAVEfmt ", 1, 8, file);
+            putLE(file, 16, 4);
+            putLE(file, 1, 2);                          // PCM
+            putLE(file, channels, 2);
+            putLE(file, sampleRate, 4);
+            putLE(file, sampleRate * channels * 3, 4);  // byte rate
+            putLE(file, channels * 3, 2);               // block align
+            putLE(file, 24, 2);
+            fwrite("data", 1, 4, file);
+            putLE(file, 0, 4);
+        }
+
+        /**
+         * 32-byte header: magic "ADS129X\0", version (u32), number of words
+         * per record (u32, status + channels), frame count (u64), sample
+         * rate (u32), reserved (u32). Records follow as int32 words.
+         */
+        void writeBinHeader() {
+            fwrite("ADS129X\0", 1, 8, file);
+            putLE(file, 1, 4);
+            putLE(file, 1 + channels, 4);
+            putLE(file, 0, 4);
+            putLE(file, 0, 4);
+            putLE(file, sampleRate, 4);
+            putLE(file, 0, 4);
+        }
+};
+
+static Format formatOf(const char *_path) {
+    const char *extension = strrchr(_path, '.');
+    if (extension == NULL) return FORMAT_RAW;
+    if (strcmp(extension, ".wav") == 0) return FORMAT_WAV;
+    if (strcmp(extension, ".csv") == 0 || strcmp(extension, ".txt") == 0) return FORMAT_CSV;
+    if (strcmp(extension, ".bin") == 0) return FORMAT_BIN;
+    if (strcmp(extension, ".cap") == 0) return FORMAT_CAP;
+    return FORMAT_RAW;
+}
+
+/**
+ * Path of chunk _index: "out.wav" becomes "out-0001.wav".
+ */
+static void chunkPath(char *_buffer, size_t _size, const char *_path, unsigned _index) {
+    const char *extension = strrchr(_path, '.');
+    int stem = extension ? (int) (extension - _path) : (int) strlen(_path);
+    snprintf(_buffer, _size, "%.*s-%04u%s", stem, _path, _index, extension ? extension : "");
+}
+
+static int openInput(const char *_port, const char *_file) {
+    if (_file != NULL) {
+        if (strcmp(_file, "-") == 0) return STDIN_FILENO;
+        return open(_file, O_RDONLY);
+    }
+    int fd = open(_port, O_RDONLY | O_NOCTTY);
+    if (fd >= 0 && isatty(fd)) {
+        struct termios tio;
+        tcgetattr(fd, &tio);
+        cfmakeraw(&tio);
+        cfsetispeed(&tio, B921600);
+        tio.c_cc[VMIN] = 1;
+        tio.c_cc[VTIME] = 0;
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+    return fd;
+}
+
+static void usage() {
+    fprintf(stderr, "usage: recorder [-p port | -i file] [-c] [-s samplerate] [-n frames per chunk] [-z]\n"
+                    "                [-u gain] [-r vref] out\n");
+    exit(2);
+}
+
+int main(int argc, char **argv) {
+    const char *port = NULL, *inFile = NULL, *outPath = NULL;
+    unsigned long sampleRate = 1000, chunkFrames = 0;
+    boolean zeroFill = false, compressed = false;
+    int gain = 0;
+    float vref = 2.4f;
+    int opt;
+    while ((opt = getopt(argc, argv, "p:i:cs:n:zu:r:")) != -1) {
+        switch (opt) {
+            case 'p': port = optarg; break;
+            case 'i': inFile = optarg; break;
+            case 'c': compressed = true; break;
+            case 's': sampleRate = strtoul(optarg, NULL, 0); break;
+            case 'n': chunkFrames = strtoul(optarg, NULL, 0); break;
+            case 'z': zeroFill = true; break;
+            case 'u': gain = atoi(optarg); break;
+            case 'r': vref = atof(optarg); break;
+            default: usage();
+        }
+    }
+    if (optind != argc - 1 || (port == NULL) == (inFile == NULL)) usage();
+    outPath = argv[optind];
+
+    int fd = openInput(port, inFile);
+    if (fd < 0) {
+        perror(port ? port : inFile);
+        return 1;
+    }
+    // no SA_RESTART: a signal has to interrupt a blocking read of an idle
+    // port, or Ctrl-C would only take effect once the next byte arrives
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = onSignal;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = 0;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    Format format = formatOf(outPath);
+    Output output(format, sampleRate, zeroFill);
+    if (gain) {
+        static const int gains[7] = { 6, 1, 2, 3, 4, 8, 12 };
+        byte code = 0;
+        while (code < 7 && gains[code] != gain) code++;
+        if (code == 7 || format != FORMAT_CSV) usage();
+        output.setMicrovolts(code, vref);
+    }
+    ADS129X_Decoder packets;
+    ADS129X_BlockDecoder blocks;
+    unsigned chunk = 0;
+    unsigned long bytesRead = 0, lostBefore = 0, frames = 0;
+    char path[4096];
+    byte buffer[1 << 14];
+
+    struct timespec start, stop;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    fprintf(stderr, "recording to %s...\n", outPath);
+
+    while (!stopRequested) {
+        ssize_t n = read(fd, buffer, sizeof(buffer));
+        if (n < 0 && errno == EINTR) continue; // stopRequested is checked above
+        if (n <= 0) break;
+        bytesRead += n;
+        size_t rawStart = 0;
+        for (ssize_t i = 0; i < n; i++) {
+            if (!(compressed ? blocks.feed(buffer[i]) : packets.feed(buffer[i]))) continue;
+            byte channels = compressed ? blocks.getChannels() : packets.getChannels();
+            unsigned long lostNow = compressed ? blocks.getLostFrames() : packets.getLostFrames();
+
+            // the first frame decides the channel count; chunks rotate on
+            // frame boundaries
+            if (!output.isOpen() || (chunkFrames && output.getFrames() >= chunkFrames)) {
+                output.writeBytes(buffer + rawStart, i + 1 - rawStart);
+                rawStart = i + 1;
+                output.close();
+                if (chunkFrames) {
+                    chunkPath(path, sizeof(path), outPath, chunk++);
+                } else {
+                    snprintf(path, sizeof(path), "%s", outPath);
+                }
+                if (!output.open(path, channels)) return 1;
+                lostBefore = lostNow;
+            }
+            unsigned long lost = lostNow - lostBefore;
+            lostBefore = lostNow;
+            if (compressed) {
+                for (byte f = 0; f < blocks.getFrames(); f++) {
+                    output.writeFrame(blocks.getFrame(f), (byte) (blocks.getCounter() + f), f ? 0 : lost);
+                }
+                frames += blocks.getFrames();
+            } else {
+                output.writeFrame(packets.getFrame(), packets.getSequence(), lost);
+                frames++;
+            }
+        }
+        output.writeBytes(buffer + rawStart, n - rawStart);
+    }
+    output.close();
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+
+    double seconds = (stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec) * 1e-9;
+    fprintf(stderr, "...completed reading data.\n");
+    fprintf(stderr, "recorded %f seconds of data.\n", seconds);
+    fprintf(stderr, "read %lu bytes.\n", bytesRead);
+    if (compressed) {
+        fprintf(stderr, "decoded %lu blocks.\n", blocks.getBlocks());
+    }
+    fprintf(stderr, "recorded %lu frames (%f fps).\n", frames, seconds > 0 ? frames / seconds : 0.0);
+    fprintf(stderr, "lost %lu frames.\n", compressed ? blocks.getLostFrames() : packets.getLostFrames());
+    fprintf(stderr, "rejected %lu packets.\n", compressed ? blocks.getErrors() : packets.getErrors());
+    fprintf(stderr, "dropped %lu bytes.\n", compressed ? blocks.getDroppedBytes() : packets.getDroppedBytes());
+    return 0;
+}